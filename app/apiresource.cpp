@@ -0,0 +1,259 @@
+#include "apiresource.hpp"
+#include "global.hpp"
+#include "jsonexport.hpp"
+#include "playercache.hpp"
+#include "loaderpool.hpp"
+#include "metrics.hpp"
+
+#include <QCryptographicHash>
+#include <QJsonDocument>
+
+#include <algorithm>
+
+using namespace Wt;
+
+static const int MAX_CACHED_BODIES = 4096;
+static const int MAX_RANKING_COUNT = 200;
+static const int DEFAULT_PAIR_MIN_MATCHES = 10;
+
+JsonResource::JsonResource()
+{
+    m_bodies.setMaxCost(MAX_CACHED_BODIES);
+}
+
+JsonResource::~JsonResource()
+{
+    beingDeleted();
+}
+
+QString JsonResource::parameter(const Http::Request &request, const std::string &name, const QString &defaultValue)
+{
+    const std::string *value = request.getParameter(name);
+    return value ? QString::fromStdString(*value) : defaultValue;
+}
+
+int JsonResource::intParameter(const Http::Request &request, const std::string &name, int defaultValue)
+{
+    bool ok = false;
+    const int value = parameter(request, name).toInt(&ok);
+    return ok ? value : defaultValue;
+}
+
+const FoosDB::Player *JsonResource::playerParameter(FoosDB::Database *db, const Http::Request &request, Error &error)
+{
+    const FoosDB::Player *player = db->getPlayer(intParameter(request, "id", 0));
+    if (!player)
+        error = Error{404, "unknown player"};
+    return player;
+}
+
+// whether an Accept-Encoding header allows deflate, explicitly or by "*", with a q-value above 0
+static bool acceptsDeflate(const std::string &acceptEncoding)
+{
+    float deflate = -1.0f, any = -1.0f;
+    for (const QByteArray &token : QByteArray::fromStdString(acceptEncoding).split(',')) {
+        const QList<QByteArray> parts = token.split(';');
+        const QByteArray coding = parts.first().trimmed().toLower();
+        float q = 1.0f;
+        for (int i = 1; i < parts.size(); ++i) {
+            const QByteArray param = parts[i].trimmed();
+            if (param.startsWith("q=") || param.startsWith("Q=")) {
+                bool ok = false;
+                q = param.mid(2).toFloat(&ok);
+                if (!ok)
+                    q = 0.0f;
+            }
+        }
+        if (coding == "deflate")
+            deflate = q;
+        else if (coding == "*")
+            any = q;
+    }
+    return (deflate >= 0.0f) ? deflate > 0.0f : any > 0.0f;
+}
+
+void JsonResource::handleRequest(const Http::Request &request, Http::Response &response)
+{
+    response.setMimeType("application/json; charset=utf-8");
+
+    const auto sendError = [&](const Error &error) {
+        Metrics::counter("eloapp_api_responses_total", "status=\"" + QByteArray::number(error.status) + "\"").add();
+        response.setStatus(error.status);
+        response.out() << QJsonDocument(QJsonObject{{ "error", QString::fromUtf8(error.message) }}).toJson(QJsonDocument::Compact).constData();
+    };
+
+    const std::shared_ptr<FoosDB::Database> dbRef = FoosDB::Database::instance(parameter(request, "db").toStdString());
+    FoosDB::Database *db = dbRef.get();
+    if (!db) {
+        sendError(Error{404, "unknown database"});
+        return;
+    }
+
+    //
+    // Look up or render the body
+    //
+    const QByteArray key = QByteArray::number(db->generation()) + ":" + QByteArray::fromStdString(request.queryString());
+
+    Body body;
+    bool cached = false;
+    {
+        QMutexLocker lock(&m_mutex);
+        if (const Body *entry = m_bodies.object(key)) {
+            body = *entry;
+            cached = true;
+        }
+    }
+
+    if (!cached) {
+        Error error{200, QByteArray()};
+        body.json = render(db, request, error);
+        if (error.status != 200) {
+            sendError(error);
+            return;
+        }
+        body.deflated = qCompress(body.json, 9).mid(4);   // strip Qt's length prefix, leaving a zlib stream
+        const std::string hash = QCryptographicHash::hash(body.json, QCryptographicHash::Sha1).toHex().toStdString();
+        body.etag = "\"" + hash + "\"";
+        body.deflatedEtag = "\"" + hash + "-deflate\"";
+
+        QMutexLocker lock(&m_mutex);
+        m_bodies.insert(key, new Body(body));
+    }
+
+    //
+    // Reply with 304, or with the compressed or plain body; each has its own strong ETag
+    //
+    const bool deflate = acceptsDeflate(request.headerValue("Accept-Encoding"));
+    response.addHeader("ETag", deflate ? body.deflatedEtag : body.etag);
+    response.addHeader("Cache-Control", "public, max-age=60");
+    response.addHeader("Vary", "Accept-Encoding");
+
+    // either one means the client has the same JSON
+    const std::string ifNoneMatch = request.headerValue("If-None-Match");
+    if (ifNoneMatch == "*" || ifNoneMatch.find(body.etag) != std::string::npos
+            || ifNoneMatch.find(body.deflatedEtag) != std::string::npos) {
+        static Metrics::Counter &s_notModified = Metrics::counter("eloapp_api_responses_total", "status=\"304\"");
+        s_notModified.add();
+        response.setStatus(304);
+        return;
+    }
+
+    static Metrics::Counter &s_ok = Metrics::counter("eloapp_api_responses_total", "status=\"200\"");
+    s_ok.add();
+
+    const QByteArray &data = deflate ? body.deflated : body.json;
+    if (deflate)
+        response.addHeader("Content-Encoding", "deflate");
+    response.setContentLength(data.size());
+    response.out().write(data.constData(), data.size());
+}
+
+QByteArray RankingResource::render(FoosDB::Database *db, const Http::Request &request, Error &error)
+{
+    JsonExport::RankingOrder order;
+    if (!JsonExport::parseRankingOrder(parameter(request, "order", "combined"), order)) {
+        error = Error{400, "invalid order"};
+        return QByteArray();
+    }
+
+    const int start = qMax(intParameter(request, "start", 0), 0);
+    const int count = qBound(1, intParameter(request, "count", 20), MAX_RANKING_COUNT);
+    const int activeMonths = qMax(intParameter(request, "active", 0), 0);
+
+    return QJsonDocument(JsonExport::ranking(db, order, start, count, activeMonths)).toJson(QJsonDocument::Compact);
+}
+
+QByteArray PairRankingResource::render(FoosDB::Database *db, const Http::Request &request, Error &/*error*/)
+{
+    const int minMatches = qMax(intParameter(request, "min", DEFAULT_PAIR_MIN_MATCHES), 1);
+    const int start = qMax(intParameter(request, "start", 0), 0);
+    const int count = qBound(1, intParameter(request, "count", 20), MAX_RANKING_COUNT);
+
+    return QJsonDocument(JsonExport::pairRanking(db, minMatches, start, count)).toJson(QJsonDocument::Compact);
+}
+
+QByteArray PlayerResource::render(FoosDB::Database *db, const Http::Request &request, Error &error)
+{
+    const FoosDB::Player *player = playerParameter(db, request, error);
+    if (!player)
+        return QByteArray();
+
+    return QJsonDocument(JsonExport::playerSummary(db, player)).toJson(QJsonDocument::Compact);
+}
+
+QByteArray ProgressionResource::render(FoosDB::Database *db, const Http::Request &request, Error &error)
+{
+    const FoosDB::Player *player = playerParameter(db, request, error);
+    if (!player)
+        return QByteArray();
+
+    return QJsonDocument(JsonExport::progression(db, player)).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MatchesResource::render(FoosDB::Database *db, const Http::Request &request, Error &error)
+{
+    const FoosDB::Player *player = playerParameter(db, request, error);
+    if (!player)
+        return QByteArray();
+
+    FoosDB::EloDomain domain;
+    if (!JsonExport::parseDomain(parameter(request, "domain", "combined"), domain)) {
+        error = Error{400, "invalid domain"};
+        return QByteArray();
+    }
+
+    const int page = qMax(intParameter(request, "page", 0), 0);
+    return QJsonDocument(JsonExport::matches(db, player, domain, page, MATCHES_PER_PAGE)).toJson(QJsonDocument::Compact);
+}
+
+MetricsResource::~MetricsResource()
+{
+    beingDeleted();
+}
+
+void MetricsResource::handleRequest(const Http::Request &request, Http::Response &response)
+{
+    // IPv4 clients of a dual-stack socket show up as mapped IPv6 addresses
+    std::string client = request.clientAddress();
+    if (client.compare(0, 7, "::ffff:") == 0)
+        client = client.substr(7);
+
+    const std::vector<std::string> &allowed = metricsAllowedAddresses();
+    if (std::find(allowed.begin(), allowed.end(), client) == allowed.end()) {
+        static Metrics::Counter &s_forbidden = Metrics::counter("eloapp_metrics_forbidden_total");
+        s_forbidden.add();
+        response.setStatus(403);
+        return;
+    }
+
+    QByteArray out = Metrics::prometheusText();
+
+    const auto sample = [&](const QByteArray &name, const QByteArray &labels, double value) {
+        out += name + (labels.isEmpty() ? QByteArray() : "{" + labels + "}") + " " + QByteArray::number(value, 'g', 12) + "\n";
+    };
+
+    const PlayerCache::Stats cache = PlayerCache::instance().stats();
+    out += "# TYPE eloapp_player_cache_hits_total counter\n";
+    sample("eloapp_player_cache_hits_total", QByteArray(), cache.hits);
+    out += "# TYPE eloapp_player_cache_misses_total counter\n";
+    sample("eloapp_player_cache_misses_total", QByteArray(), cache.misses);
+    out += "# TYPE eloapp_player_cache_entries gauge\n";
+    sample("eloapp_player_cache_entries", QByteArray(), cache.entries);
+    out += "# TYPE eloapp_player_cache_bytes gauge\n";
+    sample("eloapp_player_cache_bytes", QByteArray(), cache.totalKBytes * 1024.0);
+
+    const LoaderPool::Stats loader = LoaderPool::instance().stats();
+    out += "# TYPE eloapp_loader_jobs_total counter\n";
+    sample("eloapp_loader_jobs_total", QByteArray(), loader.completed);
+    out += "# TYPE eloapp_loader_queued gauge\n";
+    sample("eloapp_loader_queued", QByteArray(), loader.queued);
+    out += "# TYPE eloapp_loader_queue_seconds_total counter\n";
+    sample("eloapp_loader_queue_seconds_total", QByteArray(), loader.totalQueueUsecs / 1e6);
+    out += "# TYPE eloapp_loader_run_seconds_total counter\n";
+    sample("eloapp_loader_run_seconds_total", QByteArray(), loader.totalRunUsecs / 1e6);
+
+    response.setMimeType("text/plain; version=0.0.4; charset=utf-8");
+    response.addHeader("Cache-Control", "no-cache");
+    response.setContentLength(out.size());
+    response.out().write(out.constData(), out.size());
+}
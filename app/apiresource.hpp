@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Wt/WResource.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+
+#include <QByteArray>
+#include <QCache>
+#include <QMutex>
+
+#include "database.hpp"
+
+/*
+ * Read-only JSON endpoints, served without creating a Wt session.
+ *
+ * Rendered bodies are cached together with a pre-compressed (deflate) copy and a strong
+ * ETag for each, keyed by the query string and the generation of the database they
+ * were rendered from. Requests with a matching If-None-Match get a bodyless 304.
+ */
+class JsonResource : public Wt::WResource
+{
+public:
+    JsonResource();
+    ~JsonResource();
+
+    void handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response) override;
+
+protected:
+    struct Error
+    {
+        int status;
+        QByteArray message;
+    };
+
+    // returns the JSON body, or sets error and returns an empty array
+    virtual QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) = 0;
+
+    static QString parameter(const Wt::Http::Request &request, const std::string &name, const QString &defaultValue = QString());
+    static int intParameter(const Wt::Http::Request &request, const std::string &name, int defaultValue);
+    static const FoosDB::Player *playerParameter(FoosDB::Database *db, const Wt::Http::Request &request, Error &error);
+
+private:
+    struct Body
+    {
+        QByteArray json;
+        QByteArray deflated;
+        std::string etag;
+        std::string deflatedEtag;
+    };
+
+    QMutex m_mutex;
+    QCache<QByteArray, Body> m_bodies;
+};
+
+// ?db=ger&order=combined|single|double|games&start=0&count=20&active=0 (months, 0 for all players)
+class RankingResource : public JsonResource
+{
+protected:
+    QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) override;
+};
+
+// ?db=ger&min=10&start=0&count=20 (min: matches played together)
+class PairRankingResource : public JsonResource
+{
+protected:
+    QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) override;
+};
+
+// ?db=ger&id=123
+class PlayerResource : public JsonResource
+{
+protected:
+    QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) override;
+};
+
+// ?db=ger&id=123
+class ProgressionResource : public JsonResource
+{
+protected:
+    QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) override;
+};
+
+// ?db=ger&id=123&domain=combined&page=0
+class MatchesResource : public JsonResource
+{
+protected:
+    QByteArray render(FoosDB::Database *db, const Wt::Http::Request &request, Error &error) override;
+};
+
+/*
+ * All Metrics, plus the statistics of the player cache and the loader pool, in the Prometheus
+ * text format. Everything is collected when scraped; nothing is computed in between. Only the
+ * client addresses in ELO_METRICS_ALLOW (default: localhost) may read it, others get a 403.
+ */
+class MetricsResource : public Wt::WResource
+{
+public:
+    ~MetricsResource();
+
+    void handleRequest(const Wt::Http::Request &request, Wt::Http::Response &response) override;
+};
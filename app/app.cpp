@@ -16,6 +16,10 @@ EloApp::EloApp(const WEnvironment& env)
     useStyleSheet("elo-style.css");
     messageResourceBundle().use("elo");
 
+    // player pages are filled in by server push once their data is loaded
+    if (env.ajax())
+        enableUpdates(true);
+
     //
     // Create div hierarchy
     //
@@ -42,13 +46,13 @@ EloApp::EloApp(const WEnvironment& env)
     m_menu->addStyleClass("menu");
     m_menu->setWidth(150);
 
-    WMenuItem *menuGermany = m_menu->addItem("Deutschland");
-    WMenuItem *menuBerlin = m_menu->addItem("Berlin");
-    WMenuItem *menuInfo = m_menu->addItem("Info");
-
     LinkType linkType = useInternalPaths() ? LinkType::InternalPath : LinkType::Url;
-    menuGermany->setLink(WLink(linkType, deployPrefix() + "/ger/"));
-    menuBerlin->setLink(WLink(linkType, deployPrefix() + "/ber/"));
+    for (const Region &region : regions()) {
+        WMenuItem *item = m_menu->addItem(WString::fromUTF8(region.menuLabel.toStdString()));
+        item->setLink(WLink(linkType, deployPrefix() + "/" + region.id + "/"));
+    }
+
+    WMenuItem *menuInfo = m_menu->addItem("Info");
     menuInfo->setLink(WLink(LinkType::InternalPath, "/info"));
 
     //
@@ -60,11 +64,9 @@ EloApp::EloApp(const WEnvironment& env)
     m_menuButton->decorationStyle().font().setSize("150%");
 
     //
-    // Create content
+    // Content widgets are created lazily by rankingWidget() and playerWidget(),
+    // the default region's database is only loaded once it is shown
     //
-    m_currentDb = FoosDB::Database::instance("ger");
-    m_rankingWidget = m_contentPane->addWidget(make_unique<RankingWidget>(m_currentDb));
-    m_playerWidget = m_contentPane->addWidget(make_unique<PlayerWidget>());
 
     //
     // Dimmer
@@ -125,15 +127,15 @@ void EloApp::navigate(std::string path)
         return;
     }
 
-    if (removePrefix(path, "/ger")) {
-        m_currentDb = FoosDB::Database::instance("ger");
-        m_rankingWidget->setDatabase(FoosDB::Database::instance("ger"));
-        m_playerWidget->setDatabasePrefix("ger");
+    // the first path component selects the region
+    const size_t regionEnd = path.find('/', 1);
+    const Region *region = (path.size() > 1 && path[0] == '/') ? findRegion(path.substr(1, regionEnd - 1)) : nullptr;
+    if (region) {
+        path.erase(0, regionEnd == std::string::npos ? path.size() : regionEnd);
+        setRegion(*region);
     }
-    else if (removePrefix(path, "/ber")) {
-        m_currentDb = FoosDB::Database::instance("ber");
-        m_rankingWidget->setDatabase(FoosDB::Database::instance("ber"));
-        m_playerWidget->setDatabasePrefix("ber");
+    else if (!m_currentDb) {
+        setRegion(regions().first());
     }
 
     if (path == "/info") {
@@ -159,9 +161,42 @@ void EloApp::onInternalPathChanged(const std::string &path)
     navigate(path);
 }
 
+void EloApp::setRegion(const Region &region)
+{
+    if (m_currentDb && m_currentDb->name() == region.id)
+        return;
+
+    m_currentDb = FoosDB::Database::instance(region.id);
+    if (!m_currentDb) {
+        qCritical() << "Failed to open database for region" << region.id;
+        return;
+    }
+
+    if (m_rankingWidget)
+        m_rankingWidget->setDatabase(m_currentDb.get());
+    if (m_playerWidget)
+        m_playerWidget->setDatabasePrefix(QString::fromStdString(region.id));
+}
+
+RankingWidget *EloApp::rankingWidget()
+{
+    if (!m_rankingWidget)
+        m_rankingWidget = m_contentPane->addWidget(make_unique<RankingWidget>(m_currentDb.get()));
+    return m_rankingWidget;
+}
+
+PlayerWidget *EloApp::playerWidget()
+{
+    if (!m_playerWidget) {
+        m_playerWidget = m_contentPane->addWidget(make_unique<PlayerWidget>());
+        m_playerWidget->setDatabasePrefix(QString::fromStdString(m_currentDb->name()));
+    }
+    return m_playerWidget;
+}
+
 void EloApp::showRanking()
 {
-    m_contentPane->setCurrentWidget(m_rankingWidget);
+    m_contentPane->setCurrentWidget(rankingWidget());
     m_menuButton->show();
     m_menuContainer->hide();
     m_bgDimmer->hide();
@@ -170,8 +205,8 @@ void EloApp::showRanking()
 
 void EloApp::showPlayer(int id)
 {
-    m_contentPane->setCurrentWidget(m_playerWidget);
-    m_playerWidget->setPlayerId(m_currentDb, id);
+    m_contentPane->setCurrentWidget(playerWidget());
+    m_playerWidget->setPlayerId(m_currentDb.get(), id);
     m_menuButton->hide();
     m_menuContainer->hide();
     m_bgDimmer->hide();
@@ -180,7 +215,7 @@ void EloApp::showPlayer(int id)
 
 void EloApp::showMenu()
 {
-    m_contentPane->setCurrentWidget(m_rankingWidget);
+    m_contentPane->setCurrentWidget(rankingWidget());
     m_menuButton->hide();
     m_menuContainer->show();
     m_bgDimmer->show();
@@ -189,7 +224,7 @@ void EloApp::showMenu()
 
 void EloApp::showInfo()
 {
-    m_contentPane->setCurrentWidget(m_rankingWidget);
+    m_contentPane->setCurrentWidget(rankingWidget());
     m_menuButton->show();
     m_menuContainer->hide();
     m_bgDimmer->show();
@@ -10,6 +10,7 @@
 #include "playerwidget.hpp"
 #include "infopopup.hpp"
 #include "database.hpp"
+#include "regions.hpp"
 
 class EloApp : public Wt::WApplication
 {
@@ -18,19 +19,25 @@ public:
 
 private:
     void navigate(std::string path);
+    void setRegion(const Region &region);
     void onInternalPathChanged(const std::string &path);
 
+    // content widgets are only created once they are first shown
+    RankingWidget *rankingWidget();
+    PlayerWidget *playerWidget();
+
     void showRanking();
     void showPlayer(int id);
     void showMenu();
     void showInfo();
     void hideInfo();
 
-    FoosDB::Database *m_currentDb;
+    // keeps the region's database loaded while this session uses it
+    std::shared_ptr<FoosDB::Database> m_currentDb;
 
     Wt::WStackedWidget *m_contentPane;
-    RankingWidget *m_rankingWidget;
-    PlayerWidget *m_playerWidget;
+    RankingWidget *m_rankingWidget = nullptr;
+    PlayerWidget *m_playerWidget = nullptr;
 
     Wt::WPushButton *m_menuButton;
     Wt::WContainerWidget *m_menuContainer;
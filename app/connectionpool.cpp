@@ -0,0 +1,226 @@
+#include "connectionpool.hpp"
+
+#include <QDebug>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QThread>
+
+static QString genConnName()
+{
+    static QAtomicInt counter = 0;
+    return QString("SqliteConnection%1").arg(counter.fetchAndAddOrdered(1));
+}
+
+namespace FoosDB {
+
+ConnectionPool::ConnectionPool(const QString &dbPath, int size, const QStringList &statements, const QByteArray &metricsLabels)
+    : m_dbPath(dbPath)
+    , m_statements(statements)
+    , m_acquisitionsMetric(Metrics::counter("eloapp_db_connection_acquisitions_total", metricsLabels))
+    , m_waitsMetric(Metrics::counter("eloapp_db_connection_waits_total", metricsLabels))
+    , m_opensMetric(Metrics::counter("eloapp_db_connection_opens_total", metricsLabels))
+    , m_waitMetric(Metrics::histogram("eloapp_db_connection_wait_seconds", metricsLabels))
+{
+    for (int i = 0; i < qMax(size, 1); ++i) {
+        Connection *connection = new Connection;
+        m_connections << connection;
+        m_free << connection;
+    }
+}
+
+ConnectionPool::~ConnectionPool()
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_free.size() != m_connections.size())
+        qWarning() << "Destroying connection pool with" << m_connections.size() - m_free.size() << "connections in use";
+
+    // this may be any thread, e.g. one that evicted the database, so other threads' connections are retired
+    for (Connection *connection : m_connections)
+        retire(connection);
+}
+
+ConnectionPool::Handle ConnectionPool::acquire()
+{
+    // closes what is retired for this thread once it exits, if it never acquires again
+    struct ThreadExit
+    {
+        ~ThreadExit() { closeRetired(); }
+    };
+    thread_local ThreadExit t_threadExit;
+    (void) t_threadExit;
+
+    closeRetired();
+
+    const Qt::HANDLE thread = QThread::currentThreadId();
+    Connection *connection;
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stats.acquisitions++;
+        m_acquisitionsMetric.add();
+
+        if (m_free.isEmpty()) {
+            QElapsedTimer timer;
+            timer.start();
+            while (m_free.isEmpty())
+                m_available.wait(&m_mutex);
+
+            const quint64 usecs = timer.nsecsElapsed() / 1000;
+            m_stats.waits++;
+            m_stats.totalWaitUsecs += usecs;
+            m_stats.maxWaitUsecs = qMax(m_stats.maxWaitUsecs, usecs);
+            m_waitsMetric.add();
+            m_waitMetric.observe(usecs);
+        }
+
+        connection = takeFree(thread);
+        if (connection->thread != thread) {
+            m_stats.opens++;
+            m_opensMetric.add();
+        }
+    }
+
+    // opening is done outside the lock, the slot isn't free anymore
+    if (connection->thread != thread)
+        open(connection);
+
+    return Handle(this, connection);
+}
+
+ConnectionPool::Connection *ConnectionPool::takeFree(Qt::HANDLE thread)
+{
+    // the most recently released connection of this thread has the warmest statement cache
+    for (int i = m_free.size() - 1; i >= 0; --i) {
+        if (m_free[i]->thread == thread)
+            return m_free.takeAt(i);
+    }
+    for (int i = m_free.size() - 1; i >= 0; --i) {
+        if (!m_free[i]->thread)
+            return m_free.takeAt(i);
+    }
+
+    // take over the least recently released slot; its thread closes the old connection
+    Connection *connection = m_free.takeFirst();
+    retire(new Connection(*connection));
+    *connection = Connection();
+    return connection;
+}
+
+ConnectionPool::Retired &ConnectionPool::retired()
+{
+    // never deleted, threads may exit after static destruction began
+    static Retired *s_retired = new Retired;
+    return *s_retired;
+}
+
+void ConnectionPool::retire(Connection *connection)
+{
+    if (!connection->thread || connection->thread == QThread::currentThreadId()) {
+        close(connection);
+        delete connection;
+        return;
+    }
+
+    Retired &r = retired();
+    QMutexLocker lock(&r.mutex);
+    r.byThread[connection->thread] << connection;
+    r.count.ref();
+}
+
+void ConnectionPool::closeRetired()
+{
+    Retired &r = retired();
+    if (r.count.load() == 0)
+        return;
+
+    QVector<Connection*> connections;
+    {
+        QMutexLocker lock(&r.mutex);
+        connections = r.byThread.take(QThread::currentThreadId());
+        r.count.fetchAndAddOrdered(-connections.size());
+    }
+
+    for (Connection *connection : connections) {
+        close(connection);
+        delete connection;
+    }
+}
+
+void ConnectionPool::open(Connection *connection)
+{
+    connection->name = genConnName();
+    connection->thread = QThread::currentThreadId();
+    connection->db = QSqlDatabase::addDatabase("QSQLITE", connection->name);
+    connection->db.setDatabaseName(m_dbPath);
+    connection->db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    if (!connection->db.open()) {
+        qWarning() << "Error opening database:" << connection->db.lastError();
+    }
+    connection->statements.fill(nullptr, m_statements.size());
+}
+
+void ConnectionPool::close(Connection *connection)
+{
+    if (!connection->thread)
+        return;
+
+    qDeleteAll(connection->statements);
+    connection->statements.clear();
+    connection->db.close();
+    connection->db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connection->name);
+    connection->thread = nullptr;
+}
+
+void ConnectionPool::release(Connection *connection)
+{
+    QMutexLocker lock(&m_mutex);
+    m_free << connection;
+    m_available.wakeOne();
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_stats;
+}
+
+ConnectionPool::Handle::Handle(ConnectionPool *pool, Connection *connection)
+    : m_pool(pool)
+    , m_connection(connection)
+{
+}
+
+ConnectionPool::Handle::Handle(Handle &&other)
+    : m_pool(other.m_pool)
+    , m_connection(other.m_connection)
+{
+    other.m_connection = nullptr;
+}
+
+ConnectionPool::Handle::~Handle()
+{
+    if (m_connection)
+        m_pool->release(m_connection);
+}
+
+QSqlDatabase &ConnectionPool::Handle::db()
+{
+    return m_connection->db;
+}
+
+QSqlQuery &ConnectionPool::Handle::query(int statement)
+{
+    QSqlQuery *&query = m_connection->statements[statement];
+
+    if (!query) {
+        query = new QSqlQuery(m_connection->db);
+        if (!query->prepare(m_pool->m_statements[statement])) {
+            qWarning() << "Failed to prepare query:" << query->lastError();
+        }
+    }
+
+    query->finish();
+    return *query;
+}
+
+} // namespace FoosDB
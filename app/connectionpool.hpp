@@ -0,0 +1,118 @@
+#pragma once
+
+#include <QHash>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QStringList>
+#include <QVector>
+
+#include "metrics.hpp"
+
+namespace FoosDB {
+
+/*
+ * A fixed number of read-only SQLite connections, shared by all Wt threads.
+ *
+ * Qt connections must only be used by the thread that opened them, so the slots are opened
+ * lazily by the first thread that acquires them, and are handed to that thread again whenever
+ * possible. A thread that finds only slots of other threads free takes one over: it opens a
+ * new connection in the slot, and the old one is retired. Retired connections, and those of
+ * destroyed pools (e.g. of evicted databases), are closed by the thread that opened them, on its
+ * next acquire() from any pool or when it exits.
+ *
+ * Every connection lazily prepares the statements passed to the constructor on first use
+ * and keeps them around, so a query only has to bind its parameters. Connections are
+ * handed out as RAII handles, and block the caller if the pool is exhausted.
+ *
+ * Acquisitions, waits and opens are also counted in the Metrics registry under the given labels,
+ * where they keep adding up across pools of the same database, e.g. after it was evicted.
+ */
+class ConnectionPool
+{
+    struct Connection;
+
+public:
+    ConnectionPool(const QString &dbPath, int size, const QStringList &statements, const QByteArray &metricsLabels);
+    ~ConnectionPool();
+
+    class Handle
+    {
+    public:
+        Handle(Handle &&other);
+        ~Handle();
+
+        QSqlDatabase &db();
+
+        // returns the cached prepared statement with the given index, reset for re-execution
+        QSqlQuery &query(int statement);
+
+    private:
+        friend class ConnectionPool;
+        Handle(ConnectionPool *pool, Connection *connection);
+        Handle(const Handle&) = delete;
+        Handle &operator=(const Handle&) = delete;
+
+        ConnectionPool *m_pool;
+        Connection *m_connection;
+    };
+
+    Handle acquire();
+
+    struct Stats
+    {
+        quint64 acquisitions = 0;
+        quint64 waits = 0;          // acquisitions that found the pool exhausted
+        quint64 totalWaitUsecs = 0;
+        quint64 maxWaitUsecs = 0;
+        quint64 opens = 0;          // including slots taken over from another thread
+    };
+    Stats stats() const;
+
+    int size() const { return m_connections.size(); }
+
+private:
+    void release(Connection *connection);
+    Connection *takeFree(Qt::HANDLE thread);
+    void open(Connection *connection);
+    static void close(Connection *connection);
+
+    // hands a connection to the thread that has to close it, or closes it if that's this one
+    static void retire(Connection *connection);
+    // closes the retired connections of this thread
+    static void closeRetired();
+
+    // of all pools, by the thread that has to close them
+    struct Retired
+    {
+        QMutex mutex;
+        QHash<Qt::HANDLE, QVector<Connection*>> byThread;
+        QAtomicInt count;       // to skip the lock in acquire() if there are none
+    };
+    static Retired &retired();
+
+    struct Connection
+    {
+        QString name;
+        QSqlDatabase db;
+        QVector<QSqlQuery*> statements;
+        Qt::HANDLE thread = nullptr;    // the thread that opened it, nullptr if not opened yet
+    };
+
+    const QString m_dbPath;
+    const QStringList m_statements;
+    QVector<Connection*> m_connections;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_available;
+    QVector<Connection*> m_free;
+    Stats m_stats;
+
+    Metrics::Counter &m_acquisitionsMetric;
+    Metrics::Counter &m_waitsMetric;
+    Metrics::Counter &m_opensMetric;
+    Metrics::Histogram &m_waitMetric;
+};
+
+} // namespace FoosDB
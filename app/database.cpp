@@ -1,16 +1,224 @@
 #include "database.hpp"
+#include "global.hpp"
+#include "mappedsnapshot.hpp"
+#include "util.hpp"
 
 #include <QDebug>
+#include <QMutex>
 #include <QSqlError>
-#include <QThread>
+#include <QtEndian>
 
-static QString genConnName()
+#include <limits>
+
+namespace FoosDB {
+
+//
+// All statements that are executed per request, prepared once per pooled connection
+//
+enum Statement
 {
-    static QAtomicInt counter = 0;
-    return QString("SqliteConnection%1").arg(counter.fetchAndAddOrdered(1));
+    MatchCountStatement,
+    StoredProgressionStatement,
+    StoredRankProgressionStatement,
+    ComputedProgressionStatement,
+    RatingCheckpointStatement,
+    NextRatingCheckpointStatement,
+    RatingReplayStatement,
+    PairRankingStatement,
+    MatchElosStatement,                         // one per EloDomain
+    MatchesStatement = MatchElosStatement + 3,  // one per EloDomain
+    StatementCount = MatchesStatement + 3
+};
+
+static QString matchFilter(EloDomain domain)
+{
+    return QString("WHERE pm.player_id = ? ") +
+            ((domain == EloDomain::Single) ? "AND m.type = 1 " :
+             (domain == EloDomain::Double) ? "AND m.type = 2 " : "") +
+            "ORDER BY pm.id DESC "
+            "LIMIT ? OFFSET ? ";
 }
 
-namespace FoosDB {
+static QStringList createStatements()
+{
+    QVector<QString> ret(StatementCount);
+
+    ret[MatchCountStatement] =
+        "SELECT m.type, COUNT(m.type) "
+        "FROM played_matches AS pm "
+        "INNER JOIN matches AS m "
+        "   ON pm.match_id = m.id "
+        "WHERE pm.player_id = ? "
+        "GROUP BY m.type";
+
+    ret[StoredProgressionStatement] =
+        "SELECT data FROM player_progression WHERE player_id = ?";
+
+    ret[StoredRankProgressionStatement] =
+        "SELECT data FROM player_rank_progression WHERE player_id = ?";
+
+    ret[ComputedProgressionStatement] =
+        "SELECT m.type, c.year, c.month, c.day, ec.rating + ec.change, es.rating + es.change "
+        "FROM played_matches AS pm "
+        "INNER JOIN matches AS m "
+        "   ON pm.match_id = m.id "
+        "INNER JOIN competitions AS c "
+        "   ON m.competition_id = c.id "
+        "INNER JOIN elo_combined AS ec "
+        "   ON pm.id = ec.played_match_id "
+        "INNER JOIN elo_separate AS es "
+        "   ON pm.id = es.played_match_id "
+        "WHERE pm.player_id = ? "
+        "ORDER BY pm.id";
+
+    ret[RatingCheckpointStatement] =
+        "SELECT last_played_match_id, data FROM rating_checkpoints "
+        "WHERE date <= ? "
+        "ORDER BY date DESC "
+        "LIMIT 1";
+
+    ret[NextRatingCheckpointStatement] =
+        "SELECT last_played_match_id FROM rating_checkpoints "
+        "WHERE date > ? "
+        "ORDER BY date "
+        "LIMIT 1";
+
+    // ratings after every played match in a range, in the order they were computed
+    ret[RatingReplayStatement] =
+        "SELECT pm.player_id, m.type, c.year, c.month, c.day, es.rating + es.change, ec.rating + ec.change "
+        "FROM played_matches AS pm "
+        "INNER JOIN matches AS m "
+        "   ON pm.match_id = m.id "
+        "INNER JOIN competitions AS c "
+        "   ON m.competition_id = c.id "
+        "INNER JOIN elo_separate AS es "
+        "   ON pm.id = es.played_match_id "
+        "INNER JOIN elo_combined AS ec "
+        "   ON pm.id = ec.played_match_id "
+        "WHERE pm.id > ? AND pm.id <= ? "
+        "ORDER BY pm.id";
+
+    ret[PairRankingStatement] =
+        "SELECT player1_id, player2_id, rating, wins, draws, losses "
+        "FROM elo_pairs "
+        "WHERE wins + draws + losses >= ? "
+        "ORDER BY rating DESC, player1_id, player2_id "
+        "LIMIT ? OFFSET ?";
+
+    for (EloDomain domain : { EloDomain::Single, EloDomain::Double, EloDomain::Combined }) {
+        //
+        // ELO start rankings for all participants in all matches that the player has played
+        //
+        ret[MatchElosStatement + (int) domain] =
+            "SELECT pm2.match_id, pm2.player_id, ec.rating, es.rating "
+            "FROM played_matches AS pm2 "
+            "INNER JOIN elo_combined AS ec "
+            "   ON pm2.id = ec.played_match_id "
+            "INNER JOIN elo_separate AS es "
+            "   ON pm2.id = es.played_match_id "
+            "WHERE pm2.match_id IN ( "
+            "   SELECT pm.match_id "
+            "   FROM played_matches AS pm "
+            "   INNER JOIN matches AS m ON pm.match_id = m.id "
+            + matchFilter(domain) +
+            ") ";
+
+        //
+        // Match details
+        //
+        ret[MatchesStatement + (int) domain] =
+            "SELECT pm.match_id, "
+            "       m.type, m.score1, m.score2, m.p1, m.p2, m.p11, m.p22, "
+            "       c.name, c.year, c.month, c.day, c.type, "
+            "       es.change, ec.change, c.id "
+            "FROM played_matches AS pm "
+            "INNER JOIN matches AS m ON pm.match_id = m.id "
+            "INNER JOIN competitions AS c ON m.competition_id = c.id "
+            "INNER JOIN elo_separate AS es ON pm.id = es.played_match_id "
+            "INNER JOIN elo_combined AS ec ON pm.id = ec.played_match_id "
+            + matchFilter(domain);
+    }
+
+    return ret.toList();
+}
+
+// decodes the UTF-8 sequence at s[i] and advances i past it; malformed bytes decode to
+// U+FFFD one at a time, so every byte position makes progress
+static inline uint decodeUtf8(const uchar *s, int size, int &i)
+{
+    const uchar c = s[i++];
+    if (c < 0x80)
+        return c;
+
+    int extra;
+    uint cp;
+    if (c >= 0xF0 && c <= 0xF4) {
+        extra = 3;
+        cp = c & 0x07;
+    } else if (c >= 0xE0) {
+        extra = 2;
+        cp = c & 0x0F;
+    } else if (c >= 0xC2 && c <= 0xDF) {
+        extra = 1;
+        cp = c & 0x1F;
+    } else {
+        return 0xFFFD;
+    }
+    if (c >= 0xF5 || i + extra > size)
+        return 0xFFFD;
+
+    for (int k = 0; k < extra; ++k) {
+        if ((s[i + k] & 0xC0) != 0x80)
+            return 0xFFFD;
+        cp = (cp << 6) | (s[i + k] & 0x3F);
+    }
+    i += extra;
+    return cp;
+}
+
+static inline uint foldedCodePoint(uint cp)
+{
+    if (cp < 0x80)
+        return cp >= 'A' && cp <= 'Z' ? cp + ('a' - 'A') : cp;
+    return QChar::toCaseFolded(cp);
+}
+
+static bool containsFolded(const char *name, int size, const QVector<uint> &pattern)
+{
+    const uchar *s = reinterpret_cast<const uchar*>(name);
+    const int n = pattern.size();
+    if (n == 0)
+        return true;
+
+    // every match starts on a character boundary, continuation bytes are skipped
+    for (int i = 0; i + n <= size; ++i) {
+        if ((s[i] & 0xC0) == 0x80)
+            continue;
+        int j = i;
+        int k = 0;
+        while (k < n && j < size && foldedCodePoint(decodeUtf8(s, size, j)) == pattern[k])
+            ++k;
+        if (k == n)
+            return true;
+    }
+    return false;
+}
+
+QVector<uint> Player::namePattern(const QString &pattern)
+{
+    const QVector<uint> ucs4 = pattern.toUcs4();
+    QVector<uint> ret;
+    ret.reserve(ucs4.size());
+    for (uint cp : ucs4)
+        ret << foldedCodePoint(cp);
+    return ret;
+}
+
+bool Player::nameContains(const QVector<uint> &pattern) const
+{
+    const char *first = names->constData() + nameOffset;
+    return containsFolded(first, firstNameSize, pattern) || containsFolded(first + firstNameSize, lastNameSize, pattern);
+}
 
 Player::EloProgression::EloProgression(qint16 yy, quint16 mm, quint16 dd, int s, int d, int c)
 {
@@ -22,72 +230,280 @@ Player::EloProgression::EloProgression(qint16 yy, quint16 mm, quint16 dd, int s,
     eloCombined = c;
 }
 
-std::vector<Database*> s_databases;
-
-void Database::create(const std::string &name, const std::string &path)
+PlayerVsPlayerBlock::PlayerVsPlayerBlock(const QVector<PlayerVsPlayerStats> &stats)
+    : m_stats(stats)
 {
-    if (!instance(name))
-        s_databases.push_back(new Database(name, path));
+    const EloDomain domains[] = { EloDomain::Single, EloDomain::Double, EloDomain::Combined };
+    const PvpRole roles[] = { PvpRole::Opponent, PvpRole::Partner };
+
+    for (EloDomain domain : domains) {
+        for (PvpRole role : roles) {
+            const int orderIdx = orderIndex(domain, role);
+            if (orderIdx < 0)
+                continue;
+
+            Order &order = m_orders[orderIdx];
+            QVector<int> deltas(m_stats.size());
+            for (int i = 0; i < m_stats.size(); ++i) {
+                deltas[i] = results(m_stats[i], domain, role).delta;
+                if (deltas[i] != 0)
+                    order.indices << i;
+                if (deltas[i] > 0)
+                    order.positiveCount++;
+            }
+
+            std::sort(order.indices.begin(), order.indices.end(), [&](int a, int b) {
+                return (deltas[a] != deltas[b]) ? (deltas[a] > deltas[b]) : (a < b);
+            });
+        }
+    }
 }
 
-void Database::destroy()
+int PlayerVsPlayerBlock::orderIndex(EloDomain domain, PvpRole role)
 {
-    for (Database *db : s_databases)
-        delete db;
-    s_databases.clear();
+    if (role == PvpRole::Opponent) {
+        return (domain == EloDomain::Single) ? 0 :
+               (domain == EloDomain::Double) ? 1 : 2;
+    }
+    return (domain == EloDomain::Single) ? -1 :
+           (domain == EloDomain::Double) ? 3 : 4;
 }
 
-Database *Database::instance(const std::string &name)
+PlayerVsPlayerStats::Results PlayerVsPlayerBlock::results(const PlayerVsPlayerStats &stats, EloDomain domain, PvpRole role)
 {
-    for (Database *db : s_databases) {
-        if (db->name() == name)
-            return db;
+    if (role == PvpRole::Opponent) {
+        return (domain == EloDomain::Single) ? stats.singleResults() :
+               (domain == EloDomain::Double) ? stats.doubleResults() : stats.combinedResults();
     }
-    return nullptr;
+    return (domain == EloDomain::Single) ? PlayerVsPlayerStats::Results{0, 0, 0, 0} :
+           (domain == EloDomain::Double) ? stats.partnerDoubleResults() : stats.partnerCombinedResults();
 }
 
-Database::Database(const std::string &name, const std::string &dbPath)
-    : m_name(name)
+QVector<const PlayerVsPlayerStats*> PlayerVsPlayerBlock::top(EloDomain domain, PvpRole role, int k) const
+{
+    QVector<const PlayerVsPlayerStats*> ret;
+    const int orderIdx = orderIndex(domain, role);
+    if (orderIdx < 0)
+        return ret;
+
+    const Order &order = m_orders[orderIdx];
+    const int count = qMin(k, order.positiveCount);
+    ret.reserve(count);
+    for (int i = 0; i < count; ++i)
+        ret << &m_stats[order.indices[i]];
+    return ret;
+}
+
+QVector<const PlayerVsPlayerStats*> PlayerVsPlayerBlock::bottom(EloDomain domain, PvpRole role, int k) const
+{
+    QVector<const PlayerVsPlayerStats*> ret;
+    const int orderIdx = orderIndex(domain, role);
+    if (orderIdx < 0)
+        return ret;
+
+    const Order &order = m_orders[orderIdx];
+    const int count = qMin(k, order.indices.size() - order.positiveCount);
+    ret.reserve(count);
+    for (int i = 0; i < count; ++i)
+        ret << &m_stats[order.indices[order.indices.size() - 1 - i]];
+    return ret;
+}
+
+//
+// Registry of lazily loaded databases
+//
+struct RegistryEntry
 {
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", genConnName());
-    db.setDatabaseName(QString::fromStdString(dbPath));
-    if (!db.open()) {
-        qWarning() << "Error opening database:" << db.lastError();
+    std::string name;
+    std::string path;
+    std::shared_ptr<Database> db;
+    quint64 lastAccess = 0;
+    QMutex loadMutex;   // serializes loading, without blocking lookups of other databases
+};
+
+static QMutex s_registryMutex;
+static std::vector<std::unique_ptr<RegistryEntry>> s_registry;
+static quint64 s_accessCounter = 0;
+static QAtomicInt s_generation = 0;
+
+static RegistryEntry *findEntry(const std::string &name)
+{
+    for (const std::unique_ptr<RegistryEntry> &entry : s_registry) {
+        if (entry->name == name)
+            return entry.get();
     }
+    return nullptr;
+}
 
-    m_dbs[QThread::currentThread()] = new QSqlDatabase(db);
+void Database::create(const std::string &name, const std::string &path)
+{
+    QMutexLocker lock(&s_registryMutex);
+    if (findEntry(name))
+        return;
 
-    readData();
+    s_registry.emplace_back(new RegistryEntry);
+    s_registry.back()->name = name;
+    s_registry.back()->path = path;
 }
 
-Database::~Database()
+void Database::destroy()
 {
-    QWriteLocker lock(&m_dbLock);
-    for (auto it = m_dbs.begin(); it != m_dbs.end(); ++it)
-        delete it.value();
+    std::vector<std::unique_ptr<RegistryEntry>> entries;
+    {
+        QMutexLocker lock(&s_registryMutex);
+        entries.swap(s_registry);
+    }
+
+    for (const std::unique_ptr<RegistryEntry> &entry : entries) {
+        if (entry->db && entry->db.use_count() > 1)
+            qWarning() << "Database" << entry->name << "is still referenced on destruction";
+    }
 }
 
-QSqlDatabase *Database::getOrCreateDb()
+std::shared_ptr<Database> Database::instance(const std::string &name)
 {
-    QThread *thread = QThread::currentThread();
+    RegistryEntry *entry;
+    {
+        QMutexLocker lock(&s_registryMutex);
+        entry = findEntry(name);
+        if (!entry)
+            return nullptr;
+        entry->lastAccess = ++s_accessCounter;
+        if (entry->db)
+            return entry->db;
+    }
+
+    // entries are only removed by destroy(), so it's safe to keep using this one
+    QMutexLocker loadLock(&entry->loadMutex);
+    {
+        QMutexLocker lock(&s_registryMutex);
+        if (entry->db)
+            return entry->db;
+    }
+
+    qDebug() << "Loading database" << name << "from" << entry->path;
+    const std::shared_ptr<Database> db(new Database(name, entry->path), [](Database *db) { delete db; });
 
-    QReadLocker readLock(&m_dbLock);
-    auto it = m_dbs.find(thread);
-    if (it == m_dbs.end()) {
-        QReadLocker writeLock(&m_dbLock);
-        QSqlDatabase newDb = QSqlDatabase::cloneDatabase(*m_dbs.begin().value(), genConnName());
-        if (!newDb.open()) {
-            qWarning() << "Error opening database:" << newDb.lastError();
+    //
+    // Publish, and evict unused databases if there are too many
+    //
+    std::vector<std::shared_ptr<Database>> evicted;
+    {
+        QMutexLocker lock(&s_registryMutex);
+        entry->db = db;
+
+        const int maxLoaded = maxLoadedDatabases();
+        int loaded = 0;
+        for (const std::unique_ptr<RegistryEntry> &e : s_registry)
+            loaded += e->db ? 1 : 0;
+
+        while (maxLoaded > 0 && loaded > maxLoaded) {
+            RegistryEntry *lru = nullptr;
+            for (const std::unique_ptr<RegistryEntry> &e : s_registry) {
+                // only the registry holds it, so no session or request is using it
+                if (e.get() != entry && e->db && e->db.use_count() == 1 && (!lru || e->lastAccess < lru->lastAccess))
+                    lru = e.get();
+            }
+            if (!lru)
+                break;
+
+            qDebug() << "Evicting database" << lru->name;
+            evicted.push_back(std::move(lru->db));
+            lru->db.reset();
+            loaded--;
         }
-        it = m_dbs.insert(thread, new QSqlDatabase(newDb));
     }
 
-    return it.value();
+    // evicted databases are destroyed here, outside of the lock; their pools leave the connections
+    // of other threads to those threads to close, see ConnectionPool
+    return db;
+}
+
+Database::Database(const std::string &name, const std::string &dbPath)
+    : m_name(name)
+    , m_generation(s_generation.fetchAndAddOrdered(1) + 1)
+    , m_pool(new ConnectionPool(QString::fromStdString(dbPath), dbPoolSize(), createStatements(),
+                                "db=" + Metrics::labelValue(QByteArray::fromStdString(name))))
+{
+    openSnapshot(QString::fromStdString(dbPath));
+    readData();
+}
+
+Database::~Database()
+{
+    const ConnectionPool::Stats stats = m_pool->stats();
+    qDebug() << "Connection pool" << m_name << ":" << stats.acquisitions << "acquisitions,"
+             << stats.waits << "waits," << stats.totalWaitUsecs << "usecs waited, max wait" << stats.maxWaitUsecs << "usecs,"
+             << stats.opens << "opens";
+}
+
+void Database::openSnapshot(const QString &dbPath)
+{
+    ConnectionPool::Handle conn = m_pool->acquire();
+    QSqlDatabase *db = &conn.db();
+
+    // databases written by older scrapers don't have a snapshot
+    if (!db->tables().contains("snapshot_info"))
+        return;
+
+    QSqlQuery query("SELECT checksum FROM snapshot_info", *db);
+    if (!query.next())
+        return;
+
+    const QString path = Snapshot::pathFor(dbPath);
+    m_snapshot = MappedSnapshot::open(path, (quint64) query.value(0).toLongLong());
+    if (m_snapshot)
+        qDebug() << "Database" << m_name << "uses snapshot" << path << "with" << m_snapshot->size() << "bytes";
+    else
+        qWarning() << "Database" << m_name << "has no usable snapshot, falling back to sqlite";
 }
 
 void Database::readData()
 {
-    QSqlDatabase *db = getOrCreateDb();
+    CheapProfiler prof("Database::readData()");
+
+    ConnectionPool::Handle conn = m_pool->acquire();
+    QSqlDatabase *db = &conn.db();
+
+    m_hasRatingCheckpoints = db->tables().contains("rating_checkpoints");
+    if (!m_hasRatingCheckpoints)
+        qWarning() << "Database" << m_name << "has no rating checkpoints, past rankings will be slow";
+
+    m_hasPairRatings = db->tables().contains("elo_pairs");
+
+    if (m_snapshot) {
+        readSnapshotData();
+        return;
+    }
+
+    m_hasStoredProgression = db->tables().contains("player_progression");
+    if (!m_hasStoredProgression)
+        qWarning() << "Database" << m_name << "has no precomputed progression, falling back to slow queries";
+
+    m_hasRankProgression = db->tables().contains("player_rank_progression");
+
+    //
+    // Match counts and last match days per player and match type
+    //
+    struct Activity { int matchCount = 0; int lastSingle = 0; int lastDouble = 0; };
+    QHash<int, Activity> activity;
+    QSqlQuery activityQuery(
+        "SELECT pm.player_id, m.type, COUNT(*), MAX(c.year * 10000 + c.month * 100 + c.day) "
+        "FROM played_matches AS pm "
+        "INNER JOIN matches AS m "
+        "   ON pm.match_id = m.id "
+        "INNER JOIN competitions AS c "
+        "   ON m.competition_id = c.id "
+        "GROUP BY pm.player_id, m.type", *db);
+
+    while (activityQuery.next()) {
+        Activity &a = activity[activityQuery.value(0).toInt()];
+        a.matchCount += activityQuery.value(2).toInt();
+        if ((MatchType) activityQuery.value(1).toInt() == MatchType::Single)
+            a.lastSingle = activityQuery.value(3).toInt();
+        else
+            a.lastDouble = activityQuery.value(3).toInt();
+    }
 
     //
     // Read all player data
@@ -97,6 +513,7 @@ void Database::readData()
         "FROM players AS p "
         "INNER JOIN elo_current AS e ON p.id = e.player_id", *db);
 
+    QVector<LoadedPlayer> players;
     while (playerQuery.next()) {
         const int id = playerQuery.value(0).toInt();
         const QString firstName = playerQuery.value(1).toString();
@@ -104,93 +521,444 @@ void Database::readData()
         const int es = playerQuery.value(3).toInt();
         const int ed = playerQuery.value(4).toInt();
         const int ec = playerQuery.value(5).toInt();
-        m_players[id] = Player{id, firstName, lastName, es, ed, ec, 0};
+        const Activity a = activity.value(id);
+        players << LoadedPlayer{id, firstName, lastName, es, ed, ec, a.matchCount, a.lastSingle, a.lastDouble};
     }
 
+    buildPlayerTable(players);
+
     //
-    // Read all ratings for all players for all games ever played
+    // Player vs. player stats of all players
     //
-//    const QString ratingsQueryString(
-//        "SELECT pm.player_id, m.type, c.date, ec.rating, es.rating "
-//        "FROM played_matches AS pm "
-//        "INNER JOIN matches AS m "
-//        "   ON pm.match_id = m.id "
-//        "INNER JOIN competitions AS c "
-//        "   ON m.competition_id = c.id "
-//        "INNER JOIN elo_combined AS ec "
-//        "   ON pm.id = ec.played_match_id "
-//        "INNER JOIN elo_separate AS es "
-//        "   ON pm.id = es.played_match_id"
-//    );
-//    QSqlQuery ratingsQuery(ratingsQueryString, *db);
-
-//    while (ratingsQuery.next()) {
-//        const int playerId = ratingsQuery.value(0).toInt();
-//        const MatchType matchType = (MatchType) ratingsQuery.value(1).toInt();
-//        const QDateTime date = QDateTime::fromSecsSinceEpoch(ratingsQuery.value(2).toLongLong());
-//        const int eloCombined = ratingsQuery.value(3).toInt();
-//        const int eloSeparate = ratingsQuery.value(4).toInt();
-
-//        auto it = m_players.find(playerId);
-//        if (it != m_players.end()) {
-//            if (it->progression.isEmpty()) {
-//                it->progression << Player::EloProgression(date, eloSeparate, eloSeparate, eloCombined);
-//            }
-//            else {
-//                int s = it->progression.last().eloSingle;
-//                int d = it->progression.last().eloDouble;
-//                if (matchType == MatchType::Single)
-//                    s = eloSeparate;
-//                else
-//                    d = eloSeparate;
-//                it->progression << Player::EloProgression(date, s, d, eloCombined);
-//            }
-//        }
-//    }
-
-    QSqlQuery matchCountQuery(
-        "SELECT player_id, COUNT(*) "
-        "FROM played_matches "
-        "GROUP BY player_id", *db);
-
-    while (matchCountQuery.next()) {
-        const int id = matchCountQuery.value(0).toInt();
-        const int count = matchCountQuery.value(1).toInt();
-        m_players[id].matchCount = count;
+    QVector<QVector<PlayerVsPlayerStats>> pvpStats(m_players.size());
+    QSqlQuery pvpQuery(
+        "SELECT player_id, other_id, "
+        "single_wins, single_draws, single_losses, "
+        "double_wins, double_draws, double_losses, "
+        "partner_wins, partner_draws, partner_losses, "
+        "combined_delta, double_delta, single_delta, "
+        "partner_combined_delta, partner_double_delta "
+        "FROM player_vs_player_stats", *db);
+
+    while (pvpQuery.next()) {
+        const Player *player = getPlayer(pvpQuery.value(0).toInt());
+        if (!player)
+            continue;
+
+        const int otherId = pvpQuery.value(1).toInt();
+        const qint16 singleWins = pvpQuery.value(2).toInt();
+        const qint16 singleDraws = pvpQuery.value(3).toInt();
+        const qint16 singleLosses = pvpQuery.value(4).toInt();
+        const qint16 doubleWins = pvpQuery.value(5).toInt();
+        const qint16 doubleDraws = pvpQuery.value(6).toInt();
+        const qint16 doubleLosses = pvpQuery.value(7).toInt();
+        const qint16 partnerWins = pvpQuery.value(8).toInt();
+        const qint16 partnerDraws = pvpQuery.value(9).toInt();
+        const qint16 partnerLosses = pvpQuery.value(10).toInt();
+        const qint16 combinedDelta = pvpQuery.value(11).toInt();
+        const qint16 doubleDelta = pvpQuery.value(12).toInt();
+        const qint16 singleDelta = pvpQuery.value(13).toInt();
+        const qint16 partnerCombinedDelta = pvpQuery.value(14).toInt();
+        const qint16 partnerDoubleDelta = pvpQuery.value(15).toInt();
+        pvpStats[player - m_players.constData()] << PlayerVsPlayerStats{
+            getPlayer(otherId),
+            singleWins, singleDraws, singleLosses,
+            doubleWins, doubleDraws, doubleLosses,
+            partnerWins, partnerDraws, partnerLosses,
+            singleDelta, doubleDelta, combinedDelta,
+            partnerCombinedDelta, partnerDoubleDelta
+        };
     }
+
+    buildPvpBlocks(pvpStats);
+}
+
+void Database::readSnapshotData()
+{
+    const Snapshot::Player *snapshotPlayers = m_snapshot->section<Snapshot::Player>(Snapshot::PlayersSection);
+    const int count = m_snapshot->count(Snapshot::PlayersSection);
+
+    const Snapshot::Competition *competitions = m_snapshot->section<Snapshot::Competition>(Snapshot::CompetitionsSection);
+
+    QVector<LoadedPlayer> players;
+    players.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        const Snapshot::Player &p = snapshotPlayers[i];
+
+        // played matches are newest first, so the first one of each type is the last one played
+        int last[2] = {0, 0};
+        for (quint32 j = 0; j < p.playedCount && (!last[0] || !last[1]); ++j) {
+            const Snapshot::PlayedMatch *pm = m_snapshot->at<Snapshot::PlayedMatch>(Snapshot::PlayedMatchesSection, quint64(p.playedBegin) + j);
+            const Snapshot::Match *m = pm ? m_snapshot->at<Snapshot::Match>(Snapshot::MatchesSection, pm->match) : nullptr;
+            const Snapshot::Competition *c = m ? m_snapshot->at<Snapshot::Competition>(Snapshot::CompetitionsSection, m->competition) : nullptr;
+            if (!c) {
+                m_snapshot->damaged("played match");
+                break;
+            }
+            int &l = last[(MatchType) m->type == MatchType::Single ? 0 : 1];
+            if (!l)
+                l = c->year * 10000 + c->month * 100 + c->day;
+        }
+
+        players << LoadedPlayer{p.id, m_snapshot->string(p.firstName), m_snapshot->string(p.lastName),
+                                p.eloSingle, p.eloDouble, p.eloCombined, int(p.singleCount + p.doubleCount),
+                                last[0], last[1]};
+    }
+    buildPlayerTable(players);
+
+    const Snapshot::PlayerVsPlayer *pvps = m_snapshot->section<Snapshot::PlayerVsPlayer>(Snapshot::PlayerVsPlayerSection);
+    QVector<QVector<PlayerVsPlayerStats>> pvpStats(m_players.size());
+    for (int i = 0; i < count; ++i) {
+        const Snapshot::Player &p = snapshotPlayers[i];
+        const Player *player = getPlayer(p.id);
+        QVector<PlayerVsPlayerStats> &stats = pvpStats[player - m_players.constData()];
+        if (!m_snapshot->contains(Snapshot::PlayerVsPlayerSection, p.pvpBegin, p.pvpCount)) {
+            m_snapshot->damaged("player-vs-player");
+            continue;
+        }
+        stats.reserve(p.pvpCount);
+        for (const Snapshot::PlayerVsPlayer *pvp = pvps + p.pvpBegin; pvp != pvps + p.pvpBegin + p.pvpCount; ++pvp) {
+            stats << PlayerVsPlayerStats{
+                getPlayer(pvp->otherId),
+                pvp->singleWins, pvp->singleDraws, pvp->singleLosses,
+                pvp->doubleWins, pvp->doubleDraws, pvp->doubleLosses,
+                pvp->partnerWins, pvp->partnerDraws, pvp->partnerLosses,
+                pvp->singleDelta, pvp->doubleDelta, pvp->combinedDelta,
+                pvp->partnerCombinedDelta, pvp->partnerDoubleDelta
+            };
+        }
+    }
+    buildPvpBlocks(pvpStats);
+
+    m_snapshotCompetitionNames.resize(m_snapshot->count(Snapshot::CompetitionsSection));
+    for (int i = 0; i < m_snapshotCompetitionNames.size(); ++i)
+        m_snapshotCompetitionNames[i] = m_snapshot->string(competitions[i].name);
+}
+
+// the longest prefix of at most max bytes that doesn't end inside a UTF-8 sequence
+static int utf8Prefix(const QByteArray &utf8, int max)
+{
+    if (utf8.size() <= max)
+        return utf8.size();
+    int size = max;
+    while (size > 0 && (uchar(utf8[size]) & 0xC0) == 0x80)
+        --size;
+    return size;
+}
+
+void Database::buildPlayerTable(QVector<LoadedPlayer> &players)
+{
+    std::sort(players.begin(), players.end(), [](const LoadedPlayer &a, const LoadedPlayer &b) {
+        return a.id < b.id;
+    });
+
+    // at least one byte per character, most names are ASCII
+    int nameSize = 0;
+    for (const LoadedPlayer &p : players)
+        nameSize += p.firstName.size() + p.lastName.size();
+    m_nameArena.reserve(nameSize);
+
+    m_players.reserve(players.size());
+    m_ids.reserve(players.size());
+    for (const LoadedPlayer &p : players) {
+        if (!m_ids.isEmpty() && m_ids.last() == p.id)
+            continue;
+
+        Player player;
+        player.id = p.id;
+        player.matchCount = p.matchCount;
+        player.eloSingle = p.eloSingle;
+        player.eloDouble = p.eloDouble;
+        player.eloCombined = p.eloCombined;
+        const QByteArray firstName = p.firstName.toUtf8();
+        const QByteArray lastName = p.lastName.toUtf8();
+        player.names = &m_nameArena;
+        player.nameOffset = m_nameArena.size();
+        player.firstNameSize = utf8Prefix(firstName, 0xffff);
+        player.lastNameSize = utf8Prefix(lastName, 0xffff);
+        m_nameArena += firstName.left(player.firstNameSize);
+        m_nameArena += lastName.left(player.lastNameSize);
+
+        m_players << player;
+        m_ids << p.id;
+        m_lastSingle << p.lastSingle;
+        m_lastDouble << p.lastDouble;
+        m_lastMatchDate = qMax(m_lastMatchDate, qMax(p.lastSingle, p.lastDouble));
+    }
+
+    m_nameArena.squeeze();
+
+    // a direct table is faster than binary searching, as long as it doesn't waste too much memory
+    const int maxId = m_ids.isEmpty() ? 0 : m_ids.last();
+    if (!m_ids.isEmpty() && m_ids.first() >= 0 && maxId < 4 * m_ids.size() + 1024) {
+        m_indexById.fill(-1, maxId + 1);
+        for (int i = 0; i < m_ids.size(); ++i)
+            m_indexById[m_ids[i]] = i;
+    }
+
+    buildRankings();
+}
+
+void Database::buildRankings()
+{
+    const auto before = [this](int order, int a, int b) {
+        const Player &p1 = m_players[a];
+        const Player &p2 = m_players[b];
+        switch (order) {
+        case (int) EloDomain::Single: if (p1.eloSingle != p2.eloSingle) return p1.eloSingle > p2.eloSingle; break;
+        case (int) EloDomain::Double: if (p1.eloDouble != p2.eloDouble) return p1.eloDouble > p2.eloDouble; break;
+        case (int) EloDomain::Combined: if (p1.eloCombined != p2.eloCombined) return p1.eloCombined > p2.eloCombined; break;
+        case GAMES_ORDER:
+            if (p1.matchCount != p2.matchCount)
+                return p1.matchCount > p2.matchCount;
+            if (p1.eloCombined != p2.eloCombined)
+                return p1.eloCombined > p2.eloCombined;
+            break;
+        }
+        return a < b;
+    };
+
+    m_rankings.clear();
+    for (int activeMonths : { 0, ACTIVITY_WINDOWS[0], ACTIVITY_WINDOWS[1] }) {
+        Ranking ranking;
+        ranking.activeMonths = activeMonths;
+        const int cutoff = activityCutoff(activeMonths);
+
+        for (int order = 0; order < 4; ++order) {
+            QVector<int> &indices = ranking.orders[order];
+            for (int i = 0; i < m_players.size(); ++i) {
+                if (isActiveIndex(i, order, cutoff))
+                    indices << i;
+            }
+            indices.squeeze();
+            std::sort(indices.begin(), indices.end(), [&](int a, int b) { return before(order, a, b); });
+        }
+        m_rankings << ranking;
+    }
+}
+
+void Database::buildPvpBlocks(const QVector<QVector<PlayerVsPlayerStats>> &stats)
+{
+    CheapProfiler prof("Database::buildPvpBlocks()");
+
+    // players without any PVP stats share one empty block
+    const std::shared_ptr<const PlayerVsPlayerBlock> empty = std::make_shared<PlayerVsPlayerBlock>();
+
+    m_pvpBlocks.clear();
+    m_pvpBlocks.reserve(stats.size());
+    for (const QVector<PlayerVsPlayerStats> &playerStats : stats)
+        m_pvpBlocks << (playerStats.isEmpty() ? empty : std::make_shared<PlayerVsPlayerBlock>(playerStats));
+}
+
+int Database::activityCutoff(int activeMonths) const
+{
+    if (activeMonths <= 0 || !m_lastMatchDate)
+        return 0;
+
+    const QDate cutoff = QDate(m_lastMatchDate / 10000, m_lastMatchDate / 100 % 100, m_lastMatchDate % 100).addMonths(-activeMonths);
+    return cutoff.year() * 10000 + cutoff.month() * 100 + cutoff.day();
+}
+
+bool Database::isActiveIndex(int index, int order, int cutoff) const
+{
+    if (cutoff <= 0)
+        return true;
+
+    switch (order) {
+    case (int) EloDomain::Single: return m_lastSingle[index] > cutoff;
+    case (int) EloDomain::Double: return m_lastDouble[index] > cutoff;
+    default: return qMax(m_lastSingle[index], m_lastDouble[index]) > cutoff;
+    }
+}
+
+bool Database::isActive(const Player *player, EloDomain domain, int activeMonths) const
+{
+    return isActiveIndex(player - m_players.constData(), (int) domain, activityCutoff(activeMonths));
+}
+
+qint64 Database::playerMemoryUsage() const
+{
+    qint64 rankingSize = 0;
+    for (const Ranking &ranking : m_rankings) {
+        for (const QVector<int> &indices : ranking.orders)
+            rankingSize += indices.capacity();
+    }
+
+    return qint64(m_players.capacity()) * sizeof(Player) + qint64(m_ids.capacity()) * sizeof(int)
+            + qint64(m_indexById.capacity()) * sizeof(int) + qint64(m_nameArena.capacity())
+            + qint64(m_lastSingle.capacity() + m_lastDouble.capacity() + rankingSize) * sizeof(int);
 }
 
 const Player *Database::getPlayer(int id) const
 {
-    const auto it = m_players.find(id);
-    return (it != m_players.end()) ? &it.value() : nullptr;
+    if (!m_indexById.isEmpty()) {
+        const int index = (id >= 0 && id < m_indexById.size()) ? m_indexById[id] : -1;
+        return (index >= 0) ? &m_players[index] : nullptr;
+    }
+
+    const auto it = std::lower_bound(m_ids.cbegin(), m_ids.cend(), id);
+    return (it != m_ids.cend() && *it == id) ? &m_players[it - m_ids.cbegin()] : nullptr;
 }
 
 QVector<const Player*> Database::searchPlayer(const QString &pattern) const
 {
+    CheapProfiler prof("Database::searchPlayer()");
+
     QVector<const Player*> ret;
 
-    for (auto it = m_players.begin(); it != m_players.end(); ++it) {
-        if (it->firstName.contains(pattern, Qt::CaseInsensitive) || it->lastName.contains(pattern, Qt::CaseInsensitive))
-            ret.push_back(&it.value());
+    const QByteArray namePattern = Player::namePattern(pattern);
+    for (const Player &player : m_players) {
+        if (player.nameContains(namePattern))
+            ret.push_back(&player);
     }
 
     return ret;
 }
 
-QVector<const Player*> Database::getPlayersByRanking(EloDomain domain, int start, int count) const
+const int Database::ACTIVITY_WINDOWS[2] = { 12, 24 };
+
+QVector<const Player*> Database::rankingSlice(int order, int start, int count, int activeMonths) const
 {
     QVector<const Player*> ret;
+    if (m_rankings.isEmpty())
+        return ret;
+
+    start = qMax(start, 0);
+    for (const Ranking &ranking : m_rankings) {
+        if (ranking.activeMonths == qMax(activeMonths, 0)) {
+            const QVector<int> &indices = ranking.orders[order];
+            const int end = (count > 0) ? qMin(start + count, indices.size()) : indices.size();
+            ret.reserve(qMax(end - start, 0));
+            for (int i = start; i < end; ++i)
+                ret << &m_players[indices[i]];
+            return ret;
+        }
+    }
+
+    // uncommon window, filter the ranking of all players
+    const int cutoff = activityCutoff(activeMonths);
+    for (int index : m_rankings.first().orders[order]) {
+        if (count > 0 && ret.size() >= count)
+            break;
+        if (!isActiveIndex(index, order, cutoff))
+            continue;
+        if (start > 0)
+            start--;
+        else
+            ret << &m_players[index];
+    }
+    return ret;
+}
 
-    for (auto it = m_players.begin(); it != m_players.end(); ++it)
-        ret << &it.value();
+QVector<const Player*> Database::getPlayersByRanking(EloDomain domain, int start, int count, int activeMonths) const
+{
+    CheapProfiler prof("Database::getPlayersByRanking()");
+    return rankingSlice((int) domain, start, count, activeMonths);
+}
+
+QVector<const Player*> Database::getPlayersByMatchCount(int start, int count, int activeMonths) const
+{
+    CheapProfiler prof("Database::getPlayersByMatchCount()");
+    return rankingSlice(GAMES_ORDER, start, count, activeMonths);
+}
 
-    std::sort(ret.begin(), ret.end(), [=](const Player *p1, const Player *p2) {
+int Database::getRankedPlayerCount(EloDomain domain, int activeMonths) const
+{
+    for (const Ranking &ranking : m_rankings) {
+        if (ranking.activeMonths == qMax(activeMonths, 0))
+            return ranking.orders[(int) domain].size();
+    }
+
+    const int cutoff = activityCutoff(activeMonths);
+    int ret = 0;
+    for (int i = 0; i < m_players.size(); ++i)
+        ret += isActiveIndex(i, (int) domain, cutoff) ? 1 : 0;
+    return ret;
+}
+
+QVector<RankingEntry> Database::getPlayersByRanking(EloDomain domain, const QDate &asOfDate, int start, int count)
+{
+    CheapProfiler prof("Database::getPlayersByRanking(asOfDate)");
+
+    const int date = asOfDate.year() * 10000 + asOfDate.month() * 100 + asOfDate.day();
+    ConnectionPool::Handle conn = m_pool->acquire();
+
+    QHash<int, RankingEntry> entries;
+    int firstPlayedMatch = 0;
+    int lastPlayedMatch = std::numeric_limits<int>::max();
+
+    //
+    // Start from the latest checkpoint, replay until the next one at most
+    //
+    if (m_hasRatingCheckpoints) {
+        QSqlQuery &checkpointQuery = conn.query(RatingCheckpointStatement);
+        checkpointQuery.bindValue(0, date);
+        checkpointQuery.exec();
+        if (checkpointQuery.next()) {
+            firstPlayedMatch = checkpointQuery.value(0).toInt();
+            const QByteArray blob = qUncompress(checkpointQuery.value(1).toByteArray());
+            const uchar *src = reinterpret_cast<const uchar*>(blob.constData());
+            const int n = blob.size() / 12;
+
+            entries.reserve(n);
+            for (int i = 0; i < n; ++i, src += 12) {
+                const int id = qFromLittleEndian<qint32>(src);
+                entries.insert(id, RankingEntry{ nullptr,
+                    qFromLittleEndian<qint16>(src + 4), qFromLittleEndian<qint16>(src + 6),
+                    qFromLittleEndian<qint16>(src + 8), qFromLittleEndian<quint16>(src + 10) });
+            }
+        }
+
+        QSqlQuery &nextQuery = conn.query(NextRatingCheckpointStatement);
+        nextQuery.bindValue(0, date);
+        nextQuery.exec();
+        if (nextQuery.next())
+            lastPlayedMatch = nextQuery.value(0).toInt();
+    }
+
+    QSqlQuery &replayQuery = conn.query(RatingReplayStatement);
+    replayQuery.bindValue(0, firstPlayedMatch);
+    replayQuery.bindValue(1, lastPlayedMatch);
+    replayQuery.exec();
+    while (replayQuery.next()) {
+        // played matches are in chronological order
+        const int matchDate = replayQuery.value(2).toInt() * 10000 + replayQuery.value(3).toInt() * 100 + replayQuery.value(4).toInt();
+        if (matchDate > date)
+            break;
+
+        const int id = replayQuery.value(0).toInt();
+        const MatchType matchType = (MatchType) replayQuery.value(1).toInt();
+        auto it = entries.find(id);
+        if (it == entries.end())
+            it = entries.insert(id, RankingEntry{ nullptr, 1000, 1000, 1000, 0 });
+
+        if (matchType == MatchType::Single)
+            it->eloSingle = replayQuery.value(5).toInt();
+        else
+            it->eloDouble = replayQuery.value(5).toInt();
+        it->eloCombined = replayQuery.value(6).toInt();
+        it->matchCount++;
+    }
+
+    //
+    // Rank them
+    //
+    QVector<RankingEntry> ret;
+    ret.reserve(entries.size());
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+        it->player = getPlayer(it.key());
+        if (it->player)
+            ret << it.value();
+    }
+
+    // ties are broken by id like in the current rankings, so that pages don't overlap
+    std::sort(ret.begin(), ret.end(), [=](const RankingEntry &e1, const RankingEntry &e2) {
         switch (domain) {
-        case EloDomain::Single: return p1->eloSingle > p2->eloSingle;
-        case EloDomain::Double: return p1->eloDouble > p2->eloDouble;
-        case EloDomain::Combined: return p1->eloCombined > p2->eloCombined;
+        case EloDomain::Single: if (e1.eloSingle != e2.eloSingle) return e1.eloSingle > e2.eloSingle; break;
+        case EloDomain::Double: if (e1.eloDouble != e2.eloDouble) return e1.eloDouble > e2.eloDouble; break;
+        case EloDomain::Combined: if (e1.eloCombined != e2.eloCombined) return e1.eloCombined > e2.eloCombined; break;
         }
+        return e1.player->id < e2.player->id;
     });
 
     if (start > 0)
@@ -202,21 +970,50 @@ QVector<const Player*> Database::getPlayersByRanking(EloDomain domain, int start
     return ret;
 }
 
+QVector<PairRankingEntry> Database::getPairsByRanking(int minMatches, int start, int count)
+{
+    CheapProfiler prof("Database::getPairsByRanking()");
+
+    QVector<PairRankingEntry> ret;
+    if (!m_hasPairRatings)
+        return ret;
+
+    ConnectionPool::Handle conn = m_pool->acquire();
+    QSqlQuery &query = conn.query(PairRankingStatement);
+    query.bindValue(0, minMatches);
+    query.bindValue(1, count);
+    query.bindValue(2, qMax(start, 0));
+    query.exec();
+    while (query.next()) {
+        const Player *p1 = getPlayer(query.value(0).toInt());
+        const Player *p2 = getPlayer(query.value(1).toInt());
+        if (p1 && p2) {
+            ret << PairRankingEntry{ p1, p2, (qint16) query.value(2).toInt(),
+                                     query.value(3).toInt(), query.value(4).toInt(), query.value(5).toInt() };
+        }
+    }
+
+    return ret;
+}
+
 int Database::getPlayerMatchCount(const Player *player, EloDomain domain)
 {
-    QSqlDatabase *db = getOrCreateDb();
-    const QString queryString(
-        "SELECT m.type, COUNT(m.type) "
-        "FROM played_matches AS pm "
-        "INNER JOIN matches AS m "
-        "   ON pm.match_id = m.id "
-        "WHERE pm.player_id = %1 "
-        "GROUP BY m.type"
-    );
+    CheapProfiler prof("Database::getPlayerMatchCount()");
+
+    if (m_snapshot) {
+        const Snapshot::Player *p = m_snapshot->findPlayer(player->id);
+        const int single = p ? p->singleCount : 0;
+        const int dbl = p ? p->doubleCount : 0;
+        return (domain == EloDomain::Single) ? single :
+               (domain == EloDomain::Double) ? dbl : single + dbl;
+    }
 
+    ConnectionPool::Handle conn = m_pool->acquire();
     int counts[2] = {0, 0};
 
-    QSqlQuery query(queryString.arg(player->id), *db);
+    QSqlQuery &query = conn.query(MatchCountStatement);
+    query.bindValue(0, player->id);
+    query.exec();
     while (query.next()) {
         const int domainIdx = query.value(0).toInt();
         const int count = query.value(1).toInt();
@@ -229,148 +1026,145 @@ int Database::getPlayerMatchCount(const Player *player, EloDomain domain)
            (domain == EloDomain::Combined) ? counts[0] + counts[1] : 0;
 }
 
-QVector<PlayerVsPlayerStats> Database::getPlayerVsPlayerStats(const Player *player)
+std::shared_ptr<const PlayerVsPlayerBlock> Database::getPlayerVsPlayerStats(const Player *player) const
 {
-    QSqlDatabase *db = getOrCreateDb();
-    QVector<PlayerVsPlayerStats> ret;
+    const int index = player ? int(player - m_players.constData()) : -1;
+    if (index < 0 || index >= m_pvpBlocks.size())
+        return std::make_shared<PlayerVsPlayerBlock>();
 
-    const QString queryString(
-        "SELECT other_id, "
-        "single_wins, single_draws, single_losses, "
-        "double_wins, double_draws, double_losses, "
-        "partner_wins, partner_draws, partner_losses, "
-        "combined_delta, double_delta, single_delta, "
-        "partner_combined_delta, partner_double_delta "
-        "FROM player_vs_player_stats AS pvp "
-        "WHERE pvp.player_id = %1"
-    );
+    return m_pvpBlocks[index];
+}
 
-    QSqlQuery query(queryString.arg(player->id), *db);
-    while (query.next()) {
-        const int otherId = query.value(0).toInt();
-        const qint16 singleWins = query.value(1).toInt();
-        const qint16 singleDraws = query.value(2).toInt();
-        const qint16 singleLosses = query.value(3).toInt();
-        const qint16 doubleWins = query.value(4).toInt();
-        const qint16 doubleDraws = query.value(5).toInt();
-        const qint16 doubleLosses = query.value(6).toInt();
-        const qint16 partnerWins = query.value(7).toInt();
-        const qint16 partnerDraws = query.value(8).toInt();
-        const qint16 partnerLosses = query.value(9).toInt();
-        const qint16 combinedDelta = query.value(10).toInt();
-        const qint16 doubleDelta = query.value(11).toInt();
-        const qint16 singleDelta = query.value(12).toInt();
-        const qint16 partnerCombinedDelta = query.value(13).toInt();
-        const qint16 partnerDoubleDelta = query.value(14).toInt();
-        ret << PlayerVsPlayerStats{
-            getPlayer(otherId),
-            singleWins, singleDraws, singleLosses,
-            doubleWins, doubleDraws, doubleLosses,
-            partnerWins, partnerDraws, partnerLosses,
-            singleDelta, doubleDelta, combinedDelta,
-            partnerCombinedDelta, partnerDoubleDelta
-        };
+QVector<Player::EloProgression> Database::getPlayerProgression(const Player *player)
+{
+    CheapProfiler prof("Database::getPlayerProgression()");
+
+    if (!player)
+        return QVector<Player::EloProgression>();
+
+    if (m_snapshot) {
+        QVector<Player::EloProgression> ret;
+        const Snapshot::Player *p = m_snapshot->findPlayer(player->id);
+        if (!p)
+            return ret;
+        if (!m_snapshot->contains(Snapshot::ProgressionSection, p->progressionBegin, p->progressionCount)) {
+            m_snapshot->damaged("progression");
+            return ret;
+        }
+
+        const Snapshot::ProgressionPoint *point = m_snapshot->section<Snapshot::ProgressionPoint>(Snapshot::ProgressionSection) + p->progressionBegin;
+        ret.reserve(p->progressionCount);
+        for (quint32 i = 0; i < p->progressionCount; ++i, ++point) {
+            ret << Player::EloProgression(point->year, point->month, point->day, point->single, point->dbl, point->combined);
+            ret.last().rankSingle = point->rankSingle;
+            ret.last().rankDouble = point->rankDouble;
+            ret.last().rankCombined = point->rankCombined;
+        }
+        return ret;
     }
 
-    return ret;
+    ConnectionPool::Handle conn = m_pool->acquire();
+    return m_hasStoredProgression ? readStoredProgression(conn, player) : computeProgression(conn, player);
 }
 
-QVector<Player::EloProgression> Database::getPlayerProgression(const Player *player)
+QVector<Player::EloProgression> Database::readStoredProgression(ConnectionPool::Handle &conn, const Player *player)
 {
     QVector<Player::EloProgression> ret;
-    QSqlDatabase *db = getOrCreateDb();
 
-    if (player) {
-        const QString ratingsQueryString(
-            "SELECT m.type, c.year, c.month, c.day, ec.rating, es.rating "
-            "FROM played_matches AS pm "
-            "INNER JOIN matches AS m "
-            "   ON pm.match_id = m.id "
-            "INNER JOIN competitions AS c "
-            "   ON m.competition_id = c.id "
-            "INNER JOIN elo_combined AS ec "
-            "   ON pm.id = ec.played_match_id "
-            "INNER JOIN elo_separate AS es "
-            "   ON pm.id = es.played_match_id "
-            "WHERE pm.player_id = %1"
-        );
-        QSqlQuery ratingsQuery(ratingsQueryString.arg(player->id), *db);
-
-        while (ratingsQuery.next()) {
-            const MatchType matchType = (MatchType) ratingsQuery.value(0).toInt();
-            const int year = ratingsQuery.value(1).toInt();
-            const int month = ratingsQuery.value(2).toInt();
-            const int day = ratingsQuery.value(3).toInt();
-            const int eloCombined = ratingsQuery.value(4).toInt();
-            const int eloSeparate = ratingsQuery.value(5).toInt();
-
-            if (ret.isEmpty()) {
-                ret << Player::EloProgression(year, month, day, eloSeparate, eloSeparate, eloCombined);
-            }
-            else {
-                int s = ret.last().eloSingle;
-                int d = ret.last().eloDouble;
-                if (matchType == MatchType::Single)
-                    s = eloSeparate;
-                else
-                    d = eloSeparate;
-                ret << Player::EloProgression(year, month, day, s, d, eloCombined);
-            }
+    QSqlQuery &query = conn.query(StoredProgressionStatement);
+    query.bindValue(0, player->id);
+    query.exec();
+    if (query.next()) {
+        const QByteArray blob = query.value(0).toByteArray();
+        const qint16 *src = reinterpret_cast<const qint16*>(blob.constData());
+        const int count = blob.size() / (6 * sizeof(qint16));
+
+        ret.reserve(count);
+        for (int i = 0; i < count; ++i, src += 6) {
+            ret << Player::EloProgression(qFromLittleEndian(src[0]), qFromLittleEndian(src[1]), qFromLittleEndian(src[2]),
+                                          qFromLittleEndian(src[3]), qFromLittleEndian(src[4]), qFromLittleEndian(src[5]));
         }
     }
 
-    std::sort(ret.begin(), ret.end(), [](const Player::EloProgression &a, const Player::EloProgression &b) {
-        if (a.year != b.year)
-            return a.year < b.year;
-        if (a.month != b.month)
-            return a.month < b.month;
-        return a.day < b.day;
-    });
+    if (!m_hasRankProgression || ret.isEmpty())
+        return ret;
+
+    // one rank triple per progression entry
+    QSqlQuery &rankQuery = conn.query(StoredRankProgressionStatement);
+    rankQuery.bindValue(0, player->id);
+    rankQuery.exec();
+    if (rankQuery.next()) {
+        const QByteArray blob = rankQuery.value(0).toByteArray();
+        const quint16 *src = reinterpret_cast<const quint16*>(blob.constData());
+        const int count = qMin(blob.size() / int(3 * sizeof(quint16)), ret.size());
+        for (int i = 0; i < count; ++i, src += 3) {
+            ret[i].rankSingle = qFromLittleEndian(src[0]);
+            ret[i].rankDouble = qFromLittleEndian(src[1]);
+            ret[i].rankCombined = qFromLittleEndian(src[2]);
+        }
+    }
+
+    return ret;
+}
+
+QVector<Player::EloProgression> Database::computeProgression(ConnectionPool::Handle &conn, const Player *player)
+{
+    QVector<Player::EloProgression> ret;
+
+    QSqlQuery &ratingsQuery = conn.query(ComputedProgressionStatement);
+    ratingsQuery.bindValue(0, player->id);
+    ratingsQuery.exec();
+
+    // like the scraper stores it: ratings after the matches, one point per day, 1000 until a domain is played
+    int s = 1000, d = 1000;
+    while (ratingsQuery.next()) {
+        const MatchType matchType = (MatchType) ratingsQuery.value(0).toInt();
+        const int year = ratingsQuery.value(1).toInt();
+        const int month = ratingsQuery.value(2).toInt();
+        const int day = ratingsQuery.value(3).toInt();
+        const int eloCombined = ratingsQuery.value(4).toInt();
+        const int eloSeparate = ratingsQuery.value(5).toInt();
+
+        if (matchType == MatchType::Single)
+            s = eloSeparate;
+        else
+            d = eloSeparate;
+
+        const Player::EloProgression point(year, month, day, s, d, eloCombined);
+        if (!ret.isEmpty() && ret.last().year == year && ret.last().month == month && ret.last().day == day)
+            ret.last() = point;
+        else
+            ret << point;
+    }
 
     return ret;
 }
 
 QVector<PlayerMatch> Database::getPlayerMatches(const Player *player, EloDomain domain, int start, int count)
 {
-    QSqlDatabase *db = getOrCreateDb();
+    CheapProfiler prof("Database::getPlayerMatches()");
+
+    if (m_snapshot)
+        return readSnapshotMatches(player, domain, start, count);
+
+    ConnectionPool::Handle conn = m_pool->acquire();
     QVector<PlayerMatch> ret;
 
     using PlayedMatch = QPair<int, int>;
     using CombinedSeparateElo = QPair<int, int>;
     QHash<PlayedMatch, CombinedSeparateElo> matchElos;
 
-    const QString whereString = QString("WHERE pm.player_id = %1 ").arg(player->id) +
-            ((domain == EloDomain::Single) ? "AND m.type = 1 " :
-             (domain == EloDomain::Double) ? "AND m.type = 2 " : "");
-
     if (count < 0)
         count = 10000;
 
-    const QString orderString = "ORDER BY pm.id DESC ";
-    const QString limitString =
-            (start > 0 || count > 0)
-            ? QString("LIMIT %1 OFFSET %2 ").arg(count).arg(start)
-            : QString();
-
     //
     // Read all ELO start rankings for all participants in all matches that the player has played
     //
-    const QString eloQueryString(
-        "SELECT pm2.match_id, pm2.player_id, ec.rating, es.rating "
-        "FROM played_matches AS pm2 "
-        "INNER JOIN elo_combined AS ec "
-        "   ON pm2.id = ec.played_match_id "
-        "INNER JOIN elo_separate AS es "
-        "   ON pm2.id = es.played_match_id "
-        "WHERE pm2.match_id IN ( "
-        "   SELECT pm.match_id "
-        "   FROM played_matches AS pm "
-        "   INNER JOIN matches AS m ON pm.match_id = m.id "
-        + whereString + orderString + limitString +
-        ") "
-    );
-
-    QSqlQuery eloQuery(eloQueryString, *db);
+    QSqlQuery &eloQuery = conn.query(MatchElosStatement + (int) domain);
+    eloQuery.bindValue(0, player->id);
+    eloQuery.bindValue(1, count);
+    eloQuery.bindValue(2, start);
+    eloQuery.exec();
     while (eloQuery.next()) {
         const int matchId = eloQuery.value(0).toInt();
         const int playerId = eloQuery.value(1).toInt();
@@ -382,20 +1176,11 @@ QVector<PlayerMatch> Database::getPlayerMatches(const Player *player, EloDomain
     //
     // Now read all match details
     //
-
-    QString queryString =
-        "SELECT pm.match_id, "
-        "       m.type, m.score1, m.score2, m.p1, m.p2, m.p11, m.p22, "
-        "       c.name, c.year, c.month, c.day, c.type, "
-        "       es.change, ec.change "
-        "FROM played_matches AS pm "
-        "INNER JOIN matches AS m ON pm.match_id = m.id "
-        "INNER JOIN competitions AS c ON m.competition_id = c.id "
-        "INNER JOIN elo_separate AS es ON pm.id = es.played_match_id "
-        "INNER JOIN elo_combined AS ec ON pm.id = ec.played_match_id "
-        + whereString + orderString + limitString;
-
-    QSqlQuery query(queryString, *db);
+    QSqlQuery &query = conn.query(MatchesStatement + (int) domain);
+    query.bindValue(0, player->id);
+    query.bindValue(1, count);
+    query.bindValue(2, start);
+    query.exec();
 
     while (query.next()) {
         const int matchId = query.value(0).toInt();
@@ -406,7 +1191,7 @@ QVector<PlayerMatch> Database::getPlayerMatches(const Player *player, EloDomain
         int p2  = query.value(5).toInt();
         int p11 = query.value(6).toInt();
         int p22 = query.value(7).toInt();
-        const QString competiton = query.value(8).toString();
+        const QString competiton = competitionName(query.value(15).toInt(), query.value(8).toString());
         const int year = query.value(9).toInt();
         const int month = query.value(10).toInt();
         const int day = query.value(11).toInt();
@@ -432,16 +1217,16 @@ QVector<PlayerMatch> Database::getPlayerMatches(const Player *player, EloDomain
         match.myself.eloCombined = matchElos[qMakePair(matchId, player->id)].first;
         match.myself.eloSeparate = matchElos[qMakePair(matchId, player->id)].second;
 
-        match.opponent1.player = &m_players[p2];
+        match.opponent1.player = getPlayer(p2);
         match.opponent1.eloCombined = matchElos[qMakePair(matchId, p2)].first;
         match.opponent1.eloSeparate = matchElos[qMakePair(matchId, p2)].second;
 
         if (matchType == MatchType::Double) {
-            match.partner.player = &m_players[p11];
+            match.partner.player = getPlayer(p11);
             match.partner.eloCombined = matchElos[qMakePair(matchId, p11)].first;
             match.partner.eloSeparate = matchElos[qMakePair(matchId, p11)].second;
 
-            match.opponent2.player = &m_players[p22];
+            match.opponent2.player = getPlayer(p22);
             match.opponent2.eloCombined = matchElos[qMakePair(matchId, p22)].first;
             match.opponent2.eloSeparate = matchElos[qMakePair(matchId, p22)].second;
         }
@@ -458,4 +1243,95 @@ QVector<PlayerMatch> Database::getPlayerMatches(const Player *player, EloDomain
     return ret;
 }
 
+QString Database::competitionName(int competitionId, const QString &name)
+{
+    QMutexLocker lock(&m_competitionNamesMutex);
+    auto it = m_competitionNames.find(competitionId);
+    if (it == m_competitionNames.end())
+        it = m_competitionNames.insert(competitionId, name);
+    return it.value();
+}
+
+QVector<PlayerMatch> Database::readSnapshotMatches(const Player *player, EloDomain domain, int start, int count)
+{
+    QVector<PlayerMatch> ret;
+    const Snapshot::Player *p = m_snapshot->findPlayer(player->id);
+    if (!p)
+        return ret;
+
+    if (count < 0)
+        count = 10000;
+
+    if (!m_snapshot->contains(Snapshot::PlayedMatchesSection, p->playedBegin, p->playedCount)) {
+        m_snapshot->damaged("played matches");
+        return ret;
+    }
+    const Snapshot::PlayedMatch *played = m_snapshot->section<Snapshot::PlayedMatch>(Snapshot::PlayedMatchesSection) + p->playedBegin;
+
+    // played matches are stored newest first, like the sql queries order them
+    for (quint32 i = 0; i < p->playedCount && ret.size() < count; ++i) {
+        const Snapshot::PlayedMatch &pm = played[i];
+        const Snapshot::Match *mp = m_snapshot->at<Snapshot::Match>(Snapshot::MatchesSection, pm.match);
+        const Snapshot::Competition *cp = mp ? m_snapshot->at<Snapshot::Competition>(Snapshot::CompetitionsSection, mp->competition) : nullptr;
+        if (!cp || mp->competition >= (quint32) m_snapshotCompetitionNames.size()) {
+            m_snapshot->damaged("match");
+            continue;
+        }
+        const Snapshot::Match &m = *mp;
+        const Snapshot::Competition &c = *cp;
+        const MatchType matchType = (MatchType) m.type;
+        if ((domain == EloDomain::Single && matchType != MatchType::Single)
+                || (domain == EloDomain::Double && matchType != MatchType::Double))
+            continue;
+        if (start > 0) {
+            start--;
+            continue;
+        }
+
+        // slots of p1, p2, p11, p22 in the match, swapped such that the player is p1
+        int s1 = 0, s2 = 1, s11 = 2, s22 = 3;
+        int score1 = m.score1;
+        int score2 = m.score2;
+        if (m.players[s2] == player->id || m.players[s22] == player->id) {
+            qSwap(s1, s2);
+            qSwap(s11, s22);
+            qSwap(score1, score2);
+        }
+        if (m.players[s11] == player->id)
+            qSwap(s1, s11);
+
+        const auto participant = [&](int slot) {
+            PlayerMatch::Participant ret;
+            ret.player = getPlayer(m.players[slot]);
+            ret.eloCombined = m.eloCombined[slot];
+            ret.eloSeparate = m.eloSeparate[slot];
+            return ret;
+        };
+
+        PlayerMatch match;
+        match.date = QDateTime(QDate(c.year, c.month, c.day));
+        match.competitionName = m_snapshotCompetitionNames[m.competition];
+        match.competitionType = (CompetitionType) c.type;
+        match.matchType = matchType;
+
+        match.myself = participant(s1);
+        match.myself.player = player;
+        match.opponent1 = participant(s2);
+        if (matchType == MatchType::Double) {
+            match.partner = participant(s11);
+            match.opponent2 = participant(s22);
+        }
+
+        match.myScore = score1;
+        match.opponentScore = score2;
+
+        match.eloSeparateDiff = pm.separateChange;
+        match.eloCombinedDiff = pm.combinedChange;
+
+        ret << match;
+    }
+
+    return ret;
+}
+
 } // namespace FoosDB
@@ -5,13 +5,18 @@
 #include <QPair>
 #include <QHash>
 #include <QDateTime>
-#include <QReadWriteLock>
 #include <QVector>
+#include <QMutex>
+#include <QByteArray>
 
-class QThread;
+#include <memory>
+
+#include "connectionpool.hpp"
 
 namespace FoosDB {
 
+class MappedSnapshot;
+
 enum class EloDomain
 {
     Single,
@@ -51,18 +56,70 @@ struct PlayerVsPlayerStats
     Results partnerCombinedResults() const { return Results{partnerCombinedDiff, partnerWins, partnerDraws, partnerLosses}; }
 };
 
+enum class PvpRole
+{
+    Opponent,
+    Partner
+};
+
+/*
+ * All player-vs-player stats of one player, with the orderings by ELO delta for every
+ * domain/role precomputed on construction, so that top-k/bottom-k queries are O(k).
+ */
+class PlayerVsPlayerBlock
+{
+public:
+    PlayerVsPlayerBlock() = default;
+    explicit PlayerVsPlayerBlock(const QVector<PlayerVsPlayerStats> &stats);
+
+    int size() const { return m_stats.size(); }
+
+    // up to k entries with a positive delta, highest delta first
+    QVector<const PlayerVsPlayerStats*> top(EloDomain domain, PvpRole role, int k) const;
+    // up to k entries with a negative delta, lowest delta first
+    QVector<const PlayerVsPlayerStats*> bottom(EloDomain domain, PvpRole role, int k) const;
+
+    static PlayerVsPlayerStats::Results results(const PlayerVsPlayerStats &stats, EloDomain domain, PvpRole role);
+
+private:
+    static int orderIndex(EloDomain domain, PvpRole role);
+
+    struct Order {
+        QVector<int> indices;   // only entries with non-zero delta, sorted by delta descending
+        int positiveCount = 0;
+    };
+
+    QVector<PlayerVsPlayerStats> m_stats;
+    Order m_orders[5];
+};
+
+/*
+ * A player as loaded by the Database, which keeps all players in one array that is never
+ * resized after loading, so pointers stay valid for the Database's lifetime. Names live in
+ * the Database's UTF-8 name arena, first name directly followed by last name.
+ */
 struct Player
 {
     int id;
+    int matchCount;
 
-    QString firstName;
-    QString lastName;
+    qint16 eloSingle;
+    qint16 eloDouble;
+    qint16 eloCombined;
 
-    int eloSingle;
-    int eloDouble;
-    int eloCombined;
+    QString firstName() const { return QString::fromUtf8(names->constData() + nameOffset, firstNameSize); }
+    QString lastName() const { return QString::fromUtf8(names->constData() + nameOffset + firstNameSize, lastNameSize); }
 
-    int matchCount;
+    // case insensitive match on the first or last name, without any allocations. The pattern
+    // has to be prepared once by namePattern(), which case folds its code points; names are
+    // decoded and folded one code point at a time while matching.
+    static QVector<uint> namePattern(const QString &pattern);
+    bool nameContains(const QVector<uint> &pattern) const;
+
+    const QByteArray *names;
+    quint32 nameOffset;
+    quint16 firstNameSize;  // in bytes
+    quint16 lastNameSize;
 
     struct EloProgression
     {
@@ -72,13 +129,37 @@ struct Player
         qint16 eloSingle = 0;
         qint16 eloDouble = 0;
         qint16 eloCombined = 0;
+        // ranks at the end of the day, 0 if unranked or unknown (databases from older scrapers)
+        quint16 rankSingle = 0;
+        quint16 rankDouble = 0;
+        quint16 rankCombined = 0;
         EloProgression() = default;
         EloProgression(const EloProgression&) = default;
         EloProgression(qint16 yy, quint16 mm, quint16 dd, int s, int d, int c);
     };
-    QVector<EloProgression> progression;
+};
+
+// a player's ratings as of some date, see Database::getPlayersByRanking(domain, asOfDate)
+struct RankingEntry
+{
+    const Player *player;
+    qint16 eloSingle;
+    qint16 eloDouble;
+    qint16 eloCombined;
+    int matchCount;
+};
+
+// a double team's current rating, see Database::getPairsByRanking()
+struct PairRankingEntry
+{
+    const Player *player1;
+    const Player *player2;
+    qint16 rating;
+    int wins;
+    int draws;
+    int losses;
 
-    QVector<PlayerVsPlayerStats> pvpStats;
+    int matchCount() const { return wins + draws + losses; }
 };
 
 struct PlayerMatch
@@ -106,40 +187,127 @@ struct PlayerMatch
     int eloCombinedDiff;
 };
 
-class Database
+class Database : public std::enable_shared_from_this<Database>
 {
 public:
+    // registers a database; it is only loaded on first access through instance()
     static void create(const std::string &name, const std::string &path);
     static void destroy();
 
+    // loads the database if needed, returns nullptr for unknown names. Databases nobody holds
+    // a reference to are evicted, least recently used first, once more than
+    // ELO_MAX_LOADED_DBS are loaded.
+    static std::shared_ptr<Database> instance(const std::string &name);
+
     const std::string &name() const { return m_name; }
 
-    static Database *instance(const std::string &name);
+    // unique for every load of a database, used to invalidate data cached elsewhere
+    int generation() const { return m_generation; }
 
     const Player *getPlayer(int id) const;
     int getPlayerCount() const { return m_players.size(); }
+    // heap bytes held by the player table, its id index, the name arena and the rankings
+    qint64 playerMemoryUsage() const;
     QVector<const Player*> searchPlayer(const QString &pattern) const;
-    QVector<const Player*> getPlayersByRanking(EloDomain domain, int start = 0, int count = -1) const;
+
+    // Rankings, optionally only of players who played in the domain (or at all, for the match
+    // count) within activeMonths before the latest match in the database. Rankings for all
+    // players and the ACTIVITY_WINDOWS are precomputed, so a page costs O(count).
+    static const int ACTIVITY_WINDOWS[2];
+    QVector<const Player*> getPlayersByRanking(EloDomain domain, int start = 0, int count = -1, int activeMonths = 0) const;
+    QVector<const Player*> getPlayersByMatchCount(int start = 0, int count = -1, int activeMonths = 0) const;
+    int getRankedPlayerCount(EloDomain domain, int activeMonths = 0) const;
+    bool isActive(const Player *player, EloDomain domain, int activeMonths) const;
+
+    // the ranking of all players that had played until the end of the given day, with their
+    // ratings at that time. Starts from the latest weekly rating checkpoint before that day, and
+    // replays the matches played since. Databases without checkpoints replay all matches.
+    QVector<RankingEntry> getPlayersByRanking(EloDomain domain, const QDate &asOfDate, int start = 0, int count = -1);
+
+    // double teams by their pair rating, only those that played at least minMatches together
+    QVector<PairRankingEntry> getPairsByRanking(int minMatches, int start = 0, int count = -1);
 
     int getPlayerMatchCount(const Player *player, EloDomain domain);
     QVector<PlayerMatch> getPlayerMatches(const Player *player, EloDomain domain, int start = 0, int count = -1);
-    QVector<PlayerVsPlayerStats> getPlayerVsPlayerStats(const Player *player);
+    // built for all players on load; the blocks don't keep the database alive
+    std::shared_ptr<const PlayerVsPlayerBlock> getPlayerVsPlayerStats(const Player *player) const;
     QVector<Player::EloProgression> getPlayerProgression(const Player *player);
 
 private:
     Database(const std::string &name, const std::string &dbPath);
     ~Database();
 
+    void openSnapshot(const QString &dbPath);
     void readData();
-    QSqlDatabase *getOrCreateDb();
+    void readSnapshotData();
+
+    struct LoadedPlayer {
+        int id;
+        QString firstName, lastName;
+        int eloSingle, eloDouble, eloCombined, matchCount;
+        int lastSingle, lastDouble;     // yyyymmdd of the last match, 0 if none
+    };
+    void buildPlayerTable(QVector<LoadedPlayer> &players);
+    void buildRankings();
+    void buildPvpBlocks(const QVector<QVector<PlayerVsPlayerStats>> &stats);
+
+    static const int GAMES_ORDER = 3;   // after the EloDomains
+    int activityCutoff(int activeMonths) const;
+    bool isActiveIndex(int index, int order, int cutoff) const;
+    QVector<const Player*> rankingSlice(int order, int start, int count, int activeMonths) const;
+
+    QString competitionName(int competitionId, const QString &name);
+
+    QVector<Player::EloProgression> readStoredProgression(ConnectionPool::Handle &conn, const Player *player);
+    QVector<Player::EloProgression> computeProgression(ConnectionPool::Handle &conn, const Player *player);
+    QVector<PlayerMatch> readSnapshotMatches(const Player *player, EloDomain domain, int start, int count);
 
     std::string m_name;
+    int m_generation;
+
+    // all Wt threads share a fixed number of connections with cached prepared statements
+    std::unique_ptr<ConnectionPool> m_pool;
+
+    // sorted by id; m_ids holds the same ids as a dense array for binary searching, unless
+    // ids are dense enough to use the direct id -> index table m_indexById
+    QVector<Player> m_players;
+    QVector<int> m_ids;
+    QVector<int> m_indexById;
+    QByteArray m_nameArena;
+
+    // yyyymmdd of every player's last single and double match, indexed like m_players
+    QVector<int> m_lastSingle;
+    QVector<int> m_lastDouble;
+    int m_lastMatchDate = 0;
+
+    // indices into m_players, sorted by EloDomain or by GAMES_ORDER
+    struct Ranking {
+        int activeMonths;
+        QVector<int> orders[4];
+    };
+    QVector<Ranking> m_rankings;
+
+    // every player's PVP stats with their orderings, indexed like m_players
+    QVector<std::shared_ptr<const PlayerVsPlayerBlock>> m_pvpBlocks;
+
+    // competition names are shared by all matches read from sqlite, keyed by competition id
+    QMutex m_competitionNamesMutex;
+    QHash<int, QString> m_competitionNames;
+    // the same for the snapshot, indexed like its competitions section
+    QVector<QString> m_snapshotCompetitionNames;
 
-    // each thread needs to have its own database connection
-    QReadWriteLock m_dbLock;
-    QHash<QThread*, QSqlDatabase*> m_dbs;
+    // the scraper's snapshot of this database, if there is a valid one; everything but
+    // the connection pool is then read from it instead of sqlite
+    std::unique_ptr<MappedSnapshot> m_snapshot;
 
-    QHash<int, Player> m_players;
+    // databases written by older scrapers don't have the precomputed progression table
+    bool m_hasStoredProgression = false;
+    // ... or the rating checkpoints
+    bool m_hasRatingCheckpoints = false;
+    // ... or the rank progression
+    bool m_hasRankProgression = false;
+    // ... or the pair ratings
+    bool m_hasPairRatings = false;
 };
 
 } // namespace Database
@@ -0,0 +1,242 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QThread>
+#include <QFileInfo>
+#include <QFile>
+#include <QDebug>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <thread>
+
+#include "database.hpp"
+
+/*
+ * Microbenchmarks for the FoosDB::Database query methods.
+ *
+ * Every method is run against every given database, cold (on a freshly loaded Database,
+ * i.e. no prepared statements and empty SQLite caches, every call for a different
+ * player) and warm (after one untimed pass over the same players), with each of the given
+ * thread counts. Results are printed as a table and optionally written as JSON.
+ */
+
+using Method = std::function<void(FoosDB::Database *db, const FoosDB::Player *player)>;
+
+struct Benchmark
+{
+    const char *name;
+    Method fn;
+};
+
+static const Benchmark BENCHMARKS[] = {
+    { "getPlayer x100", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        // a mix of hits and misses around the player's id
+        for (int i = 0; i < 100; ++i)
+            db->getPlayer(player->id ^ i);
+    }},
+    { "getPlayersByRanking", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->getPlayersByRanking(FoosDB::EloDomain::Combined, player->id % qMax(db->getPlayerCount(), 1), 20);
+    }},
+    { "getPlayersByRanking active", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        const int months = FoosDB::Database::ACTIVITY_WINDOWS[0];
+        const int count = db->getRankedPlayerCount(FoosDB::EloDomain::Combined, months);
+        db->getPlayersByRanking(FoosDB::EloDomain::Combined, player->id % qMax(count, 1), 20, months);
+    }},
+    { "searchPlayer", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->searchPlayer(player->lastName().left(3));
+    }},
+    { "getPlayerMatches", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->getPlayerMatches(player, FoosDB::EloDomain::Combined, 0, 20);
+    }},
+    { "getPlayerVsPlayerStats", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->getPlayerVsPlayerStats(player);
+    }},
+    { "getPlayerProgression", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->getPlayerProgression(player);
+    }},
+    { "getPlayerMatchCount", [](FoosDB::Database *db, const FoosDB::Player *player) {
+        db->getPlayerMatchCount(player, FoosDB::EloDomain::Combined);
+    }},
+};
+
+struct Result
+{
+    QString database;
+    int players;
+    bool cold;
+    int threads;
+    QString method;
+    QVector<qint64> usecs;      // sorted
+    qint64 wallUsecs;
+
+    qint64 percentile(double p) const
+    {
+        return usecs.isEmpty() ? 0 : usecs[qBound(0, int(p * (usecs.size() - 1) + 0.5), usecs.size() - 1)];
+    }
+
+    QJsonObject toJson() const
+    {
+        qint64 sum = 0;
+        for (qint64 u : usecs)
+            sum += u;
+
+        return QJsonObject{
+            { "database", database },
+            { "players", players },
+            { "mode", cold ? "cold" : "warm" },
+            { "threads", threads },
+            { "method", method },
+            { "calls", usecs.size() },
+            { "p50Usecs", percentile(0.5) },
+            { "p90Usecs", percentile(0.9) },
+            { "p99Usecs", percentile(0.99) },
+            { "maxUsecs", usecs.isEmpty() ? 0 : usecs.last() },
+            { "meanUsecs", usecs.isEmpty() ? 0.0 : double(sum) / usecs.size() },
+            { "callsPerSec", usecs.size() * 1e6 / qMax(wallUsecs, qint64(1)) },
+        };
+    }
+};
+
+// runs fn once per player, distributing the players over the given number of threads
+static void run(FoosDB::Database *db, const Method &fn, const QVector<const FoosDB::Player*> &players,
+                int threadCount, Result &result)
+{
+    std::vector<QVector<qint64>> latencies(threadCount);
+    std::vector<std::thread> threads;
+
+    QElapsedTimer wall;
+    wall.start();
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            for (int i = t; i < players.size(); i += threadCount) {
+                QElapsedTimer timer;
+                timer.start();
+                fn(db, players[i]);
+                latencies[t] << timer.nsecsElapsed() / 1000;
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    result.wallUsecs = wall.nsecsElapsed() / 1000;
+
+    for (const QVector<qint64> &l : latencies)
+        result.usecs += l;
+    std::sort(result.usecs.begin(), result.usecs.end());
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("dbbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks the FoosDB::Database query methods");
+    parser.addHelpOption();
+    parser.addPositionalArgument("sqlite", "Databases to benchmark, e.g. fixtures of different sizes", "<sqlite>...");
+    QCommandLineOption callsOption(QStringList{"calls", "c"}, "Calls per method and run (default: 1000)", "count", "1000");
+    parser.addOption(callsOption);
+    QCommandLineOption threadsOption(QStringList{"threads", "j"}, "Comma separated thread counts (default: 1,<cores>)", "list");
+    parser.addOption(threadsOption);
+    QCommandLineOption outputOption(QStringList{"output", "o"}, "Write results as JSON to this file", "path");
+    parser.addOption(outputOption);
+    QCommandLineOption seedOption(QStringList{"seed"}, "Random seed for picking players", "seed", "1");
+    parser.addOption(seedOption);
+
+    parser.process(app);
+    if (parser.positionalArguments().isEmpty())
+        parser.showHelp(1);
+
+    const int calls = qMax(parser.value(callsOption).toInt(), 1);
+
+    QVector<int> threadCounts;
+    if (parser.isSet(threadsOption)) {
+        for (const QString &str : parser.value(threadsOption).split(',')) {
+            if (!str.trimmed().isEmpty())
+                threadCounts << qMax(str.toInt(), 1);
+        }
+    }
+    else {
+        threadCounts << 1;
+        if (QThread::idealThreadCount() > 1)
+            threadCounts << QThread::idealThreadCount();
+    }
+
+    std::mt19937 random(parser.value(seedOption).toUInt());
+
+    int instance = 0;
+    for (const QString &path : parser.positionalArguments()) {
+        const std::string name = "bench" + std::to_string(instance++);
+        FoosDB::Database::create(name, path.toStdString());
+        const std::shared_ptr<FoosDB::Database> db = FoosDB::Database::instance(name);
+        printf("%s: %d players, %lld bytes of player storage, %.1f bytes per player\n",
+               qPrintable(QFileInfo(path).fileName()), db->getPlayerCount(),
+               db->playerMemoryUsage(), double(db->playerMemoryUsage()) / qMax(db->getPlayerCount(), 1));
+    }
+    printf("\n");
+
+    printf("%-24s %-10s %5s %4s %-24s %7s %9s %9s %9s %11s\n",
+           "database", "players", "mode", "thr", "method", "calls", "p50 us", "p90 us", "p99 us", "calls/s");
+
+    QJsonArray results;
+    for (const QString &path : parser.positionalArguments()) {
+        for (bool cold : { true, false }) {
+            for (int threads : threadCounts) {
+                for (const Benchmark &benchmark : BENCHMARKS) {
+                    // a fresh load for every run, warm runs first make an untimed pass
+                    FoosDB::Database::destroy();
+                    const std::string name = "bench" + std::to_string(instance++);
+                    FoosDB::Database::create(name, path.toStdString());
+                    const std::shared_ptr<FoosDB::Database> dbRef = FoosDB::Database::instance(name);
+                    FoosDB::Database *db = dbRef.get();
+
+                    QVector<const FoosDB::Player*> all = db->getPlayersByRanking(FoosDB::EloDomain::Combined);
+                    if (all.isEmpty()) {
+                        qWarning() << "No players in" << path;
+                        break;
+                    }
+
+                    // cold runs use every player once (as far as possible), warm ones repeat a small set
+                    std::shuffle(all.begin(), all.end(), random);
+                    const int distinct = qMin(cold ? calls : 100, all.size());
+                    QVector<const FoosDB::Player*> players;
+                    for (int i = 0; i < calls; ++i)
+                        players << all[i % distinct];
+
+                    if (!cold) {
+                        Result warmup;
+                        run(db, benchmark.fn, players.mid(0, distinct), threads, warmup);
+                    }
+
+                    Result result{ path, db->getPlayerCount(), cold, threads, benchmark.name, {}, 0 };
+                    run(db, benchmark.fn, players, threads, result);
+                    results.append(result.toJson());
+
+                    printf("%-24s %-10d %5s %4d %-24s %7d %9lld %9lld %9lld %11.0f\n",
+                           qPrintable(QFileInfo(path).fileName().left(24)), result.players, cold ? "cold" : "warm",
+                           threads, benchmark.name, result.usecs.size(),
+                           result.percentile(0.5), result.percentile(0.9), result.percentile(0.99),
+                           result.usecs.size() * 1e6 / qMax(result.wallUsecs, qint64(1)));
+                    fflush(stdout);
+                }
+            }
+        }
+    }
+    FoosDB::Database::destroy();
+
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            qCritical() << "Failed to write" << file.fileName();
+            return 1;
+        }
+        file.write(QJsonDocument(results).toJson());
+    }
+
+    return 0;
+}
@@ -1,6 +1,7 @@
 #include "global.hpp"
 
 #include <QByteArray>
+#include <QThread>
 #include <QDebug>
 
 const char * const ENV_INTERNAL_PATH = "ELO_USE_INTERNAL_PATHS";
@@ -8,6 +9,13 @@ const char * const ENV_DEPLOY_PREFIX = "ELO_DEPLOY_PREFIX";
 const char * const ENV_DB_PATH_BERLIN = "ELO_DB_PATH_BERLIN";
 const char * const ENV_DB_PATH_GERMANY = "ELO_DB_PATH_GERMANY";
 const char * const ENV_LOG_PATH = "ELO_LOG_PATH";
+const char * const ENV_DB_POOL_SIZE = "ELO_DB_POOL_SIZE";
+const char * const ENV_PAGE_CACHE_MB = "ELO_PAGE_CACHE_MB";
+const char * const ENV_LOADER_THREADS = "ELO_LOADER_THREADS";
+const char * const ENV_LOG_MAX_MB = "ELO_LOG_MAX_MB";
+const char * const ENV_MAX_LOADED_DBS = "ELO_MAX_LOADED_DBS";
+const char * const ENV_REGIONS_CONFIG = "ELO_REGIONS_CONFIG";
+const char * const ENV_METRICS_ALLOW = "ELO_METRICS_ALLOW";
 
 static bool checkUseInternalPaths()
 {
@@ -37,3 +45,145 @@ const std::string &deployPrefix()
     static const std::string s_empty;
     return useInternalPaths() ? s_empty : s_deployPrefix;
 }
+
+static int checkDbPoolSize()
+{
+    const QByteArray value = qgetenv(ENV_DB_POOL_SIZE);
+
+    // default to one connection per core
+    if (value.isEmpty())
+        return QThread::idealThreadCount();
+
+    bool ok = false;
+    const int size = value.toInt(&ok);
+    if (!ok || size <= 0) {
+        qCritical() << "Invalid value for" << ENV_DB_POOL_SIZE;
+        return QThread::idealThreadCount();
+    }
+
+    return size;
+}
+
+int dbPoolSize()
+{
+    static int size = checkDbPoolSize();
+    return size;
+}
+
+static int checkPageCacheSize()
+{
+    const QByteArray value = qgetenv(ENV_PAGE_CACHE_MB);
+
+    // default to 64 MB
+    if (value.isEmpty())
+        return 64;
+
+    bool ok = false;
+    const int size = value.toInt(&ok);
+    if (!ok || size < 0) {
+        qCritical() << "Invalid value for" << ENV_PAGE_CACHE_MB;
+        return 64;
+    }
+
+    return size;
+}
+
+int pageCacheSizeMB()
+{
+    static int size = checkPageCacheSize();
+    return size;
+}
+
+static int checkLoaderThreadCount()
+{
+    const QByteArray value = qgetenv(ENV_LOADER_THREADS);
+
+    // default to one loader per database connection, more would only wait for the pool
+    if (value.isEmpty())
+        return dbPoolSize();
+
+    bool ok = false;
+    const int count = value.toInt(&ok);
+    if (!ok || count <= 0) {
+        qCritical() << "Invalid value for" << ENV_LOADER_THREADS;
+        return dbPoolSize();
+    }
+
+    return count;
+}
+
+int loaderThreadCount()
+{
+    static int count = checkLoaderThreadCount();
+    return count;
+}
+
+static int checkLogFileSize()
+{
+    const QByteArray value = qgetenv(ENV_LOG_MAX_MB);
+
+    // default to 64 MB, 0 disables rotation
+    if (value.isEmpty())
+        return 64;
+
+    bool ok = false;
+    const int size = value.toInt(&ok);
+    if (!ok || size < 0) {
+        qCritical() << "Invalid value for" << ENV_LOG_MAX_MB;
+        return 64;
+    }
+
+    return size;
+}
+
+int logFileSizeMB()
+{
+    static int size = checkLogFileSize();
+    return size;
+}
+
+static int checkMaxLoadedDatabases()
+{
+    const QByteArray value = qgetenv(ENV_MAX_LOADED_DBS);
+
+    // default to no limit
+    if (value.isEmpty())
+        return 0;
+
+    bool ok = false;
+    const int count = value.toInt(&ok);
+    if (!ok || count < 0) {
+        qCritical() << "Invalid value for" << ENV_MAX_LOADED_DBS;
+        return 0;
+    }
+
+    return count;
+}
+
+int maxLoadedDatabases()
+{
+    static int count = checkMaxLoadedDatabases();
+    return count;
+}
+
+static std::vector<std::string> checkMetricsAllowedAddresses()
+{
+    const QByteArray value = qgetenv(ENV_METRICS_ALLOW);
+
+    // default to local scrapers only
+    if (value.isEmpty())
+        return { "127.0.0.1", "::1" };
+
+    std::vector<std::string> ret;
+    for (const QByteArray &address : value.split(',')) {
+        if (!address.trimmed().isEmpty())
+            ret.push_back(address.trimmed().toStdString());
+    }
+    return ret;
+}
+
+const std::vector<std::string> &metricsAllowedAddresses()
+{
+    static const std::vector<std::string> addresses = checkMetricsAllowedAddresses();
+    return addresses;
+}
@@ -1,12 +1,34 @@
 #pragma once
 
 #include <string>
+#include <vector>
+
+// size of the ELO progression chart in pixels; progressions are downsampled to one point per pixel
+const int CHART_WIDTH = 760;
+const int CHART_HEIGHT = 400;
+
+// matches per page of a player's match list, in the app, the JSON API and the static export
+const int MATCHES_PER_PAGE = 20;
 
 extern const char * const ENV_INTERNAL_PATH;
 extern const char * const ENV_DEPLOY_PREFIX;
 extern const char * const ENV_DB_PATH_BERLIN;
 extern const char * const ENV_DB_PATH_GERMANY;
 extern const char * const ENV_LOG_PATH;
+extern const char * const ENV_DB_POOL_SIZE;
+extern const char * const ENV_PAGE_CACHE_MB;
+extern const char * const ENV_LOADER_THREADS;
+extern const char * const ENV_LOG_MAX_MB;
+extern const char * const ENV_MAX_LOADED_DBS;
+extern const char * const ENV_REGIONS_CONFIG;
+extern const char * const ENV_METRICS_ALLOW;
 
 bool useInternalPaths();
 const std::string &deployPrefix();
+int dbPoolSize();
+int pageCacheSizeMB();
+int loaderThreadCount();
+int logFileSizeMB();
+int maxLoadedDatabases();
+// client addresses that may read /metrics
+const std::vector<std::string> &metricsAllowedAddresses();
@@ -0,0 +1,231 @@
+#include "jsonexport.hpp"
+#include "playercache.hpp"
+
+#include <QJsonArray>
+
+namespace JsonExport {
+
+static const int PVP_ENTRIES = 4;
+
+bool parseDomain(const QString &str, FoosDB::EloDomain &domain)
+{
+    if (str == "single")
+        domain = FoosDB::EloDomain::Single;
+    else if (str == "double")
+        domain = FoosDB::EloDomain::Double;
+    else if (str == "combined")
+        domain = FoosDB::EloDomain::Combined;
+    else
+        return false;
+    return true;
+}
+
+bool parseRankingOrder(const QString &str, RankingOrder &order)
+{
+    FoosDB::EloDomain domain;
+    if (parseDomain(str, domain))
+        order = (RankingOrder) domain;
+    else if (str == "games")
+        order = RankingOrder::Games;
+    else
+        return false;
+    return true;
+}
+
+QString domainName(FoosDB::EloDomain domain)
+{
+    switch (domain) {
+    case FoosDB::EloDomain::Single: return "single";
+    case FoosDB::EloDomain::Double: return "double";
+    case FoosDB::EloDomain::Combined: return "combined";
+    }
+    return QString();
+}
+
+QString rankingOrderName(RankingOrder order)
+{
+    return (order == RankingOrder::Games) ? QString("games") : domainName((FoosDB::EloDomain) order);
+}
+
+static QJsonValue playerRef(const FoosDB::Player *player)
+{
+    if (!player)
+        return QJsonValue();
+
+    return QJsonObject{
+        { "id", player->id },
+        { "firstName", player->firstName() },
+        { "lastName", player->lastName() },
+    };
+}
+
+static QJsonObject elos(int single, int dbl, int combined)
+{
+    return QJsonObject{
+        { "single", single },
+        { "double", dbl },
+        { "combined", combined },
+    };
+}
+
+static QJsonObject results(const FoosDB::PlayerVsPlayerStats &stats, FoosDB::EloDomain domain, FoosDB::PvpRole role)
+{
+    const FoosDB::PlayerVsPlayerStats::Results res = FoosDB::PlayerVsPlayerBlock::results(stats, domain, role);
+    return QJsonObject{
+        { "player", playerRef(stats.player) },
+        { "delta", res.delta },
+        { "wins", res.wins },
+        { "draws", res.draws },
+        { "losses", res.losses },
+    };
+}
+
+QJsonObject ranking(FoosDB::Database *db, RankingOrder order, int start, int count, int activeMonths)
+{
+    // the match count ranking includes everyone active in any domain
+    const FoosDB::EloDomain countDomain = (order == RankingOrder::Games) ? FoosDB::EloDomain::Combined : (FoosDB::EloDomain) order;
+    const QVector<const FoosDB::Player*> players = (order == RankingOrder::Games)
+            ? db->getPlayersByMatchCount(start, count, activeMonths)
+            : db->getPlayersByRanking((FoosDB::EloDomain) order, start, count, activeMonths);
+
+    QJsonArray entries;
+    for (int i = 0; i < players.size(); ++i) {
+        const FoosDB::Player *p = players[i];
+        entries.append(QJsonObject{
+            { "rank", start + i + 1 },
+            { "player", playerRef(p) },
+            { "elo", elos(p->eloSingle, p->eloDouble, p->eloCombined) },
+            { "matchCount", p->matchCount },
+        });
+    }
+
+    return QJsonObject{
+        { "database", QString::fromStdString(db->name()) },
+        { "order", rankingOrderName(order) },
+        { "start", start },
+        { "activeMonths", activeMonths },
+        { "playerCount", db->getRankedPlayerCount(countDomain, activeMonths) },
+        { "entries", entries },
+    };
+}
+
+QJsonObject pairRanking(FoosDB::Database *db, int minMatches, int start, int count)
+{
+    const QVector<FoosDB::PairRankingEntry> pairs = db->getPairsByRanking(minMatches, start, count);
+
+    QJsonArray entries;
+    for (int i = 0; i < pairs.size(); ++i) {
+        const FoosDB::PairRankingEntry &p = pairs[i];
+        entries.append(QJsonObject{
+            { "rank", start + i + 1 },
+            { "player1", playerRef(p.player1) },
+            { "player2", playerRef(p.player2) },
+            { "elo", p.rating },
+            { "wins", p.wins },
+            { "draws", p.draws },
+            { "losses", p.losses },
+        });
+    }
+
+    return QJsonObject{
+        { "database", QString::fromStdString(db->name()) },
+        { "minMatches", minMatches },
+        { "start", start },
+        { "entries", entries },
+    };
+}
+
+QJsonObject playerSummary(FoosDB::Database *db, const FoosDB::Player *player)
+{
+    const std::shared_ptr<const PlayerPageData> data = PlayerCache::instance().pageData(db, player);
+
+    QJsonObject pvp;
+    for (FoosDB::EloDomain domain : { FoosDB::EloDomain::Single, FoosDB::EloDomain::Double, FoosDB::EloDomain::Combined }) {
+        QJsonObject domainPvp;
+        for (FoosDB::PvpRole role : { FoosDB::PvpRole::Opponent, FoosDB::PvpRole::Partner }) {
+            if (domain == FoosDB::EloDomain::Single && role == FoosDB::PvpRole::Partner)
+                continue;
+
+            QJsonArray best, worst;
+            for (const FoosDB::PlayerVsPlayerStats *stats : data->pvpStats->top(domain, role, PVP_ENTRIES))
+                best.append(results(*stats, domain, role));
+            for (const FoosDB::PlayerVsPlayerStats *stats : data->pvpStats->bottom(domain, role, PVP_ENTRIES))
+                worst.append(results(*stats, domain, role));
+
+            const QString prefix = (role == FoosDB::PvpRole::Opponent) ? "opponents" : "partners";
+            domainPvp[prefix + "Best"] = best;
+            domainPvp[prefix + "Worst"] = worst;
+        }
+        pvp[domainName(domain)] = domainPvp;
+    }
+
+    return QJsonObject{
+        { "database", QString::fromStdString(db->name()) },
+        { "player", playerRef(player) },
+        { "elo", elos(player->eloSingle, player->eloDouble, player->eloCombined) },
+        { "peak", elos(data->peakSingle, data->peakDouble, data->peakCombined) },
+        { "matchCount", elos(data->singleCount, data->doubleCount, data->singleCount + data->doubleCount) },
+        { "pvp", pvp },
+    };
+}
+
+QJsonObject progression(FoosDB::Database *db, const FoosDB::Player *player)
+{
+    const std::shared_ptr<const PlayerPageData> data = PlayerCache::instance().pageData(db, player);
+
+    QJsonArray points;
+    for (const FoosDB::Player::EloProgression &pep : data->chartProgression) {
+        points.append(QJsonArray{
+            QString::asprintf("%04d-%02d-%02d", pep.year, pep.month, pep.day),
+            pep.eloSingle, pep.eloDouble, pep.eloCombined,
+            pep.rankSingle, pep.rankDouble, pep.rankCombined
+        });
+    }
+
+    return QJsonObject{
+        { "database", QString::fromStdString(db->name()) },
+        { "player", playerRef(player) },
+        { "columns", QJsonArray{ "date", "single", "double", "combined", "rankSingle", "rankDouble", "rankCombined" } },
+        { "points", points },
+    };
+}
+
+QJsonObject matches(FoosDB::Database *db, const FoosDB::Player *player, FoosDB::EloDomain domain, int page, int matchesPerPage)
+{
+    const std::shared_ptr<const PlayerMatchPage> matches = PlayerCache::instance().matchPage(db, player, domain, page, matchesPerPage);
+    const bool isCombined = (domain == FoosDB::EloDomain::Combined);
+
+    const auto participant = [&](const FoosDB::PlayerMatch::Participant &p) -> QJsonValue {
+        if (!p.player)
+            return QJsonValue();
+        return QJsonObject{
+            { "player", playerRef(p.player) },
+            { "elo", isCombined ? p.eloCombined : p.eloSeparate },
+        };
+    };
+
+    QJsonArray entries;
+    for (const FoosDB::PlayerMatch &m : *matches) {
+        entries.append(QJsonObject{
+            { "date", m.date.date().toString(Qt::ISODate) },
+            { "competition", m.competitionName },
+            { "type", (m.matchType == FoosDB::MatchType::Single) ? "single" : "double" },
+            { "myself", participant(m.myself) },
+            { "partner", participant(m.partner) },
+            { "opponent1", participant(m.opponent1) },
+            { "opponent2", participant(m.opponent2) },
+            { "score", QJsonArray{ m.myScore, m.opponentScore } },
+            { "eloChange", isCombined ? m.eloCombinedDiff : m.eloSeparateDiff },
+        });
+    }
+
+    return QJsonObject{
+        { "database", QString::fromStdString(db->name()) },
+        { "player", playerRef(player) },
+        { "domain", domainName(domain) },
+        { "page", page },
+        { "matches", entries },
+    };
+}
+
+} // namespace JsonExport
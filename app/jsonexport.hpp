@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+#include "database.hpp"
+
+/*
+ * Wt-independent JSON representations of the ranking and player pages,
+ * shared by the JSON API resources and the static export.
+ */
+namespace JsonExport {
+
+enum class RankingOrder
+{
+    Single = (int) FoosDB::EloDomain::Single,
+    Double = (int) FoosDB::EloDomain::Double,
+    Combined = (int) FoosDB::EloDomain::Combined,
+    Games
+};
+
+bool parseDomain(const QString &str, FoosDB::EloDomain &domain);
+bool parseRankingOrder(const QString &str, RankingOrder &order);
+QString domainName(FoosDB::EloDomain domain);
+QString rankingOrderName(RankingOrder order);
+
+QJsonObject ranking(FoosDB::Database *db, RankingOrder order, int start, int count, int activeMonths = 0);
+QJsonObject pairRanking(FoosDB::Database *db, int minMatches, int start, int count);
+QJsonObject playerSummary(FoosDB::Database *db, const FoosDB::Player *player);
+QJsonObject progression(FoosDB::Database *db, const FoosDB::Player *player);
+QJsonObject matches(FoosDB::Database *db, const FoosDB::Player *player, FoosDB::EloDomain domain, int page, int matchesPerPage);
+
+} // namespace JsonExport
@@ -0,0 +1,94 @@
+#include "loaderpool.hpp"
+#include "global.hpp"
+
+#include <QDebug>
+
+LoaderPool &LoaderPool::instance()
+{
+    static LoaderPool s_pool(loaderThreadCount());
+    return s_pool;
+}
+
+LoaderPool::LoaderPool(int size)
+{
+    for (int i = 0; i < qMax(size, 1); ++i)
+        m_threads.emplace_back(&LoaderPool::run, this);
+}
+
+LoaderPool::~LoaderPool()
+{
+    shutdown();
+}
+
+void LoaderPool::shutdown()
+{
+    {
+        QMutexLocker lock(&m_mutex);
+        m_stopping = true;
+        m_available.wakeAll();
+    }
+
+    for (std::thread &thread : m_threads)
+        thread.join();
+    m_threads.clear();
+
+    QMutexLocker lock(&m_mutex);
+    if (!m_queue.isEmpty()) {
+        qWarning() << "Shutting down loader pool with" << m_queue.size() << "pending jobs";
+        m_queue.clear();
+        m_stats.queued = 0;
+    }
+}
+
+void LoaderPool::post(std::function<void()> job)
+{
+    QMutexLocker lock(&m_mutex);
+    if (m_stopping)
+        return;
+
+    m_queue.enqueue(Job{std::move(job), QElapsedTimer()});
+    m_queue.last().queueTimer.start();
+
+    m_stats.posted++;
+    m_stats.queued = m_queue.size();
+    m_stats.maxQueued = qMax(m_stats.maxQueued, m_stats.queued);
+
+    m_available.wakeOne();
+}
+
+LoaderPool::Stats LoaderPool::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+    return m_stats;
+}
+
+void LoaderPool::run()
+{
+    for (;;) {
+        Job job;
+        {
+            QMutexLocker lock(&m_mutex);
+            while (m_queue.isEmpty() && !m_stopping)
+                m_available.wait(&m_mutex);
+            if (m_stopping)
+                return;
+
+            job = m_queue.dequeue();
+
+            const quint64 usecs = job.queueTimer.nsecsElapsed() / 1000;
+            m_stats.queued = m_queue.size();
+            m_stats.totalQueueUsecs += usecs;
+            m_stats.maxQueueUsecs = qMax(m_stats.maxQueueUsecs, usecs);
+        }
+
+        QElapsedTimer runTimer;
+        runTimer.start();
+        job.fn();
+        const quint64 usecs = runTimer.nsecsElapsed() / 1000;
+
+        QMutexLocker lock(&m_mutex);
+        m_stats.completed++;
+        m_stats.totalRunUsecs += usecs;
+        m_stats.maxRunUsecs = qMax(m_stats.maxRunUsecs, usecs);
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QQueue>
+
+#include <functional>
+#include <thread>
+#include <vector>
+
+/*
+ * Process-wide pool of threads that run blocking data loads on behalf of sessions,
+ * so that slow SQLite reads do not tie up the Wt request threads.
+ *
+ * Jobs are run in FIFO order; delivering the result back to a session (via server push)
+ * is up to the job. The size is set with ELO_LOADER_THREADS.
+ *
+ * Jobs post to the WServer, so shutdown() has to be called after the server is stopped and
+ * before it is destroyed; the pool itself is a function static that outlives it.
+ */
+class LoaderPool
+{
+public:
+    static LoaderPool &instance();
+
+    ~LoaderPool();
+
+    void post(std::function<void()> job);
+
+    // waits for the running jobs, drops the queued ones and ignores later posts
+    void shutdown();
+
+    struct Stats
+    {
+        quint64 posted = 0;
+        quint64 completed = 0;
+        int queued = 0;             // currently waiting for a thread
+        int maxQueued = 0;
+        quint64 totalQueueUsecs = 0;
+        quint64 maxQueueUsecs = 0;
+        quint64 totalRunUsecs = 0;
+        quint64 maxRunUsecs = 0;
+    };
+    Stats stats() const;
+
+    int size() const { return int(m_threads.size()); }
+
+private:
+    LoaderPool(int size);
+
+    void run();
+
+    struct Job
+    {
+        std::function<void()> fn;
+        QElapsedTimer queueTimer;
+    };
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_available;
+    QQueue<Job> m_queue;
+    bool m_stopping = false;
+    Stats m_stats;
+
+    std::vector<std::thread> m_threads;
+};
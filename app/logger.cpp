@@ -0,0 +1,189 @@
+#include "logger.hpp"
+#include "metrics.hpp"
+
+#include <QDateTime>
+#include <QFileInfo>
+#include <QFile>
+
+static const char *msgTypeStr(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg: return "[DEBUG]";
+    case QtWarningMsg: return "[WARNING]";
+    case QtCriticalMsg: return "[CRITICAL]";
+    case QtFatalMsg: return "[FATAL]";
+#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
+    case QtInfoMsg: return "[INFO]";
+#endif
+    default: return "[NONE]";
+    }
+}
+
+static bool isUrgent(QtMsgType type)
+{
+    return type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg;
+}
+
+Logger::Logger(const QString &path, qint64 maxFileBytes, int keepFiles)
+    : m_path(path)
+    , m_maxFileBytes(maxFileBytes)
+    , m_keepFiles(qMax(keepFiles, 1))
+    , m_slots(CAPACITY)
+{
+    for (int i = 0; i < CAPACITY; ++i)
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+
+    m_file.setFileName(m_path);
+    m_file.open(QFile::Append);
+
+    m_thread = std::thread(&Logger::run, this);
+}
+
+Logger::~Logger()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+void Logger::log(QtMsgType type, const QString &msg)
+{
+    //
+    // Claim a slot, or drop the message if the ring is full
+    //
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &m_slots[pos & (CAPACITY - 1)];
+        const size_t seq = slot->sequence.load(std::memory_order_acquire);
+        const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+        if (diff == 0) {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0) {
+            static Metrics::Counter &s_dropped = Metrics::counter("eloapp_log_dropped_total");
+            s_dropped.add();
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->type = type;
+    slot->msecsSinceEpoch = QDateTime::currentMSecsSinceEpoch();
+    slot->msg = msg;
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    //
+    // Wake the writer early for important messages, or if the ring is filling up
+    //
+    if (type == QtFatalMsg) {
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        const quint64 request = ++m_drainRequests;
+        m_wake.notify_one();
+        m_drained.wait(lock, [&]() { return m_drainsDone >= request || m_stopping; });
+    }
+    else if (isUrgent(type) || (pos + 1) % (CAPACITY / 2) == 0) {
+        // under the mutex, so the request can't fall between the writer's check and its wait
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_flushRequested.store(true, std::memory_order_relaxed);
+        m_wake.notify_one();
+    }
+}
+
+bool Logger::tryPop(Slot &out)
+{
+    Slot &slot = m_slots[m_dequeuePos & (CAPACITY - 1)];
+    const size_t seq = slot.sequence.load(std::memory_order_acquire);
+    if (intptr_t(seq) - intptr_t(m_dequeuePos + 1) < 0)
+        return false;
+
+    out.type = slot.type;
+    out.msecsSinceEpoch = slot.msecsSinceEpoch;
+    out.msg.swap(slot.msg);
+
+    slot.sequence.store(m_dequeuePos + CAPACITY, std::memory_order_release);
+    m_dequeuePos++;
+    return true;
+}
+
+void Logger::run()
+{
+    std::unique_lock<std::mutex> lock(m_wakeMutex);
+    for (;;) {
+        m_wake.wait_for(lock, std::chrono::milliseconds(FLUSH_INTERVAL_MSECS), [&]() {
+            return m_stopping || m_drainRequests > m_drainsDone || m_flushRequested.load(std::memory_order_relaxed);
+        });
+
+        const bool stopping = m_stopping;
+        const quint64 requests = m_drainRequests;
+        m_flushRequested.store(false, std::memory_order_relaxed);
+
+        lock.unlock();
+        drain();
+        lock.lock();
+
+        m_drainsDone = requests;
+        m_drained.notify_all();
+
+        if (stopping)
+            return;
+    }
+}
+
+void Logger::drain()
+{
+    Slot entry;
+    bool wrote = false;
+    while (tryPop(entry)) {
+        write(entry.type, entry.msecsSinceEpoch, entry.msg);
+        entry.msg.clear();
+        wrote = true;
+    }
+
+    const quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+    if (dropped != m_reportedDropped) {
+        write(QtWarningMsg, QDateTime::currentMSecsSinceEpoch(),
+              QString("Log queue full, dropped %1 messages (%2 in total)").arg(dropped - m_reportedDropped).arg(dropped));
+        m_reportedDropped = dropped;
+        wrote = true;
+    }
+
+    if (wrote) {
+        m_file.flush();
+        rotateIfNeeded();
+    }
+}
+
+void Logger::write(QtMsgType type, qint64 msecsSinceEpoch, const QString &msg)
+{
+    const QDateTime dt = QDateTime::fromMSecsSinceEpoch(msecsSinceEpoch);
+    char dtStrBuf[256];
+    snprintf(dtStrBuf, sizeof(dtStrBuf), "%4d-%02d-%02d %02d:%02d:%02d:%03d",
+             dt.date().year(), dt.date().month(), dt.date().day(),
+             dt.time().hour(), dt.time().minute(), dt.time().second(), dt.time().msec());
+
+    const QString out = QString::fromUtf8(dtStrBuf) + " " + QString(msgTypeStr(type)) + " " + msg + "\n";
+    m_file.write(out.toUtf8());
+}
+
+void Logger::rotateIfNeeded()
+{
+    if (m_maxFileBytes <= 0 || m_file.size() < m_maxFileBytes)
+        return;
+
+    // elo.log -> elo.log.1 -> elo.log.2 ... up to m_keepFiles
+    m_file.close();
+    QFile::remove(m_path + "." + QString::number(m_keepFiles));
+    for (int i = m_keepFiles - 1; i >= 1; --i)
+        QFile::rename(m_path + "." + QString::number(i), m_path + "." + QString::number(i + 1));
+    QFile::rename(m_path, m_path + ".1");
+
+    m_file.open(QFile::Append);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QtGlobal>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Log file writer for the Qt message handler that keeps file I/O off the calling threads.
+ *
+ * Messages go into a fixed size lock-free multi-producer ring (Vyukov's bounded queue),
+ * and a background thread formats and writes them in batches. The file is flushed every
+ * FLUSH_INTERVAL_MSECS, or as soon as a message of at least warning severity arrives.
+ * If the ring is full, messages are dropped and counted, and the count is logged once
+ * there is room again. Files are rotated when they exceed the configured size.
+ */
+class Logger
+{
+public:
+    Logger(const QString &path, qint64 maxFileBytes, int keepFiles);
+    ~Logger();
+
+    // never waits for I/O, except for fatal messages, which are written out before returning;
+    // urgent messages briefly take the writer's wake-up mutex, which it never holds while writing
+    void log(QtMsgType type, const QString &msg);
+
+    quint64 droppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    static const int CAPACITY = 8192;   // power of two
+    static const int FLUSH_INTERVAL_MSECS = 1000;
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        QtMsgType type;
+        qint64 msecsSinceEpoch;
+        QString msg;
+    };
+
+    bool tryPop(Slot &out);
+    void run();
+    void drain();
+    void write(QtMsgType type, qint64 msecsSinceEpoch, const QString &msg);
+    void rotateIfNeeded();
+
+    const QString m_path;
+    const qint64 m_maxFileBytes;
+    const int m_keepFiles;
+
+    std::vector<Slot> m_slots;
+    alignas(64) std::atomic<size_t> m_enqueuePos{0};
+    alignas(64) size_t m_dequeuePos = 0;    // only touched by the writer thread
+    alignas(64) std::atomic<quint64> m_dropped{0};
+    quint64 m_reportedDropped = 0;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_drained;
+    std::atomic<bool> m_flushRequested{false};
+    quint64 m_drainRequests = 0;    // guarded by m_wakeMutex, as are the next two
+    quint64 m_drainsDone = 0;
+    bool m_stopping = false;
+
+    QFile m_file;
+    std::thread m_thread;
+};
@@ -1,5 +1,6 @@
 #include <Wt/WApplication.h>
 #include <Wt/WEnvironment.h>
+#include <Wt/WServer.h>
 #include <Wt/WBreak.h>
 #include <Wt/WContainerWidget.h>
 #include <Wt/WStackedWidget.h>
@@ -9,68 +10,88 @@
 #include <Wt/WWebWidget.h>
 
 #include "database.hpp"
+#include "regions.hpp"
 #include "util.hpp"
 #include "global.hpp"
 #include "app.hpp"
+#include "apiresource.hpp"
+#include "loaderpool.hpp"
+#include "logger.hpp"
 
-#include <QFile>
 #include <QDebug>
 
 using std::make_unique;
 using namespace Wt;
 
-static QFile s_logFile;
+static const int LOG_KEEP_FILES = 5;
 
-static const char *msgTypeStr(QtMsgType type)
-{
-    switch (type) {
-    case QtDebugMsg: return "[DEBUG]";
-    case QtWarningMsg: return "[WARNING]";
-    case QtCriticalMsg: return "[CRITICAL]";
-    case QtFatalMsg: return "[FATAL]";
-#if QT_VERSION > QT_VERSION_CHECK(5, 5, 0)
-    case QtInfoMsg: return "[INFO]";
-#endif
-    default: return "[NONE]";
-    }
-}
+static Logger *s_logger = nullptr;
 
 static void messageHandler(QtMsgType type, const QMessageLogContext &ctx, const QString &msg)
 {
     Q_UNUSED(ctx)
-
-    const QDateTime dt = QDateTime::currentDateTime();
-    char dtStrBuf[256];
-    snprintf(dtStrBuf, sizeof(dtStrBuf), "%4d-%02d-%02d %02d:%02d:%02d:%03d",
-             dt.date().year(), dt.date().month(), dt.date().day(),
-             dt.time().hour(), dt.time().minute(), dt.time().second(), dt.time().msec());
-
-    const QString out = QString::fromUtf8(dtStrBuf) + " " + QString(msgTypeStr(type)) + " " + msg + "\n";
-    s_logFile.write(out.toUtf8());
-    s_logFile.flush();
+    s_logger->log(type, msg);
 }
 
 int main(int argc, char **argv)
 {
     const QByteArray logPath = qgetenv(ENV_LOG_PATH);
-    s_logFile.setFileName(logPath.isEmpty() ? QString("lo.log") : QString::fromUtf8(logPath));
-    s_logFile.open(QFile::Append);
+    s_logger = new Logger(logPath.isEmpty() ? QString("lo.log") : QString::fromUtf8(logPath),
+                          qint64(logFileSizeMB()) * 1024 * 1024, LOG_KEEP_FILES);
 
     qInstallMessageHandler(messageHandler);
 
-    const QByteArray dbPathBer = qgetenv(ENV_DB_PATH_BERLIN);
-    const QByteArray dbPathGer = qgetenv(ENV_DB_PATH_GERMANY);
-    if (dbPathBer.isEmpty() || dbPathGer.isEmpty()) {
-        qCritical() << "Need to specify" << ENV_DB_PATH_BERLIN << "and" << ENV_DB_PATH_GERMANY << "environment variables";
+    if (regions().isEmpty()) {
+        qCritical() << "Need to specify regions in" << ENV_REGIONS_CONFIG << "or set"
+                    << ENV_DB_PATH_BERLIN << "and" << ENV_DB_PATH_GERMANY << "environment variables";
         qFatal("Aborting");
     }
 
-    qDebug() << "Started, opening databases" << dbPathBer << "and" << dbPathGer;
+    // databases are only loaded once a region is first accessed
+    for (const Region &region : regions()) {
+        qDebug() << "Registering region" << region.id << "with database" << region.path;
+        FoosDB::Database::create(region.id, region.path);
+    }
+
+    int ret = 0;
+    try {
+        WServer server(argc, argv, WTHTTP_CONFIGURATION);
+
+        // session-less JSON API
+        server.addResource(std::make_shared<RankingResource>(), "/api/ranking");
+        server.addResource(std::make_shared<PairRankingResource>(), "/api/pairs");
+        server.addResource(std::make_shared<PlayerResource>(), "/api/player");
+        server.addResource(std::make_shared<ProgressionResource>(), "/api/progression");
+        server.addResource(std::make_shared<MatchesResource>(), "/api/matches");
+        server.addResource(std::make_shared<MetricsResource>(), "/metrics");
+
+        server.addEntryPoint(EntryPointType::Application, [](const WEnvironment& env) {
+            return std::make_unique<EloApp>(env);
+        });
+
+        if (server.start()) {
+            WServer::waitForShutdown();
+            server.stop();
+        }
+        // jobs post to the server, so they must be done before it is destroyed
+        LoaderPool::instance().shutdown();
+
+        const LoaderPool::Stats stats = LoaderPool::instance().stats();
+        qDebug() << "Loader pool:" << stats.completed << "of" << stats.posted << "jobs completed,"
+                 << "max." << stats.maxQueued << "queued,"
+                 << "queue latency avg." << (stats.posted ? stats.totalQueueUsecs / stats.posted : 0)
+                 << "max." << stats.maxQueueUsecs << "usecs,"
+                 << "run time avg." << (stats.completed ? stats.totalRunUsecs / stats.completed : 0)
+                 << "max." << stats.maxRunUsecs << "usecs";
+    } catch (WServer::Exception &e) {
+        qCritical() << "Server error:" << e.what();
+        ret = 1;
+    }
 
-    FoosDB::Database::create("ger", std::string(dbPathGer.constData()));
-    FoosDB::Database::create("ber", std::string(dbPathBer.constData()));
+    // writes out everything still queued
+    qDebug() << "Shutting down," << s_logger->droppedCount() << "log messages dropped";
+    qInstallMessageHandler(nullptr);
+    delete s_logger;
 
-    return WRun(argc, argv, [](const WEnvironment& env) {
-      return std::make_unique<EloApp>(env);
-    });
+    return ret;
 }
@@ -0,0 +1,96 @@
+#include "mappedsnapshot.hpp"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cstring>
+
+namespace FoosDB {
+
+std::unique_ptr<MappedSnapshot> MappedSnapshot::open(const QString &path, quint64 expectedChecksum)
+{
+    std::unique_ptr<MappedSnapshot> ret(new MappedSnapshot(path));
+    if (!ret->m_file.exists())
+        return nullptr;
+
+    if (!ret->m_file.open(QFile::ReadOnly)) {
+        qWarning() << "Error opening snapshot" << path << ":" << ret->m_file.errorString();
+        return nullptr;
+    }
+
+    if (ret->m_file.size() < (qint64) sizeof(Snapshot::Header)) {
+        qWarning() << "Snapshot" << path << "is truncated";
+        return nullptr;
+    }
+
+    // the mapping lives as long as m_file
+    ret->m_data = ret->m_file.map(0, ret->m_file.size());
+    if (!ret->m_data) {
+        qWarning() << "Error mapping snapshot" << path;
+        return nullptr;
+    }
+
+    if (!ret->validate(expectedChecksum)) {
+        qWarning() << "Ignoring invalid or outdated snapshot" << path;
+        return nullptr;
+    }
+
+    return ret;
+}
+
+bool MappedSnapshot::validate(quint64 expectedChecksum) const
+{
+    const Snapshot::Header &h = header();
+    const quint64 fileSize = m_file.size();
+
+    if (memcmp(h.magic, Snapshot::MAGIC, sizeof(h.magic)) != 0 || h.version != Snapshot::VERSION
+            || h.byteOrder != Snapshot::BYTE_ORDER_MARK || h.fileSize != fileSize)
+        return false;
+
+    const quint64 recordSizes[Snapshot::SectionCount] = {
+        1,
+        sizeof(Snapshot::Player),
+        sizeof(Snapshot::ProgressionPoint),
+        sizeof(Snapshot::PlayerVsPlayer),
+        sizeof(Snapshot::Competition),
+        sizeof(Snapshot::Match),
+        sizeof(Snapshot::PlayedMatch),
+    };
+    for (int i = 0; i < Snapshot::SectionCount; ++i) {
+        const Snapshot::Section &s = h.sections[i];
+        if (s.offset % 8 != 0 || s.offset < sizeof(Snapshot::Header) || s.offset > fileSize
+                || s.count > (fileSize - s.offset) / recordSizes[i])
+            return false;
+    }
+
+    // the scraper writes the snapshot atomically and stores its checksum in the sqlite file, so
+    // a matching checksum identifies a complete snapshot of that sqlite file without reading it
+    return h.checksum == expectedChecksum;
+}
+
+const Snapshot::Player *MappedSnapshot::findPlayer(int id) const
+{
+    const Snapshot::Player *begin = section<Snapshot::Player>(Snapshot::PlayersSection);
+    const Snapshot::Player *end = begin + count(Snapshot::PlayersSection);
+    const Snapshot::Player *it = std::lower_bound(begin, end, id, [](const Snapshot::Player &p, int id) {
+        return p.id < id;
+    });
+    return (it != end && it->id == id) ? it : nullptr;
+}
+
+QString MappedSnapshot::string(const Snapshot::StringRef &ref) const
+{
+    if (!contains(Snapshot::StringsSection, ref.offset, ref.length)) {
+        damaged("string");
+        return QString();
+    }
+    return QString::fromUtf8(section<char>(Snapshot::StringsSection) + ref.offset, ref.length);
+}
+
+void MappedSnapshot::damaged(const char *what) const
+{
+    if (!m_reportedDamage.exchange(true))
+        qWarning() << "Snapshot" << m_file.fileName() << "is damaged: a" << what << "reference is out of range";
+}
+
+} // namespace FoosDB
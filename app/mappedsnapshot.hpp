@@ -0,0 +1,66 @@
+#pragma once
+
+#include "snapshot.hpp"
+
+#include <QFile>
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+namespace FoosDB {
+
+/*
+ * Read-only memory mapping of a snapshot written by the scraper (see common/snapshot.hpp).
+ * Opening only checks the header and the section table against the file size, and the header
+ * checksum against the one the scraper stored in sqlite; it doesn't touch any section, so
+ * opening is O(sections) and pages are only read when they are used. The cross references
+ * aren't checked on open either, but on use: a damaged snapshot with a valid header must not make
+ * lookups read out of bounds, so users check every index and range with at() and contains(),
+ * which are O(1), and report what doesn't fit with damaged().
+ */
+class MappedSnapshot
+{
+public:
+    // returns nullptr if the file is missing, invalid, or its checksum doesn't match expectedChecksum
+    static std::unique_ptr<MappedSnapshot> open(const QString &path, quint64 expectedChecksum);
+
+    template<typename T>
+    const T *section(Snapshot::SectionId id) const
+    {
+        return reinterpret_cast<const T*>(m_data + header().sections[id].offset);
+    }
+    quint64 count(Snapshot::SectionId id) const { return header().sections[id].count; }
+
+    // the record at index, or nullptr if it's out of range
+    template<typename T>
+    const T *at(Snapshot::SectionId id, quint64 index) const
+    {
+        return (index < count(id)) ? section<T>(id) + index : nullptr;
+    }
+    // whether the records [begin, begin + n) are within the section
+    bool contains(Snapshot::SectionId id, quint64 begin, quint64 n) const
+    {
+        return begin <= count(id) && n <= count(id) - begin;
+    }
+
+    // logs the first reference that is out of range
+    void damaged(const char *what) const;
+
+    const Snapshot::Player *findPlayer(int id) const;
+    QString string(const Snapshot::StringRef &ref) const;
+
+    qint64 size() const { return m_file.size(); }
+
+private:
+    MappedSnapshot(const QString &path) : m_file(path) {}
+
+    const Snapshot::Header &header() const { return *reinterpret_cast<const Snapshot::Header*>(m_data); }
+    bool validate(quint64 expectedChecksum) const;
+
+    QFile m_file;
+    const uchar *m_data = nullptr;
+    mutable std::atomic<bool> m_reportedDamage{false};
+};
+
+} // namespace FoosDB
@@ -0,0 +1,147 @@
+#include "metrics.hpp"
+
+#include <QMutex>
+#include <QMap>
+
+namespace Metrics {
+
+const quint64 Histogram::BUCKET_BOUNDS[BUCKET_COUNT - 1] = {
+    50, 100, 250, 500,
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000,
+};
+
+static int shardIndex()
+{
+    static std::atomic<int> s_nextShard{0};
+    thread_local const int index = s_nextShard.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+    return index;
+}
+
+void Counter::add(quint64 n)
+{
+    m_shards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+}
+
+quint64 Counter::value() const
+{
+    quint64 ret = 0;
+    for (const Shard &shard : m_shards)
+        ret += shard.value.load(std::memory_order_relaxed);
+    return ret;
+}
+
+void Histogram::observe(quint64 usecs)
+{
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && usecs > BUCKET_BOUNDS[bucket])
+        bucket++;
+
+    Shard &shard = m_shards[shardIndex()];
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    shard.sumUsecs.fetch_add(usecs, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot ret;
+    for (const Shard &shard : m_shards) {
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            const quint64 n = shard.buckets[i].load(std::memory_order_relaxed);
+            ret.buckets[i] += n;
+            ret.count += n;
+        }
+        ret.sumUsecs += shard.sumUsecs.load(std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+//
+// Registry
+//
+struct Registry
+{
+    QMutex mutex;
+    // family -> labels -> metric; never deleted, callers may keep references
+    QMap<QByteArray, QMap<QByteArray, Counter*>> counters;
+    QMap<QByteArray, QMap<QByteArray, Histogram*>> histograms;
+};
+
+static Registry &registry()
+{
+    static Registry *s_registry = new Registry;
+    return *s_registry;
+}
+
+Counter &counter(const QByteArray &family, const QByteArray &labels)
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Counter *&ret = r.counters[family][labels];
+    if (!ret)
+        ret = new Counter;
+    return *ret;
+}
+
+Histogram &histogram(const QByteArray &family, const QByteArray &labels)
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+    Histogram *&ret = r.histograms[family][labels];
+    if (!ret)
+        ret = new Histogram;
+    return *ret;
+}
+
+QByteArray labelValue(const QByteArray &value)
+{
+    QByteArray ret = value;
+    ret.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return '"' + ret + '"';
+}
+
+static QByteArray seconds(quint64 usecs)
+{
+    return QByteArray::number(double(usecs) / 1e6, 'g', 10);
+}
+
+static QByteArray withLabels(const QByteArray &name, const QByteArray &labels, const QByteArray &extra = QByteArray())
+{
+    const QByteArray all = (labels.isEmpty() || extra.isEmpty()) ? labels + extra : labels + "," + extra;
+    return all.isEmpty() ? name : name + "{" + all + "}";
+}
+
+QByteArray prometheusText()
+{
+    Registry &r = registry();
+    QMutexLocker lock(&r.mutex);
+
+    QByteArray out;
+
+    for (auto family = r.counters.cbegin(); family != r.counters.cend(); ++family) {
+        out += "# TYPE " + family.key() + " counter\n";
+        for (auto it = family.value().cbegin(); it != family.value().cend(); ++it)
+            out += withLabels(family.key(), it.key()) + " " + QByteArray::number(it.value()->value()) + "\n";
+    }
+
+    for (auto family = r.histograms.cbegin(); family != r.histograms.cend(); ++family) {
+        out += "# TYPE " + family.key() + " histogram\n";
+        for (auto it = family.value().cbegin(); it != family.value().cend(); ++it) {
+            const Histogram::Snapshot s = it.value()->snapshot();
+
+            quint64 cumulative = 0;
+            for (int i = 0; i < Histogram::BUCKET_COUNT; ++i) {
+                cumulative += s.buckets[i];
+                const QByteArray le = (i < Histogram::BUCKET_COUNT - 1) ? seconds(Histogram::BUCKET_BOUNDS[i]) : "+Inf";
+                out += withLabels(family.key() + "_bucket", it.key(), "le=\"" + le + "\"")
+                        + " " + QByteArray::number(cumulative) + "\n";
+            }
+            out += withLabels(family.key() + "_sum", it.key()) + " " + seconds(s.sumUsecs) + "\n";
+            out += withLabels(family.key() + "_count", it.key()) + " " + QByteArray::number(s.count) + "\n";
+        }
+    }
+
+    return out;
+}
+
+} // namespace Metrics
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+
+#include <atomic>
+
+/*
+ * Always-on counters and latency histograms, exported in the Prometheus text format.
+ *
+ * Recording is lock-free: every metric is split into a few cache-line sized shards, each
+ * thread sticks to one shard and bumps it with relaxed atomics. Shards are only summed up
+ * when the metrics are read. Metrics are registered once by family name and label set
+ * and live until the process exits, so references to them can be cached freely.
+ */
+namespace Metrics {
+
+static const int SHARDS = 16;
+
+class Counter
+{
+public:
+    void add(quint64 n = 1);
+    quint64 value() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<quint64> value{0};
+    };
+    Shard m_shards[SHARDS];
+};
+
+// latencies in microseconds, with fixed exponential buckets from 50 usecs to 5 secs
+class Histogram
+{
+public:
+    static const int BUCKET_COUNT = 17;
+    static const quint64 BUCKET_BOUNDS[BUCKET_COUNT - 1];   // upper bounds, the last bucket is +Inf
+
+    void observe(quint64 usecs);
+
+    struct Snapshot
+    {
+        quint64 buckets[BUCKET_COUNT] = {};     // not cumulative
+        quint64 count = 0;
+        quint64 sumUsecs = 0;
+    };
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<quint64> buckets[BUCKET_COUNT] = {};
+        std::atomic<quint64> sumUsecs{0};
+    };
+    Shard m_shards[SHARDS];
+};
+
+// return the metric for the given family and label set (e.g. 'scope="x"'), creating it if needed
+Counter &counter(const QByteArray &family, const QByteArray &labels = QByteArray());
+Histogram &histogram(const QByteArray &family, const QByteArray &labels = QByteArray());
+
+// escapes a string for use as a label value
+QByteArray labelValue(const QByteArray &value);
+
+QByteArray prometheusText();
+
+} // namespace Metrics
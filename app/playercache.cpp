@@ -0,0 +1,134 @@
+#include "playercache.hpp"
+#include "global.hpp"
+#include "util.hpp"
+
+#include <QPointF>
+
+bool PlayerCache::Key::operator==(const Key &other) const
+{
+    return player == other.player && domain == other.domain && page == other.page && pageSize == other.pageSize
+            && generation == other.generation && database == other.database;
+}
+
+uint qHash(const PlayerCache::Key &key, uint seed)
+{
+    return qHash(key.database, seed) ^ qHash(key.generation, seed)
+            ^ qHash((key.player << 8) ^ (key.page << 2) ^ key.domain, seed) ^ qHash(key.pageSize, seed + 1);
+}
+
+PlayerCache &PlayerCache::instance()
+{
+    static PlayerCache s_cache(pageCacheSizeMB() * 1024);
+    return s_cache;
+}
+
+PlayerCache::PlayerCache(int maxKBytes)
+{
+    m_cache.setMaxCost(maxKBytes);
+}
+
+PlayerCache::Stats PlayerCache::stats() const
+{
+    QMutexLocker lock(&m_mutex);
+    Stats ret;
+    ret.hits = m_hits;
+    ret.misses = m_misses;
+    ret.entries = m_cache.count();
+    ret.totalKBytes = m_cache.totalCost();
+    ret.maxKBytes = m_cache.maxCost();
+    return ret;
+}
+
+template<typename T>
+std::shared_ptr<const T> PlayerCache::lookup(const Key &key)
+{
+    QMutexLocker lock(&m_mutex);
+    Entry *entry = m_cache.object(key);
+    if (!entry) {
+        m_misses++;
+        return nullptr;
+    }
+    m_hits++;
+    return std::static_pointer_cast<const T>(entry->value);
+}
+
+template<typename T>
+void PlayerCache::insert(const Key &key, const std::shared_ptr<const T> &value, int kbytes)
+{
+    QMutexLocker lock(&m_mutex);
+    m_cache.insert(key, new Entry{value}, qMax(kbytes, 1));
+}
+
+static QVector<FoosDB::Player::EloProgression> downsampleProgression(const QVector<FoosDB::Player::EloProgression> &progression)
+{
+    QVector<QPointF> combined, dbl, single;
+    combined.reserve(progression.size());
+    dbl.reserve(progression.size());
+    single.reserve(progression.size());
+    for (const FoosDB::Player::EloProgression &pep : progression) {
+        const double day = QDate(pep.year, pep.month, pep.day).toJulianDay();
+        combined << QPointF(day, pep.eloCombined);
+        dbl << QPointF(day, pep.eloDouble);
+        single << QPointF(day, pep.eloSingle);
+    }
+
+    // a point is kept if any of the three series needs it
+    QVector<bool> keep(progression.size(), false);
+    for (const QVector<QPointF> *series : { &combined, &dbl, &single }) {
+        for (int idx : downsampleLttb(*series, CHART_WIDTH))
+            keep[idx] = true;
+    }
+
+    QVector<FoosDB::Player::EloProgression> ret;
+    ret.reserve(keep.count(true));
+    for (int i = 0; i < progression.size(); ++i) {
+        if (keep[i])
+            ret << progression[i];
+    }
+    return ret;
+}
+
+std::shared_ptr<const PlayerPageData> PlayerCache::pageData(FoosDB::Database *db, const FoosDB::Player *player)
+{
+    const Key key{QByteArray::fromStdString(db->name()), db->generation(), player->id, -1, -1, -1};
+    if (std::shared_ptr<const PlayerPageData> cached = lookup<PlayerPageData>(key))
+        return cached;
+
+    std::shared_ptr<PlayerPageData> data = std::make_shared<PlayerPageData>();
+    data->pvpStats = db->getPlayerVsPlayerStats(player);
+    data->singleCount = db->getPlayerMatchCount(player, FoosDB::EloDomain::Single);
+    data->doubleCount = db->getPlayerMatchCount(player, FoosDB::EloDomain::Double);
+
+    const QVector<FoosDB::Player::EloProgression> progression = db->getPlayerProgression(player);
+    for (const FoosDB::Player::EloProgression &pep : progression) {
+        data->peakSingle = qMax(data->peakSingle, (int) pep.eloSingle);
+        data->peakDouble = qMax(data->peakDouble, (int) pep.eloDouble);
+        data->peakCombined = qMax(data->peakCombined, (int) pep.eloCombined);
+    }
+    data->chartProgression = downsampleProgression(progression);
+
+    // PVP stats are owned by the Database and not counted here
+    const int bytes = sizeof(PlayerPageData)
+            + data->chartProgression.size() * sizeof(FoosDB::Player::EloProgression);
+    insert<PlayerPageData>(key, data, bytes / 1024);
+
+    return data;
+}
+
+std::shared_ptr<const PlayerMatchPage> PlayerCache::matchPage(FoosDB::Database *db, const FoosDB::Player *player,
+                                                              FoosDB::EloDomain domain, int page, int matchesPerPage)
+{
+    const Key key{QByteArray::fromStdString(db->name()), db->generation(), player->id, (int) domain, page, matchesPerPage};
+    if (std::shared_ptr<const PlayerMatchPage> cached = lookup<PlayerMatchPage>(key))
+        return cached;
+
+    std::shared_ptr<const PlayerMatchPage> matches = std::make_shared<PlayerMatchPage>(
+                db->getPlayerMatches(player, domain, page * matchesPerPage, matchesPerPage));
+
+    int bytes = sizeof(PlayerMatchPage);
+    for (const FoosDB::PlayerMatch &match : *matches)
+        bytes += sizeof(FoosDB::PlayerMatch) + match.competitionName.size() * sizeof(QChar);
+    insert<PlayerMatchPage>(key, matches, bytes / 1024);
+
+    return matches;
+}
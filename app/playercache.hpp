@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QCache>
+#include <QMutex>
+#include <QVector>
+
+#include <memory>
+
+#include "database.hpp"
+
+/*
+ * Everything the player page shows besides the match list. Progression is already
+ * downsampled for the chart, peaks are computed from the full progression.
+ */
+struct PlayerPageData
+{
+    // shared with the Database, which builds them on load
+    std::shared_ptr<const FoosDB::PlayerVsPlayerBlock> pvpStats;
+    QVector<FoosDB::Player::EloProgression> chartProgression;
+
+    int singleCount = 0;
+    int doubleCount = 0;
+    int peakSingle = 0;
+    int peakDouble = 0;
+    int peakCombined = 0;
+};
+
+using PlayerMatchPage = QVector<FoosDB::PlayerMatch>;
+
+/*
+ * Process-wide LRU cache for computed player page data, shared by all sessions.
+ *
+ * Entries are keyed by (database, player, domain, page, page size) and by the database generation,
+ * so everything computed from an older load of a database is never served again and
+ * simply ages out. The total size is bounded by ELO_PAGE_CACHE_MB.
+ */
+class PlayerCache
+{
+public:
+    static PlayerCache &instance();
+
+    std::shared_ptr<const PlayerPageData> pageData(FoosDB::Database *db, const FoosDB::Player *player);
+    std::shared_ptr<const PlayerMatchPage> matchPage(FoosDB::Database *db, const FoosDB::Player *player,
+                                                     FoosDB::EloDomain domain, int page, int matchesPerPage);
+
+    struct Stats
+    {
+        quint64 hits = 0;
+        quint64 misses = 0;
+        int entries = 0;
+        int totalKBytes = 0;
+        int maxKBytes = 0;
+        double hitRate() const { return (hits + misses > 0) ? double(hits) / double(hits + misses) : 0.0; }
+    };
+    Stats stats() const;
+
+    struct Key
+    {
+        QByteArray database;
+        int generation;
+        int player;
+        int domain;     // -1 for PlayerPageData
+        int page;       // -1 for PlayerPageData
+        int pageSize;   // -1 for PlayerPageData
+        bool operator==(const Key &other) const;
+    };
+
+private:
+    PlayerCache(int maxKBytes);
+
+    template<typename T>
+    std::shared_ptr<const T> lookup(const Key &key);
+    template<typename T>
+    void insert(const Key &key, const std::shared_ptr<const T> &value, int kbytes);
+
+    // entries hold a shared_ptr, so that eviction never invalidates data still used by a session
+    struct Entry
+    {
+        std::shared_ptr<const void> value;
+    };
+
+    mutable QMutex m_mutex;
+    QCache<Key, Entry> m_cache;
+    quint64 m_hits = 0;
+    quint64 m_misses = 0;
+};
+
+uint qHash(const PlayerCache::Key &key, uint seed = 0);
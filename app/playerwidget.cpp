@@ -1,15 +1,19 @@
 #include "playerwidget.hpp"
 #include "util.hpp"
 #include "global.hpp"
+#include "loaderpool.hpp"
 
+#include <Wt/WApplication.h>
+#include <Wt/WEnvironment.h>
+#include <Wt/WServer.h>
 #include <Wt/WHBoxLayout.h>
 #include <Wt/WVBoxLayout.h>
 #include <Wt/WDate.h>
 #include <Wt/WTime.h>
 #include <Wt/WDateTime.h>
 #include <Wt/WStandardItem.h>
-#include <Wt/WStackedWidget.h>
 #include <Wt/WCssDecorationStyle.h>
+#include <Wt/WPen.h>
 
 using namespace Wt;
 using std::make_unique;
@@ -37,7 +41,7 @@ static std::string diff2str(int diff)
 
 static std::string player2str(const FoosDB::Player *player)
 {
-    return player ? (player->firstName + " " + player->lastName).toStdString() : "";
+    return player ? (player->firstName() + " " + player->lastName()).toStdString() : "";
 }
 
 WLink PlayerWidget::createPlayerLink(const FoosDB::Player *p) const
@@ -69,6 +73,10 @@ PlayerWidget::PlayerWidget()
     m_title = headerGroup->addWidget(make_unique<WText>());
     m_title->setTextAlignment(AlignmentFlag::Center);
 
+    m_loadingText = addToLayout<WText>(this, tr("player_loading"));
+    m_loadingText->setTextAlignment(AlignmentFlag::Center);
+    m_loadingText->hide();
+
     //
     // Setup three ELO headers
     //
@@ -127,26 +135,21 @@ PlayerWidget::PlayerWidget()
     m_eloDoubleButton->clicked().connect([=]() { setDomain(FoosDB::EloDomain::Double); });
     m_eloSingleButton->clicked().connect([=]() { setDomain(FoosDB::EloDomain::Single); });
 
+    // object names are used to drive the widget in sessionbench
+    m_eloCombinedButton->setObjectName("player_select_combined");
+    m_eloDoubleButton->setObjectName("player_select_double");
+    m_eloSingleButton->setObjectName("player_select_single");
+
     m_eloCombinedButton->setEnabled(m_displayedDomain != FoosDB::EloDomain::Combined);
     m_eloDoubleButton->setEnabled(m_displayedDomain != FoosDB::EloDomain::Double);
     m_eloSingleButton->setEnabled(m_displayedDomain != FoosDB::EloDomain::Single);
 
     //
-    // setup ELO plot
+    // placeholder for the ELO plot, which is created by updateChart()
     //
-    m_chartStack = addToLayout<WStackedWidget>(this);
-    m_chartStack->resize(760, 400);
-    m_chartStack->setMargin(WLength::Auto, Side::Left | Side::Right);
-    const auto addChart = [&]() {
-        Chart::WCartesianChart *chart = m_chartStack->addWidget(make_unique<Chart::WCartesianChart>());
-        chart->setBackground(WColor(220, 220, 220));
-        chart->setType(Chart::ChartType::Scatter);
-        chart->resize(760, 400);
-        return chart;
-    };
-    m_eloChartCombined = addChart();
-    m_eloChartDouble = addChart();
-    m_eloChartSingle = addChart();
+    m_chartContainer = addToLayout<WContainerWidget>(this);
+    m_chartContainer->resize(CHART_WIDTH, CHART_HEIGHT);
+    m_chartContainer->setMargin(WLength::Auto, Side::Left | Side::Right);
 
     //
     // setup opponents table
@@ -207,6 +210,8 @@ PlayerWidget::PlayerWidget()
 
     m_prevButton->clicked().connect(this, &PlayerWidget::prev);
     m_nextButton->clicked().connect(this, &PlayerWidget::next);
+    m_prevButton->setObjectName("player_prev");
+    m_nextButton->setObjectName("player_next");
 
     setDatabasePrefix("ber");
 }
@@ -231,42 +236,97 @@ void PlayerWidget::setPlayerId(FoosDB::Database *db, int id)
     m_player = db->getPlayer(id);
     m_page = 0;
 
-    m_peakSingle = m_peakDouble = m_peakCombined = 0;
     const int es = m_player ? m_player->eloSingle : 0;
     const int ed = m_player ? m_player->eloDouble : 0;
     const int ec = m_player ? m_player->eloCombined : 0;
 
-    if (m_player) {
-        m_pvpStats = db->getPlayerVsPlayerStats(m_player);
-        m_singleCount = db->getPlayerMatchCount(m_player, FoosDB::EloDomain::Single);
-        m_doubleCount = db->getPlayerMatchCount(m_player, FoosDB::EloDomain::Double);
-        m_progression = db->getPlayerProgression(m_player);
-
-        for (const FoosDB::Player::EloProgression &progression : m_progression) {
-            m_peakSingle = qMax(m_peakSingle, (int) progression.eloSingle);
-            m_peakDouble = qMax(m_peakDouble, (int) progression.eloDouble);
-            m_peakCombined = qMax(m_peakCombined, (int) progression.eloCombined);
-        }
-    } else {
-        m_pvpStats.clear();
-        m_singleCount = 0;
-        m_doubleCount = 0;
-    }
-
     //
-    // Update ELO/title texts
+    // Show a skeleton with everything that is known without querying the database
     //
+    m_data = std::make_shared<PlayerPageData>();
+    m_matches = std::make_shared<PlayerMatchPage>();
+
     m_title->setText("<h1>" + player2str(m_player) + "</h1>");
     m_eloCombined->setText("<b>" + std::to_string(ec) + "</b>");
     m_eloDouble->setText("<b>" + std::to_string(ed) + "</b>");
     m_eloSingle->setText("<b>" + std::to_string(es) + "</b>");
-    m_eloCombinedPeak->setText(tr("player_peak").arg(std::to_string(m_peakCombined)));
-    m_eloDoublePeak->setText(tr("player_peak").arg(std::to_string(m_peakDouble)));
-    m_eloSinglePeak->setText(tr("player_peak").arg(std::to_string(m_peakSingle)));
+    m_eloCombinedPeak->setText("");
+    m_eloDoublePeak->setText("");
+    m_eloSinglePeak->setText("");
 
     updateChart();
     updateOpponents();
-    updateMatchTable();
+    showMatches();
+
+    // drop results of loads still pending for the previous player
+    m_matchSerial++;
+    if (!m_player) {
+        m_dataSerial++;
+        m_loadingText->hide();
+        return;
+    }
+
+    //
+    // Load page data and the first match page in the background
+    //
+    // the reference keeps the database loaded even if the session goes away meanwhile
+    const std::shared_ptr<FoosDB::Database> dbRef = db->shared_from_this();
+    const FoosDB::Player *player = m_player;
+    const FoosDB::EloDomain domain = m_displayedDomain;
+    const int page = m_page;
+    const int matchesPerPage = m_matchesPerPage;
+    const int matchSerial = m_matchSerial;
+    const auto data = std::make_shared<std::shared_ptr<const PlayerPageData>>();
+    const auto matches = std::make_shared<std::shared_ptr<const PlayerMatchPage>>();
+
+    m_loadingText->show();
+    runAsync(m_dataSerial, [=]() {
+        *data = PlayerCache::instance().pageData(dbRef.get(), player);
+        *matches = PlayerCache::instance().matchPage(dbRef.get(), player, domain, page, matchesPerPage);
+    }, [=]() {
+        m_data = *data;
+        m_loadingText->hide();
+
+        m_eloCombinedPeak->setText(tr("player_peak").arg(std::to_string(m_data->peakCombined)));
+        m_eloDoublePeak->setText(tr("player_peak").arg(std::to_string(m_data->peakDouble)));
+        m_eloSinglePeak->setText(tr("player_peak").arg(std::to_string(m_data->peakSingle)));
+
+        updateChart();
+        updateOpponents();
+
+        // unless the domain or page was changed in the meantime
+        if (matchSerial == m_matchSerial)
+            m_matches = *matches;
+        showMatches();
+    });
+}
+
+void PlayerWidget::runAsync(int &serial, std::function<void()> load, std::function<void()> apply)
+{
+    const int requestSerial = ++serial;
+
+    // without a running server, or without Ajax for server push, load in place
+    WApplication *app = WApplication::instance();
+    WServer *server = WServer::instance();
+    if (!server || !app || !app->environment().ajax() || !app->updatesEnabled()) {
+        load();
+        apply();
+        return;
+    }
+
+    const std::function<void()> deliver = [=, &serial]() {
+        if (requestSerial != serial)
+            return;
+        apply();
+        WApplication::instance()->triggerUpdate();
+    };
+
+    const std::string sessionId = app->sessionId();
+    const std::function<void()> safeDeliver = bindSafe(deliver);
+    LoaderPool::instance().post([=]() {
+        load();
+        server->post(sessionId, safeDeliver);
+    });
 }
 
 void PlayerWidget::prev()
@@ -285,7 +345,7 @@ void PlayerWidget::setDomain(FoosDB::EloDomain domain)
 {
     m_displayedDomain = domain;
 
-    selectChart();
+    selectChartSeries();
     updateOpponents();
     updateMatchTable();
 
@@ -296,47 +356,67 @@ void PlayerWidget::setDomain(FoosDB::EloDomain domain)
 
 void PlayerWidget::updateChart()
 {
-    m_eloModel = std::make_shared<Wt::WStandardItemModel>(m_progression.size(), 4);
+    const QVector<FoosDB::Player::EloProgression> &progression = m_data->chartProgression;
+
+    m_eloModel = std::make_shared<Wt::WStandardItemModel>(progression.size(), 7);
     m_eloModel->setHeaderData(0, WString("Date"));
     m_eloModel->setHeaderData(1, WString("Combined"));
     m_eloModel->setHeaderData(2, WString("Double"));
     m_eloModel->setHeaderData(3, WString("Single"));
+    m_eloModel->setHeaderData(4, WString("Combined Rank"));
+    m_eloModel->setHeaderData(5, WString("Double Rank"));
+    m_eloModel->setHeaderData(6, WString("Single Rank"));
 
-    for (int i = 0; i < m_progression.size(); ++i) {
-        const FoosDB::Player::EloProgression pep = m_progression[i];
+    for (int i = 0; i < progression.size(); ++i) {
+        const FoosDB::Player::EloProgression pep = progression[i];
         const WDate date(pep.year, pep.month, pep.day);
         m_eloModel->setData(i, 0, date);
         m_eloModel->setData(i, 1, (float) pep.eloCombined);
         m_eloModel->setData(i, 2, (float) pep.eloDouble);
         m_eloModel->setData(i, 3, (float) pep.eloSingle);
+        // unranked points are left empty, so they are not drawn
+        if (pep.rankCombined > 0)
+            m_eloModel->setData(i, 4, (float) pep.rankCombined);
+        if (pep.rankDouble > 0)
+            m_eloModel->setData(i, 5, (float) pep.rankDouble);
+        if (pep.rankSingle > 0)
+            m_eloModel->setData(i, 6, (float) pep.rankSingle);
     }
 
-    m_eloChartCombined->setModel(m_eloModel);
-    m_eloChartCombined->setXSeriesColumn(0);
-    m_eloChartCombined->axis(Chart::Axis::X).setScale(Chart::AxisScale::Date);
-    m_eloChartCombined->addSeries(make_unique<Chart::WDataSeries>(1, Chart::SeriesType::Line));
-
-    m_eloChartDouble->setModel(m_eloModel);
-    m_eloChartDouble->setXSeriesColumn(0);
-    m_eloChartDouble->axis(Chart::Axis::X).setScale(Chart::AxisScale::Date);
-    m_eloChartDouble->addSeries(make_unique<Chart::WDataSeries>(2, Chart::SeriesType::Line));
-
-    m_eloChartSingle->setModel(m_eloModel);
-    m_eloChartSingle->setXSeriesColumn(0);
-    m_eloChartSingle->axis(Chart::Axis::X).setScale(Chart::AxisScale::Date);
-    m_eloChartSingle->addSeries(make_unique<Chart::WDataSeries>(3, Chart::SeriesType::Line));
+    if (!m_eloChart) {
+        m_eloChart = m_chartContainer->addWidget(make_unique<Chart::WCartesianChart>());
+        m_eloChart->setBackground(WColor(220, 220, 220));
+        m_eloChart->setType(Chart::ChartType::Scatter);
+        m_eloChart->resize(CHART_WIDTH, CHART_HEIGHT);
+        m_eloChart->setXSeriesColumn(0);
+        m_eloChart->axis(Chart::Axis::X).setScale(Chart::AxisScale::Date);
+        // rank on the right, with the best rank at the top
+        m_eloChart->axis(Chart::Axis::Y2).setVisible(true);
+        m_eloChart->axis(Chart::Axis::Y2).setInverted(true);
+        m_eloChart->axis(Chart::Axis::Y2).setTitle(tr("player_rank"));
+    }
+    m_eloChart->setModel(m_eloModel);
 
-    selectChart();
+    selectChartSeries();
 }
 
-void PlayerWidget::selectChart()
+void PlayerWidget::selectChartSeries()
 {
-    if (m_displayedDomain == FoosDB::EloDomain::Combined)
-        m_chartStack->setCurrentWidget(m_eloChartCombined);
-    else if (m_displayedDomain == FoosDB::EloDomain::Double)
-        m_chartStack->setCurrentWidget(m_eloChartDouble);
-    else
-        m_chartStack->setCurrentWidget(m_eloChartSingle);
+    if (!m_eloChart)
+        return;
+
+    const int column = (m_displayedDomain == FoosDB::EloDomain::Combined) ? 1 :
+                       (m_displayedDomain == FoosDB::EloDomain::Double) ? 2 : 3;
+
+    std::vector<std::unique_ptr<Chart::WDataSeries>> series;
+    series.push_back(make_unique<Chart::WDataSeries>(column, Chart::SeriesType::Line));
+
+    std::unique_ptr<Chart::WDataSeries> rank = make_unique<Chart::WDataSeries>(column + 3, Chart::SeriesType::Line);
+    rank->bindToAxis(Chart::Axis::Y2);
+    rank->setPen(WPen(WColor(120, 120, 120)));
+    series.push_back(std::move(rank));
+
+    m_eloChart->setSeries(std::move(series));
 }
 
 void PlayerWidget::updateOpponents()
@@ -349,119 +429,88 @@ void PlayerWidget::updateOpponents()
     if (!m_player)
         return;
 
-    using ResultFunction = FoosDB::PlayerVsPlayerStats::Results (FoosDB::PlayerVsPlayerStats::*)() const;
-
-    const auto sortPvp = [](QVector<FoosDB::PlayerVsPlayerStats> &list, ResultFunction result) {
-        std::sort(list.begin(), list.end(), [=](const FoosDB::PlayerVsPlayerStats &a, const FoosDB::PlayerVsPlayerStats &b) {
-            return (a.*result)().delta > (b.*result)().delta;
-        });
-    };
+    static const int PVP_ENTRIES = 4;
 
     const bool isSingle = (m_displayedDomain == FoosDB::EloDomain::Single);
-    QVector<FoosDB::PlayerVsPlayerStats> opponents = m_pvpStats;
-    QVector<FoosDB::PlayerVsPlayerStats> partners = m_pvpStats;
-    ResultFunction opponentResults;
-    ResultFunction partnerResults;
-
-    if (m_displayedDomain == FoosDB::EloDomain::Single) {
-        opponentResults = &FoosDB::PlayerVsPlayerStats::singleResults;
-        partnerResults = &FoosDB::PlayerVsPlayerStats::singleResults;
-    }
-    else if (m_displayedDomain == FoosDB::EloDomain::Double) {
-        opponentResults = &FoosDB::PlayerVsPlayerStats::doubleResults;
-        partnerResults = &FoosDB::PlayerVsPlayerStats::partnerDoubleResults;
-    }
-    else {
-        opponentResults = &FoosDB::PlayerVsPlayerStats::combinedResults;
-        partnerResults = &FoosDB::PlayerVsPlayerStats::partnerCombinedResults;
-    }
-
-    sortPvp(opponents, opponentResults);
-    if (!isSingle)
-        sortPvp(partners, partnerResults);
-
     m_partnersWinGroup->setHidden(isSingle);
     m_partnersLoseGroup->setHidden(isSingle);
 
-    for (int i = 0 ; i < 4; ++i) {
-        const std::string cssClass = (i % 2 == 0) ? "player_pvp_1" : "player_pvp_2";
-
-        const auto addToRow = [&](
-                WTable *table1,
-                WTable *table2,
-                const QVector<FoosDB::PlayerVsPlayerStats> &stats,
-                int idx,
-                ResultFunction results) {
-            if (idx >= stats.size())
-                return;
-
-            const FoosDB::PlayerVsPlayerStats pvp1 = stats.value(idx);
-            const FoosDB::PlayerVsPlayerStats pvp2 = stats.value(stats.size() - idx - 1);
-
-            const FoosDB::PlayerVsPlayerStats::Results res1 = (pvp1.*results)();
-            const FoosDB::PlayerVsPlayerStats::Results res2 = (pvp2.*results)();
-
-            const auto resultStr = [&](const FoosDB::PlayerVsPlayerStats::Results &res) {
-                return "  (" + std::to_string(res.wins) + " : " + std::to_string(res.draws) + " : " + std::to_string(res.losses) + ")";
-            };
-
-            if (res1.delta > 0) {
-                table1->insertRow(table1->rowCount())->setHeight("1.4em");;
-                const int n1 = table1->rowCount() - 1;
-                WContainerWidget *container = table1->elementAt(n1, 0)->addWidget(make_unique<WContainerWidget>());
-                container->setStyleClass(cssClass);
-                container->setLayout(make_unique<WVBoxLayout>());
-                container->setContentAlignment(AlignmentFlag::Center);
-                WContainerWidget *result = addToLayout<WContainerWidget>(container);
-                result->addWidget(make_unique<WText>(diff2str(res1.delta)))->setStyleClass("player_elo_plus");
-                result->addWidget(make_unique<WText>(resultStr(res1)))->setStyleClass("player_pvp_stats");
-                addToLayout<WAnchor>(container, createPlayerLink(pvp1.player), player2str(pvp1.player));
-            }
-
-            if (res2.delta < 0) {
-                table2->insertRow(table2->rowCount())->setHeight("1.4em");;
-                const int n2 = table2->rowCount() - 1;
-                WContainerWidget *container = table2->elementAt(n2, 1)->addWidget(make_unique<WContainerWidget>());
-                container->setStyleClass(cssClass);
-                container->setLayout(make_unique<WVBoxLayout>());
-                container->setContentAlignment(AlignmentFlag::Center);
-                WContainerWidget *result = addToLayout<WContainerWidget>(container);
-                result->addWidget(make_unique<WText>(diff2str(res2.delta)))->setStyleClass("player_elo_minus");
-                result->addWidget(make_unique<WText>(resultStr(res2)))->setStyleClass("player_pvp_stats");
-                addToLayout<WAnchor>(container, createPlayerLink(pvp2.player), player2str(pvp2.player));
-            }
-        };
+    const auto resultStr = [&](const FoosDB::PlayerVsPlayerStats::Results &res) {
+        return "  (" + std::to_string(res.wins) + " : " + std::to_string(res.draws) + " : " + std::to_string(res.losses) + ")";
+    };
 
-        addToRow(m_opponentsWin, m_opponentsLose, opponents, i, opponentResults);
+    const auto fillTable = [&](WTable *table, int column, FoosDB::PvpRole role, bool best) {
+        const QVector<const FoosDB::PlayerVsPlayerStats*> entries =
+                best ? m_data->pvpStats->top(m_displayedDomain, role, PVP_ENTRIES)
+                     : m_data->pvpStats->bottom(m_displayedDomain, role, PVP_ENTRIES);
 
-        if (!isSingle)
-            addToRow(m_partnersWin, m_partnersLose, partners, i, partnerResults);
+        for (int i = 0; i < entries.size(); ++i) {
+            const FoosDB::PlayerVsPlayerStats::Results res = FoosDB::PlayerVsPlayerBlock::results(*entries[i], m_displayedDomain, role);
+            const std::string cssClass = (i % 2 == 0) ? "player_pvp_1" : "player_pvp_2";
+
+            table->insertRow(table->rowCount())->setHeight("1.4em");
+            WContainerWidget *container = table->elementAt(table->rowCount() - 1, column)->addWidget(make_unique<WContainerWidget>());
+            container->setStyleClass(cssClass);
+            container->setLayout(make_unique<WVBoxLayout>());
+            container->setContentAlignment(AlignmentFlag::Center);
+            WContainerWidget *result = addToLayout<WContainerWidget>(container);
+            result->addWidget(make_unique<WText>(diff2str(res.delta)))->setStyleClass(best ? "player_elo_plus" : "player_elo_minus");
+            result->addWidget(make_unique<WText>(resultStr(res)))->setStyleClass("player_pvp_stats");
+            addToLayout<WAnchor>(container, createPlayerLink(entries[i]->player), player2str(entries[i]->player));
+        }
+    };
+
+    fillTable(m_opponentsWin, 0, FoosDB::PvpRole::Opponent, true);
+    fillTable(m_opponentsLose, 1, FoosDB::PvpRole::Opponent, false);
+
+    if (!isSingle) {
+        fillTable(m_partnersWin, 0, FoosDB::PvpRole::Partner, true);
+        fillTable(m_partnersLose, 1, FoosDB::PvpRole::Partner, false);
     }
 }
 
 void PlayerWidget::updateMatchTable()
 {
-    CheapProfiler prof("PlayerWidget::UpdateMatchTable()");
-
     if (!m_player) {
-        while (m_matchesTable->rowCount() > 0)
-            m_matchesTable->removeRow(m_matchesTable->rowCount() - 1);
-        m_rows.clear();
+        m_matchSerial++;
+        m_matches = std::make_shared<PlayerMatchPage>();
+        showMatches();
         return;
     }
 
-    const bool isCombined = (m_displayedDomain == FoosDB::EloDomain::Combined);
     const int totalMatchCount =
-            (m_displayedDomain == FoosDB::EloDomain::Single) ? m_singleCount :
-            (m_displayedDomain == FoosDB::EloDomain::Double) ? m_doubleCount :
-                                                               (m_singleCount + m_doubleCount);
-
+            (m_displayedDomain == FoosDB::EloDomain::Single) ? m_data->singleCount :
+            (m_displayedDomain == FoosDB::EloDomain::Double) ? m_data->doubleCount :
+                                                               (m_data->singleCount + m_data->doubleCount);
     m_page = qMin(m_page, totalMatchCount / m_matchesPerPage);
-    const int start = m_page * m_matchesPerPage;
-    int count = qMin(totalMatchCount - start, m_matchesPerPage);
 
-    const QVector<FoosDB::PlayerMatch> matches = m_db->getPlayerMatches(m_player, m_displayedDomain, start, count);
-    count = qMin(count, matches.size());
+    const std::shared_ptr<FoosDB::Database> dbRef = m_db->shared_from_this();
+    const FoosDB::Player *player = m_player;
+    const FoosDB::EloDomain domain = m_displayedDomain;
+    const int page = m_page;
+    const int matchesPerPage = m_matchesPerPage;
+    const auto matches = std::make_shared<std::shared_ptr<const PlayerMatchPage>>();
+
+    runAsync(m_matchSerial, [=]() {
+        *matches = PlayerCache::instance().matchPage(dbRef.get(), player, domain, page, matchesPerPage);
+    }, [=]() {
+        m_matches = *matches;
+        showMatches();
+    });
+}
+
+void PlayerWidget::showMatches()
+{
+    CheapProfiler prof("PlayerWidget::ShowMatches()");
+
+    const bool isCombined = (m_displayedDomain == FoosDB::EloDomain::Combined);
+    const int totalMatchCount =
+            (m_displayedDomain == FoosDB::EloDomain::Single) ? m_data->singleCount :
+            (m_displayedDomain == FoosDB::EloDomain::Double) ? m_data->doubleCount :
+                                                               (m_data->singleCount + m_data->doubleCount);
+
+    const PlayerMatchPage &matches = *m_matches;
+    const int count = qMin(matches.size(), m_matchesPerPage);
 
     while (m_matchesTable->rowCount() < count) {
         const int n = m_matchesTable->rowCount();
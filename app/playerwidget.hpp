@@ -8,9 +8,13 @@
 #include <Wt/Chart/WCartesianChart.h>
 
 #include "database.hpp"
+#include "global.hpp"
+#include "playercache.hpp"
 
 #include <QVector>
 
+#include <functional>
+
 class PlayerWidget : public Wt::WContainerWidget
 {
 public:
@@ -22,9 +26,14 @@ public:
 
 private:
     void updateChart();
-    void selectChart();
+    void selectChartSeries();
     void updateOpponents();
     void updateMatchTable();
+    void showMatches();
+
+    // runs load() on the LoaderPool and then apply() in this session, delivered by server push.
+    // Bumps serial; if it was bumped again by the time the result arrives, the result is dropped.
+    void runAsync(int &serial, std::function<void()> load, std::function<void()> apply);
 
     Wt::WLink createPlayerLink(const FoosDB::Player *p) const;
 
@@ -39,18 +48,15 @@ private:
     QString m_databasePrefix;
     const FoosDB::Player *m_player = nullptr;
 
-    QVector<FoosDB::PlayerVsPlayerStats> m_pvpStats;
-    QVector<FoosDB::Player::EloProgression> m_progression;
-
-    int m_singleCount = 0;
-    int m_doubleCount = 0;
-    int m_peakSingle = 0;
-    int m_peakDouble = 0;
-    int m_peakCombined = 0;
+    std::shared_ptr<const PlayerPageData> m_data = std::make_shared<PlayerPageData>();
+    std::shared_ptr<const PlayerMatchPage> m_matches = std::make_shared<PlayerMatchPage>();
+    int m_dataSerial = 0;
+    int m_matchSerial = 0;
 
     Wt::WVBoxLayout *m_layout;
     Wt::WText *m_title;
     Wt::WPushButton *m_backButton;
+    Wt::WText *m_loadingText;
 
     Wt::WText *m_eloCombined;
     Wt::WText *m_eloCombinedPeak;
@@ -76,7 +82,7 @@ private:
     Wt::WPushButton *m_nextButton;
 
     int m_page = 0;
-    int m_matchesPerPage = 20;
+    int m_matchesPerPage = MATCHES_PER_PAGE;
     FoosDB::EloDomain m_displayedDomain = FoosDB::EloDomain::Combined;
 
     struct Row {
@@ -100,9 +106,8 @@ private:
     };
     QVector<Row> m_rows;
 
+    // one chart for all domains, created on first use; its series is switched with the domain
     std::shared_ptr<Wt::WStandardItemModel> m_eloModel;
-    Wt::WStackedWidget *m_chartStack;
-    Wt::Chart::WCartesianChart *m_eloChartCombined;
-    Wt::Chart::WCartesianChart *m_eloChartSingle;
-    Wt::Chart::WCartesianChart *m_eloChartDouble;
+    Wt::WContainerWidget *m_chartContainer;
+    Wt::Chart::WCartesianChart *m_eloChart = nullptr;
 };
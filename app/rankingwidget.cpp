@@ -1,4 +1,5 @@
 #include "rankingwidget.hpp"
+#include "regions.hpp"
 #include "util.hpp"
 #include "global.hpp"
 
@@ -17,6 +18,12 @@ static inline T *addToLayout(WLayout *layout, Args&&... args)
     return ret;
 }
 
+static WString regionTitle(const FoosDB::Database *db)
+{
+    const Region *region = findRegion(db->name());
+    return region ? WString::fromUTF8(region->title.toStdString()) : WString::tr(db->name());
+}
+
 RankingWidget::RankingWidget(FoosDB::Database *db)
     : m_db(db)
 {
@@ -31,7 +38,7 @@ RankingWidget::RankingWidget(FoosDB::Database *db)
     // Add title
     //
     m_titleText = addToLayout<WText>(m_layout);
-    m_titleText->setText(tr("ranking_title").arg(tr(db->name())));
+    m_titleText->setText(tr("ranking_title").arg(regionTitle(db)));
     m_titleText->setTextAlignment(AlignmentFlag::Center);
 
     //
@@ -46,8 +53,33 @@ RankingWidget::RankingWidget(FoosDB::Database *db)
 
     m_searchBar = addToLayout<WLineEdit>(search->layout());
     m_searchBar->addStyleClass("player_search_box");
+    m_searchBar->setObjectName("ranking_search");
     m_searchBar->textInput().connect(this, &RankingWidget::updateSearch);
 
+    //
+    // Add date picker for past rankings
+    //
+    WContainerWidget *dateRow = addToLayout<WContainerWidget>(m_layout);
+    dateRow->addStyleClass("player_search");
+    dateRow->setLayout(make_unique<WHBoxLayout>());
+
+    WText *dateText = addToLayout<WText>(dateRow->layout(), tr("ranking_as_of"));
+    dateText->addStyleClass("player_search_text");
+
+    m_dateEdit = addToLayout<WDateEdit>(dateRow->layout());
+    m_dateEdit->addStyleClass("ranking_date_box");
+    m_dateEdit->setObjectName("ranking_date");
+    m_dateEdit->setTop(WDate::currentServerDate());
+    m_dateEdit->changed().connect(this, &RankingWidget::updateDate);
+
+    m_activityBox = addToLayout<WComboBox>(dateRow->layout());
+    m_activityBox->addStyleClass("ranking_activity_box");
+    m_activityBox->setObjectName("ranking_activity");
+    m_activityBox->addItem(tr("ranking_active_all"));
+    for (int months : FoosDB::Database::ACTIVITY_WINDOWS)
+        m_activityBox->addItem(tr("ranking_active_months").arg(months));
+    m_activityBox->changed().connect(this, &RankingWidget::updateActivity);
+
     //
     // Add rankings table
     //
@@ -75,6 +107,12 @@ RankingWidget::RankingWidget(FoosDB::Database *db)
     m_doubleButton->clicked().connect([=]() { m_sortPolicy = Double; update(); });
     m_gamesButton->clicked().connect([=]() { m_sortPolicy = Games; update(); });
 
+    // object names are used to drive the widget in sessionbench
+    m_comboButton->setObjectName("ranking_sort_combined");
+    m_singleButton->setObjectName("ranking_sort_single");
+    m_doubleButton->setObjectName("ranking_sort_double");
+    m_gamesButton->setObjectName("ranking_sort_games");
+
     //
     // Add next/prev buttons
     //
@@ -95,6 +133,8 @@ RankingWidget::RankingWidget(FoosDB::Database *db)
 
     m_prevButton->clicked().connect(this, &RankingWidget::prev);
     m_nextButton->clicked().connect(this, &RankingWidget::next);
+    m_prevButton->setObjectName("ranking_prev");
+    m_nextButton->setObjectName("ranking_next");
 
     update();
 }
@@ -106,7 +146,8 @@ RankingWidget::~RankingWidget()
 void RankingWidget::setDatabase(FoosDB::Database *db)
 {
     m_db = db;
-    m_titleText->setText(tr("ranking_title").arg(tr(db->name())));
+    m_titleText->setText(tr("ranking_title").arg(regionTitle(db)));
+    loadHistory();
     update();
 }
 
@@ -127,6 +168,33 @@ void RankingWidget::updateSearch()
     update();
 }
 
+void RankingWidget::updateDate()
+{
+    const WDate date = m_dateEdit->date();
+    // today's ranking is the current one
+    m_asOfDate = (date.isValid() && date < WDate::currentServerDate()) ? QDate(date.year(), date.month(), date.day()) : QDate();
+    m_page = 0;
+    loadHistory();
+
+    // past rankings only know who was rated back then, not who was active
+    m_activityBox->setEnabled(!m_asOfDate.isValid());
+    update();
+}
+
+void RankingWidget::updateActivity()
+{
+    const int index = m_activityBox->currentIndex();
+    m_activeMonths = (index > 0) ? FoosDB::Database::ACTIVITY_WINDOWS[index - 1] : 0;
+    m_page = 0;
+    update();
+}
+
+void RankingWidget::loadHistory()
+{
+    m_history = m_asOfDate.isValid() ? m_db->getPlayersByRanking(FoosDB::EloDomain::Combined, m_asOfDate)
+                                     : QVector<FoosDB::RankingEntry>();
+}
+
 WLink RankingWidget::createPlayerLink(int id) const
 {
     LinkType linkType = useInternalPaths() ? LinkType::InternalPath : LinkType::Url;
@@ -137,38 +205,66 @@ void RankingWidget::update()
 {
     CheapProfiler prof("Updating RankingWidget");
 
-    const FoosDB::EloDomain domain = (m_sortPolicy == Games) ? FoosDB::EloDomain::Combined
-                                                             : (FoosDB::EloDomain) m_sortPolicy;
-    QVector<const FoosDB::Player*> players = m_db->getPlayersByRanking(domain);
-
-    if (m_sortPolicy == Games) {
-        std::sort(players.begin(), players.end(), [](const FoosDB::Player *p1, const FoosDB::Player *p2) {
-            return (p1->matchCount == p2->matchCount) ? (p1->eloCombined > p2->eloCombined)
-                                                      : (p1->matchCount > p2->matchCount);
+    // board holds the ranks from boardOffset on, out of boardSize in total
+    QVector<FoosDB::RankingEntry> entries;
+    int boardOffset = 0;
+    int boardSize = -1;
+    if (m_asOfDate.isValid()) {
+        entries = m_history;
+        std::stable_sort(entries.begin(), entries.end(), [=](const FoosDB::RankingEntry &e1, const FoosDB::RankingEntry &e2) {
+            switch (m_sortPolicy) {
+            case Single: return e1.eloSingle > e2.eloSingle;
+            case Double: return e1.eloDouble > e2.eloDouble;
+            case Combined: return e1.eloCombined > e2.eloCombined;
+            case Games: return (e1.matchCount == e2.matchCount) ? (e1.eloCombined > e2.eloCombined)
+                                                                : (e1.matchCount > e2.matchCount);
+            }
+            return false;
         });
     }
+    else {
+        // rankings are precomputed, so without a search only the current page is needed
+        int start = 0;
+        int count = -1;
+        if (m_searchBar->text().empty()) {
+            const FoosDB::EloDomain domain = (m_sortPolicy == Games) ? FoosDB::EloDomain::Combined : (FoosDB::EloDomain) m_sortPolicy;
+            boardSize = m_db->getRankedPlayerCount(domain, m_activeMonths);
+            while (m_page > 0 && m_page * m_entriesPerPage >= boardSize)
+                --m_page;
+            start = boardOffset = m_page * m_entriesPerPage;
+            count = m_entriesPerPage;
+        }
+
+        const QVector<const FoosDB::Player*> players = (m_sortPolicy == Games)
+                ? m_db->getPlayersByMatchCount(start, count, m_activeMonths)
+                : m_db->getPlayersByRanking((FoosDB::EloDomain) m_sortPolicy, start, count, m_activeMonths);
+        entries.reserve(players.size());
+        for (const FoosDB::Player *p : players)
+            entries << FoosDB::RankingEntry{p, p->eloSingle, p->eloDouble, p->eloCombined, p->matchCount};
+    }
 
-    QVector<QPair<const FoosDB::Player*, int>> board;
-    for (int i = 0; i < players.size(); ++i)
-        board << qMakePair(players[i], i);
+    QVector<QPair<FoosDB::RankingEntry, int>> board;
+    for (int i = 0; i < entries.size(); ++i)
+        board << qMakePair(entries[i], boardOffset + i);
 
     // if we are searching for a player, remove all players that don't match
     if (!m_searchBar->text().empty()) {
-        const QString pattern = QString::fromUtf8(m_searchBar->text().toUTF8().data()).trimmed();
+        const QVector<uint> pattern = FoosDB::Player::namePattern(QString::fromUtf8(m_searchBar->text().toUTF8().data()).trimmed());
         for (auto it = board.begin(); it != board.end(); /*empty*/) {
-            if (!it->first->firstName.contains(pattern, Qt::CaseInsensitive)
-                    && !it->first->lastName.contains(pattern, Qt::CaseInsensitive))
+            if (!it->first.player->nameContains(pattern))
                 it = board.erase(it);
             else
                 ++it;
         }
     }
 
-    while (m_page > 0 && m_page * m_entriesPerPage >= board.size())
+    if (boardSize < 0)
+        boardSize = board.size();
+    while (m_page > 0 && m_page * m_entriesPerPage >= boardSize)
         --m_page;
 
-    const int start = m_page * m_entriesPerPage;
-    const int count = qMin(m_entriesPerPage, board.size() - start);
+    const int start = m_page * m_entriesPerPage - boardOffset;
+    const int count = qMax(qMin(m_entriesPerPage, board.size() - start), 0);
 
     while (m_table->rowCount() - 1 < count) {
         const int n = m_table->rowCount();
@@ -200,16 +296,17 @@ void RankingWidget::update()
     }
 
     for (int i = 0; i < count; ++i) {
-        const FoosDB::Player *p = board[start + i].first;
-        const std::string name = (p->firstName + " " + p->lastName).toStdString();
+        const FoosDB::RankingEntry &e = board[start + i].first;
+        const FoosDB::Player *p = e.player;
+        const std::string name = (p->firstName() + " " + p->lastName()).toStdString();
 
         m_rows[i].rank->setText(std::to_string(board[start + i].second + 1));
         m_rows[i].player->setLink(createPlayerLink(p->id));
         m_rows[i].player->setText(name);
-        m_rows[i].eloCombined->setText(std::to_string((int) p->eloCombined));
-        m_rows[i].eloSingle->setText(std::to_string((int) p->eloSingle));
-        m_rows[i].eloDouble->setText(std::to_string((int) p->eloDouble));
-        m_rows[i].matchCount->setText(std::to_string(p->matchCount));
+        m_rows[i].eloCombined->setText(std::to_string((int) e.eloCombined));
+        m_rows[i].eloSingle->setText(std::to_string((int) e.eloSingle));
+        m_rows[i].eloDouble->setText(std::to_string((int) e.eloDouble));
+        m_rows[i].matchCount->setText(std::to_string(e.matchCount));
     }
 
     m_comboButton->decorationStyle().font().setWeight((m_sortPolicy == Combined) ? FontWeight::Bold : FontWeight::Normal);
@@ -218,5 +315,5 @@ void RankingWidget::update()
     m_gamesButton->decorationStyle().font().setWeight((m_sortPolicy == Games) ? FontWeight::Bold : FontWeight::Normal);
 
     m_prevButton->setEnabled(m_page > 0);
-    m_nextButton->setEnabled(m_page * m_entriesPerPage < board.size());
+    m_nextButton->setEnabled((m_page + 1) * m_entriesPerPage < boardSize);
 }
@@ -5,6 +5,8 @@
 #include <Wt/WAnchor.h>
 #include <Wt/WPushButton.h>
 #include <Wt/WLineEdit.h>
+#include <Wt/WDateEdit.h>
+#include <Wt/WComboBox.h>
 #include <Wt/WContainerWidget.h>
 #include <Wt/WVBoxLayout.h>
 
@@ -25,6 +27,9 @@ private:
     void next();
     void update();
     void updateSearch();
+    void updateDate();
+    void updateActivity();
+    void loadHistory();
 
     Wt::WLink createPlayerLink(int id) const;
 
@@ -42,6 +47,8 @@ private:
     Wt::WVBoxLayout *m_layout;
     Wt::WText *m_titleText;
     Wt::WLineEdit *m_searchBar;
+    Wt::WDateEdit *m_dateEdit;
+    Wt::WComboBox *m_activityBox;
     Wt::WTable *m_table;
     Wt::WPushButton *m_comboButton;
     Wt::WPushButton *m_doubleButton;
@@ -50,6 +57,13 @@ private:
     Wt::WPushButton *m_prevButton;
     Wt::WPushButton *m_nextButton;
 
+    // ranking as of m_asOfDate, if one is selected; sorted on every update
+    QDate m_asOfDate;
+    QVector<FoosDB::RankingEntry> m_history;
+
+    // only players active within this many months, 0 for everyone; current ranking only
+    int m_activeMonths = 0;
+
     int m_page = 0;
     int m_entriesPerPage = 20;
 
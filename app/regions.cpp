@@ -0,0 +1,67 @@
+#include "regions.hpp"
+#include "global.hpp"
+
+#include <QSettings>
+#include <QFileInfo>
+#include <QDebug>
+
+static QVector<Region> readRegions()
+{
+    QVector<Region> ret;
+
+    const QByteArray configPath = qgetenv(ENV_REGIONS_CONFIG);
+    if (configPath.isEmpty()) {
+        const QByteArray dbPathGer = qgetenv(ENV_DB_PATH_GERMANY);
+        const QByteArray dbPathBer = qgetenv(ENV_DB_PATH_BERLIN);
+        if (!dbPathGer.isEmpty())
+            ret << Region{ "ger", dbPathGer.toStdString(), "Deutschland", "DTFB" };
+        if (!dbPathBer.isEmpty())
+            ret << Region{ "ber", dbPathBer.toStdString(), "Berlin", "TFVB" };
+        return ret;
+    }
+
+    const QString path = QString::fromLocal8Bit(configPath);
+    if (!QFileInfo::exists(path)) {
+        qCritical() << "Regions config" << path << "does not exist";
+        return ret;
+    }
+
+    QSettings settings(path, QSettings::IniFormat);
+    settings.setIniCodec("UTF-8");
+
+    for (const QString &id : settings.value("regions").toStringList()) {
+        const QString key = id.trimmed();
+        if (key.isEmpty() || key.contains('/')) {
+            qCritical() << "Invalid region id" << key << "in" << path;
+            continue;
+        }
+
+        settings.beginGroup(key);
+        Region region{ key.toStdString(), settings.value("path").toString().toStdString(),
+                       settings.value("menu", key).toString(), settings.value("title", key).toString() };
+        settings.endGroup();
+
+        if (region.path.empty()) {
+            qCritical() << "No path for region" << key << "in" << path;
+            continue;
+        }
+        ret << region;
+    }
+
+    return ret;
+}
+
+const QVector<Region> &regions()
+{
+    static const QVector<Region> s_regions = readRegions();
+    return s_regions;
+}
+
+const Region *findRegion(const std::string &id)
+{
+    for (const Region &region : regions()) {
+        if (region.id == id)
+            return &region;
+    }
+    return nullptr;
+}
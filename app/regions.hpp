@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include <string>
+
+/*
+ * The regions (one database each) served by the app.
+ *
+ * Read from the INI file named by ELO_REGIONS_CONFIG:
+ *
+ *   [General]
+ *   regions=ger, ber
+ *
+ *   [ger]
+ *   path=/var/elo/ger.sqlite
+ *   menu=Deutschland
+ *   title=DTFB
+ *
+ * The first region is the default one. Without a config file, falls back to the two regions
+ * given by ELO_DB_PATH_GERMANY and ELO_DB_PATH_BERLIN.
+ */
+struct Region
+{
+    std::string id;         // also the URL prefix and the database name
+    std::string path;
+    QString menuLabel;
+    QString title;
+};
+
+const QVector<Region> &regions();
+const Region *findRegion(const std::string &id);
@@ -0,0 +1,265 @@
+#include <Wt/Test/WTestEnvironment.h>
+#include <Wt/WLineEdit.h>
+#include <Wt/WPushButton.h>
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QDebug>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <unistd.h>
+
+#include "database.hpp"
+#include "global.hpp"
+#include "app.hpp"
+#include "regions.hpp"
+
+using namespace Wt;
+
+/*
+ * Load test for eloapp sessions: creates many EloApp instances through WTestEnvironment,
+ * drives each one through a scripted visit, keeps them all alive, and reports latency
+ * percentiles per operation, throughput and RSS growth per session.
+ */
+
+static const char * const OPERATIONS[] = {
+    "create", "ranking_page", "ranking_sort", "search", "player", "player_domain", "player_page", "back",
+};
+static const int OPERATION_COUNT = sizeof(OPERATIONS) / sizeof(OPERATIONS[0]);
+
+static qint64 residentKBytes()
+{
+    QFile statm("/proc/self/statm");
+    if (!statm.open(QFile::ReadOnly))
+        return 0;
+    const QList<QByteArray> fields = statm.readAll().split(' ');
+    return (fields.size() > 1) ? fields[1].toLongLong() * sysconf(_SC_PAGESIZE) / 1024 : 0;
+}
+
+struct Session
+{
+    // declared in this order, so that the app is destroyed before its environment
+    std::unique_ptr<Test::WTestEnvironment> env;
+    std::unique_ptr<EloApp> app;
+};
+
+class Worker
+{
+public:
+    Worker(FoosDB::Database *db, int sessions, bool rankingOnly, unsigned seed)
+        : m_db(db)
+        , m_sessionCount(sessions)
+        , m_rankingOnly(rankingOnly)
+        , m_random(seed)
+    {
+    }
+
+    void run()
+    {
+        const QVector<const FoosDB::Player*> players = m_db->getPlayersByRanking(FoosDB::EloDomain::Combined);
+        if (players.isEmpty())
+            return;
+        std::uniform_int_distribution<int> pick(0, players.size() - 1);
+
+        for (int i = 0; i < m_sessionCount; ++i) {
+            Session session;
+
+            time(0, [&]() {
+                session.env.reset(new Test::WTestEnvironment());
+                session.env->setCookies({ { "dismissed_info", "1" } });
+                session.app.reset(new EloApp(*session.env));
+            });
+            EloApp *app = session.app.get();
+            const std::string prefix = "/" + m_db->name();
+
+            time(1, [&]() { click(app, "ranking_next"); click(app, "ranking_next"); });
+            time(2, [&]() { click(app, "ranking_sort_games"); click(app, "ranking_sort_combined"); });
+
+            const FoosDB::Player *player = players[pick(m_random)];
+            time(3, [&]() {
+                WLineEdit *search = dynamic_cast<WLineEdit*>(app->root()->find("ranking_search"));
+                if (search) {
+                    search->setText(player->lastName().left(3).toStdString());
+                    search->textInput().emit();
+                    search->setText("");
+                    search->textInput().emit();
+                }
+            });
+
+            // most visitors never open a player page
+            if (!m_rankingOnly) {
+                time(4, [&]() { app->setInternalPath(prefix + "/player/" + std::to_string(player->id), true); });
+                time(5, [&]() { click(app, "player_select_double"); click(app, "player_select_single"); });
+                time(6, [&]() { click(app, "player_next"); click(app, "player_prev"); });
+                time(7, [&]() { app->setInternalPath(prefix + "/", true); });
+            }
+
+            m_sessions.push_back(std::move(session));
+        }
+    }
+
+    // must be called on the thread that ran run(); tears down in reverse order of creation
+    void release()
+    {
+        while (!m_sessions.empty())
+            m_sessions.pop_back();
+    }
+
+    const QVector<qint64> &latencies(int op) const { return m_latencies[op]; }
+
+private:
+    template<typename F>
+    void time(int op, F &&fn)
+    {
+        QElapsedTimer timer;
+        timer.start();
+        fn();
+        m_latencies[op] << timer.nsecsElapsed() / 1000;
+    }
+
+    static void click(EloApp *app, const std::string &objectName)
+    {
+        WPushButton *button = dynamic_cast<WPushButton*>(app->root()->find(objectName));
+        if (button && button->isEnabled())
+            button->clicked().emit(WMouseEvent());
+    }
+
+    FoosDB::Database *m_db;
+    const int m_sessionCount;
+    const bool m_rankingOnly;
+    std::mt19937 m_random;
+
+    std::vector<Session> m_sessions;
+    QVector<qint64> m_latencies[OPERATION_COUNT];
+};
+
+static qint64 percentile(const QVector<qint64> &sorted, double p)
+{
+    if (sorted.isEmpty())
+        return 0;
+    const int index = qBound(0, int(p * (sorted.size() - 1) + 0.5), sorted.size() - 1);
+    return sorted[index];
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication qapp(argc, argv);
+    QCoreApplication::setApplicationName("sessionbench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Creates and drives many EloApp sessions against a fixture database");
+    parser.addHelpOption();
+    parser.addPositionalArgument("sqlite", "Path to the fixture database");
+    QCommandLineOption sessionsOption(QStringList{"sessions", "n"}, "Number of sessions to create (default: 1000)", "count", "1000");
+    parser.addOption(sessionsOption);
+    QCommandLineOption threadsOption(QStringList{"threads", "j"}, "Number of threads creating sessions concurrently (default: 1)", "count", "1");
+    parser.addOption(threadsOption);
+    QCommandLineOption seedOption(QStringList{"seed"}, "Random seed for the scripted visits", "seed", "1");
+    parser.addOption(seedOption);
+    QCommandLineOption rankingOnlyOption(QStringList{"ranking-only"}, "Sessions only visit the ranking, never a player page");
+    parser.addOption(rankingOnlyOption);
+
+    parser.process(qapp);
+    if (parser.positionalArguments().size() != 1)
+        parser.showHelp(1);
+
+    const int sessionCount = qMax(parser.value(sessionsOption).toInt(), 1);
+    const int threadCount = qMax(parser.value(threadsOption).toInt(), 1);
+    const unsigned seed = parser.value(seedOption).toUInt();
+    const bool rankingOnly = parser.isSet(rankingOnlyOption);
+
+    // the app navigates via internal paths; serve the fixture as the two default regions
+    const QByteArray dbPath = parser.positionalArguments()[0].toLocal8Bit();
+    qputenv(ENV_INTERNAL_PATH, "1");
+    qunsetenv(ENV_REGIONS_CONFIG);
+    qputenv(ENV_DB_PATH_GERMANY, dbPath);
+    qputenv(ENV_DB_PATH_BERLIN, dbPath);
+    for (const Region &region : regions())
+        FoosDB::Database::create(region.id, region.path);
+    std::shared_ptr<FoosDB::Database> dbRef = FoosDB::Database::instance(regions().first().id);
+    FoosDB::Database *db = dbRef.get();
+
+    //
+    // Create and drive the sessions
+    //
+    const qint64 rssBefore = residentKBytes();
+    QElapsedTimer timer;
+    timer.start();
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int i = 0; i < threadCount; ++i) {
+        const int sessions = sessionCount / threadCount + ((i < sessionCount % threadCount) ? 1 : 0);
+        workers.emplace_back(new Worker(db, sessions, rankingOnly, seed + i));
+    }
+
+    // sessions are bound to the thread that created them, so every worker keeps its sessions
+    // alive until RSS has been measured, and then tears them down itself
+    QMutex mutex;
+    QWaitCondition done;
+    int running = threadCount;
+    bool measured = false;
+
+    std::vector<std::thread> threads;
+    for (std::unique_ptr<Worker> &worker : workers) {
+        Worker *w = worker.get();
+        threads.emplace_back([&, w]() {
+            w->run();
+
+            QMutexLocker lock(&mutex);
+            if (--running == 0)
+                done.wakeAll();
+            while (!measured)
+                done.wait(&mutex);
+            lock.unlock();
+
+            w->release();
+        });
+    }
+
+    qint64 elapsedMsecs, rssAfter;
+    {
+        QMutexLocker lock(&mutex);
+        while (running > 0)
+            done.wait(&mutex);
+
+        elapsedMsecs = qMax(timer.elapsed(), qint64(1));
+        rssAfter = residentKBytes();
+        measured = true;
+        done.wakeAll();
+    }
+
+    //
+    // Report
+    //
+    qint64 opCount = 0;
+    printf("%-14s %8s %10s %10s %10s %10s\n", "operation", "count", "p50 us", "p90 us", "p99 us", "max us");
+    for (int op = 0; op < OPERATION_COUNT; ++op) {
+        QVector<qint64> all;
+        for (const std::unique_ptr<Worker> &worker : workers)
+            all += worker->latencies(op);
+        std::sort(all.begin(), all.end());
+        opCount += all.size();
+
+        printf("%-14s %8d %10lld %10lld %10lld %10lld\n", OPERATIONS[op], all.size(),
+               percentile(all, 0.5), percentile(all, 0.9), percentile(all, 0.99), all.isEmpty() ? 0 : all.last());
+    }
+
+    printf("\n%d sessions on %d threads in %lld ms: %.1f sessions/s, %.1f operations/s\n",
+           sessionCount, threadCount, elapsedMsecs,
+           sessionCount * 1000.0 / elapsedMsecs, opCount * 1000.0 / elapsedMsecs);
+    printf("RSS %lld kB -> %lld kB, %.1f kB per session\n",
+           rssBefore, rssAfter, double(rssAfter - rssBefore) / sessionCount);
+
+    for (std::thread &thread : threads)
+        thread.join();
+    dbRef.reset();
+    FoosDB::Database::destroy();
+
+    return 0;
+}
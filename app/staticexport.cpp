@@ -0,0 +1,441 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QThread>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+#include <QDebug>
+#include <QMutex>
+#include <QDate>
+#include <QSet>
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+#include "database.hpp"
+#include "global.hpp"
+#include "playercache.hpp"
+#include "jsonexport.hpp"
+
+/*
+ * Writes a static HTML + JSON snapshot of all ranking and player pages of one database,
+ * so that a plain web server can serve everything but the interactive search.
+ */
+
+static const int ENTRIES_PER_PAGE = 20;
+static const int PVP_ENTRIES = 4;
+static const char * const MANIFEST_NAME = ".manifest";
+
+//
+// Message bundle, read from the same elo.xml that the app uses
+//
+static QHash<QString, QString> s_messages;
+
+static void readMessages(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "Failed to open message bundle" << path;
+        return;
+    }
+
+    const QString xml = QString::fromUtf8(file.readAll());
+    const QRegularExpression messageExpr("<message id='([^']+)'>(.*?)</message>", QRegularExpression::DotMatchesEverythingOption);
+    for (auto it = messageExpr.globalMatch(xml); it.hasNext(); ) {
+        const QRegularExpressionMatch match = it.next();
+        s_messages[match.captured(1)] = match.captured(2).trimmed();
+    }
+}
+
+static QString tr(const QString &id, const QString &arg = QString())
+{
+    const QString msg = s_messages.value(id, "??" + id + "??");
+    return arg.isNull() ? msg : QString(msg).replace("{1}", arg);
+}
+
+static QString diff2str(int diff)
+{
+    return (diff >= 0) ? ("+" + QString::number(diff)) : QString::number(diff);
+}
+
+static QString playerName(const FoosDB::Player *player)
+{
+    return player ? (player->firstName() + " " + player->lastName()).toHtmlEscaped() : QString();
+}
+
+//
+// Output files are only rewritten if their content hash changed. Files of an earlier run that
+// weren't written in this one, e.g. of players that no longer exist, are deleted at the end.
+//
+class OutputDir
+{
+public:
+    OutputDir(const QString &path) : m_dir(path)
+    {
+        QFile manifest(m_dir.filePath(MANIFEST_NAME));
+        if (manifest.open(QFile::ReadOnly)) {
+            while (!manifest.atEnd()) {
+                const QList<QByteArray> parts = manifest.readLine().trimmed().split(' ');
+                if (parts.size() == 2)
+                    m_hashes[QString::fromUtf8(parts[1])] = parts[0];
+            }
+        }
+    }
+
+    ~OutputDir()
+    {
+        int removed = 0;
+        for (auto it = m_hashes.begin(); it != m_hashes.end(); ) {
+            if (m_touched.contains(it.key())) {
+                ++it;
+                continue;
+            }
+            QFile::remove(m_dir.filePath(it.key()));
+            it = m_hashes.erase(it);
+            removed++;
+        }
+        if (removed > 0)
+            qDebug() << "Removed" << removed << "stale files from" << m_dir.absolutePath();
+
+        QFile manifest(m_dir.filePath(MANIFEST_NAME));
+        if (manifest.open(QFile::WriteOnly | QFile::Truncate)) {
+            for (auto it = m_hashes.cbegin(); it != m_hashes.cend(); ++it)
+                manifest.write(it.value() + " " + it.key().toUtf8() + "\n");
+        }
+    }
+
+    void write(const QString &relPath, const QByteArray &content)
+    {
+        const QByteArray hash = QCryptographicHash::hash(content, QCryptographicHash::Sha1).toHex();
+        const QString path = m_dir.filePath(relPath);
+
+        {
+            QMutexLocker lock(&m_mutex);
+            m_touched.insert(relPath);
+            if (m_hashes.value(relPath) == hash && QFileInfo::exists(path)) {
+                m_skipped++;
+                return;
+            }
+            m_hashes[relPath] = hash;
+        }
+
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        QFile file(path);
+        if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+            qWarning() << "Failed to write" << path;
+            return;
+        }
+        file.write(content);
+
+        QMutexLocker lock(&m_mutex);
+        m_written++;
+    }
+
+    int written() const { return m_written; }
+    int skipped() const { return m_skipped; }
+
+private:
+    QDir m_dir;
+    QMutex m_mutex;
+    QHash<QString, QByteArray> m_hashes;
+    QSet<QString> m_touched;
+    int m_written = 0;
+    int m_skipped = 0;
+};
+
+//
+// HTML rendering, mirroring the structure and CSS classes of the Wt widgets
+//
+static QByteArray page(const QString &title, const QString &rootPath, const QString &content)
+{
+    QString ret;
+    QTextStream out(&ret);
+    out << "<!DOCTYPE html>\n<html><head><meta charset=\"utf-8\"/>"
+        << "<title>" << title << "</title>"
+        << "<link rel=\"stylesheet\" href=\"" << rootPath << "elo-style.css\"/></head>\n"
+        << "<body><div class=\"bg\"></div><div class=\"content_bg\"><div class=\"content\"><div class=\"content_inner\">\n"
+        << content
+        << "</div></div></div></body></html>\n";
+    out.flush();
+    return ret.toUtf8();
+}
+
+static QString rankingPath(JsonExport::RankingOrder order, int page)
+{
+    return "ranking/" + JsonExport::rankingOrderName(order) + "/" + QString::number(page);
+}
+
+static QString playerPath(const FoosDB::Player *player)
+{
+    return "player/" + QString::number(player->id);
+}
+
+static QByteArray renderRanking(FoosDB::Database *db, JsonExport::RankingOrder order, int page, int pageCount)
+{
+    const int start = page * ENTRIES_PER_PAGE;
+    const QVector<const FoosDB::Player*> players = (order == JsonExport::RankingOrder::Games)
+            ? db->getPlayersByMatchCount(start, ENTRIES_PER_PAGE)
+            : db->getPlayersByRanking((FoosDB::EloDomain) order, start, ENTRIES_PER_PAGE);
+
+    const auto orderLink = [&](JsonExport::RankingOrder o, const QString &label) {
+        const QString text = (o == order) ? "<b>" + label + "</b>" : label;
+        return "<a href=\"../../" + rankingPath(o, 0) + ".html\">" + text + "</a>";
+    };
+
+    QString html;
+    QTextStream out(&html);
+    out << tr("ranking_title", tr(QString::fromStdString(db->name()))) << "\n"
+        << "<table class=\"ranking_table\">\n"
+        << "<tr class=\"ranking_table_header\">"
+        << "<td class=\"ranking_col_1\"><b>" << tr("ranking_rank") << "</b></td>"
+        << "<td class=\"ranking_col_2\"><b>" << tr("ranking_name") << "</b></td>"
+        << "<td class=\"ranking_col_3\">" << orderLink(JsonExport::RankingOrder::Combined, tr("combo")) << "</td>"
+        << "<td class=\"ranking_col_4\">" << orderLink(JsonExport::RankingOrder::Single, tr("single")) << "</td>"
+        << "<td class=\"ranking_col_5\">" << orderLink(JsonExport::RankingOrder::Double, tr("double")) << "</td>"
+        << "<td class=\"ranking_col_6\">" << orderLink(JsonExport::RankingOrder::Games, tr("games")) << "</td>"
+        << "</tr>\n";
+
+    for (int i = 0; i < players.size(); ++i) {
+        const FoosDB::Player *p = players[i];
+        const QString c = ((i + 1) % 2 == 1) ? "ranking_table_1" : "ranking_table_2";
+        out << "<tr>"
+            << "<td class=\"" << c << "\">" << (start + i + 1) << "</td>"
+            << "<td class=\"" << c << "\"><a href=\"../../" << playerPath(p) << ".html\">" << playerName(p) << "</a></td>"
+            << "<td class=\"" << c << "\">" << p->eloCombined << "</td>"
+            << "<td class=\"" << c << "\">" << p->eloSingle << "</td>"
+            << "<td class=\"" << c << "\">" << p->eloDouble << "</td>"
+            << "<td class=\"" << c << "\">" << p->matchCount << "</td>"
+            << "</tr>\n";
+    }
+    out << "</table>\n<div>";
+    if (page > 0)
+        out << "<a style=\"float:left\" href=\"" << (page - 1) << ".html\">&lt;&lt;</a>";
+    if (page + 1 < pageCount)
+        out << "<a style=\"float:right\" href=\"" << (page + 1) << ".html\">&gt;&gt;</a>";
+    out << "</div>\n";
+    out.flush();
+
+    return ::page(tr("page_title"), "../../../", html);
+}
+
+static QString renderChart(const QVector<FoosDB::Player::EloProgression> &progression)
+{
+    if (progression.size() < 2)
+        return QString();
+
+    qint64 minDay = QDate(progression.first().year, progression.first().month, progression.first().day).toJulianDay();
+    qint64 maxDay = QDate(progression.last().year, progression.last().month, progression.last().day).toJulianDay();
+    int minElo = progression.first().eloCombined, maxElo = minElo;
+    for (const FoosDB::Player::EloProgression &pep : progression) {
+        minElo = qMin(minElo, (int) pep.eloCombined);
+        maxElo = qMax(maxElo, (int) pep.eloCombined);
+    }
+    maxDay = qMax(maxDay, minDay + 1);
+    maxElo = qMax(maxElo, minElo + 1);
+
+    QString points;
+    for (const FoosDB::Player::EloProgression &pep : progression) {
+        const qint64 day = QDate(pep.year, pep.month, pep.day).toJulianDay();
+        const double x = double(day - minDay) / double(maxDay - minDay) * CHART_WIDTH;
+        const double y = CHART_HEIGHT - double(pep.eloCombined - minElo) / double(maxElo - minElo) * CHART_HEIGHT;
+        points += QString::number(x, 'f', 1) + "," + QString::number(y, 'f', 1) + " ";
+    }
+
+    return QString("<svg width=\"%1\" height=\"%2\" style=\"background-color:#DCDCDC\">"
+                   "<polyline fill=\"none\" stroke=\"black\" points=\"%3\"/>"
+                   "<text x=\"4\" y=\"14\">%4</text><text x=\"4\" y=\"%5\">%6</text></svg>\n")
+            .arg(CHART_WIDTH).arg(CHART_HEIGHT).arg(points.trimmed())
+            .arg(maxElo).arg(CHART_HEIGHT - 4).arg(minElo);
+}
+
+static QByteArray renderPlayer(FoosDB::Database *db, const FoosDB::Player *player)
+{
+    const FoosDB::EloDomain domain = FoosDB::EloDomain::Combined;
+    const std::shared_ptr<const PlayerPageData> data = PlayerCache::instance().pageData(db, player);
+    const std::shared_ptr<const PlayerMatchPage> matches = PlayerCache::instance().matchPage(db, player, domain, 0, MATCHES_PER_PAGE);
+
+    const auto playerLink = [&](const FoosDB::Player *p) {
+        return p ? "<a href=\"" + QString::number(p->id) + ".html\">" + playerName(p) + "</a>" : QString();
+    };
+
+    QString html;
+    QTextStream out(&html);
+    out << "<a href=\"../" << rankingPath(JsonExport::RankingOrder::Combined, 0) << ".html\">&lt;&lt;</a>\n"
+        << "<h1>" << playerName(player) << "</h1>\n"
+        << "<table style=\"width:100%;text-align:center\"><tr>"
+        << "<td>" << tr("combo") << "<br/><b>" << player->eloCombined << "</b><br/>" << tr("player_peak", QString::number(data->peakCombined)) << "</td>"
+        << "<td>" << tr("double") << "<br/><b>" << player->eloDouble << "</b><br/>" << tr("player_peak", QString::number(data->peakDouble)) << "</td>"
+        << "<td>" << tr("single") << "<br/><b>" << player->eloSingle << "</b><br/>" << tr("player_peak", QString::number(data->peakSingle)) << "</td>"
+        << "</tr></table>\n"
+        << renderChart(data->chartProgression);
+
+    //
+    // PVP tables
+    //
+    const auto pvpTable = [&](const QString &title, FoosDB::PvpRole role, bool best) {
+        const QVector<const FoosDB::PlayerVsPlayerStats*> entries = best ? data->pvpStats->top(domain, role, PVP_ENTRIES)
+                                                                         : data->pvpStats->bottom(domain, role, PVP_ENTRIES);
+        out << "<td>" << tr(title) << "<table>";
+        for (int i = 0; i < entries.size(); ++i) {
+            const FoosDB::PlayerVsPlayerStats::Results res = FoosDB::PlayerVsPlayerBlock::results(*entries[i], domain, role);
+            out << "<tr><td class=\"" << ((i % 2 == 0) ? "player_pvp_1" : "player_pvp_2") << "\">"
+                << "<span class=\"" << (best ? "player_elo_plus" : "player_elo_minus") << "\">" << diff2str(res.delta) << "</span>"
+                << "<span class=\"player_pvp_stats\">  (" << res.wins << " : " << res.draws << " : " << res.losses << ")</span><br/>"
+                << playerLink(entries[i]->player) << "</td></tr>";
+        }
+        out << "</table></td>";
+    };
+    out << "<table style=\"width:100%\"><tr>";
+    pvpTable("player_opponents_loved", FoosDB::PvpRole::Opponent, true);
+    pvpTable("player_opponents_feared", FoosDB::PvpRole::Opponent, false);
+    pvpTable("player_partners_loved", FoosDB::PvpRole::Partner, true);
+    pvpTable("player_partners_feared", FoosDB::PvpRole::Partner, false);
+    out << "</tr></table>\n";
+
+    //
+    // Most recent matches
+    //
+    out << tr("player_matches") << "\n<table class=\"player_match_table\">\n";
+    for (int i = 0; i < matches->size(); ++i) {
+        const FoosDB::PlayerMatch &m = matches->at(i);
+        const QString c = (i % 2 == 1) ? "player_match_table_1" : "player_match_table_2";
+        const auto participant = [&](const FoosDB::PlayerMatch::Participant &p) {
+            return p.player ? playerLink(p.player) + " (" + QString::number(p.eloCombined) + ")<br/>" : QString();
+        };
+        const QString score = (m.myScore + m.opponentScore > 1)
+                ? QString::number(m.myScore) + ":" + QString::number(m.opponentScore)
+                : tr((m.myScore > 0) ? "win" : "loss");
+
+        out << "<tr>"
+            << "<td class=\"player_match_col_1 " << c << "\"><span class=\"player_match_date\">"
+            << m.date.date().toString("dd.MM.yyyy") << "</span><br/>"
+            << "<span class=\"player_match_competition\">" << m.competitionName.toHtmlEscaped() << "</span></td>"
+            << "<td class=\"player_match_col_2 " << c << "\">" << participant(m.myself) << participant(m.partner) << "</td>"
+            << "<td class=\"player_match_col_3 " << c << "\">" << score << "<br/>"
+            << "<span class=\"" << ((m.eloCombinedDiff >= 0) ? "player_elo_plus" : "player_elo_minus") << "\">"
+            << diff2str(m.eloCombinedDiff) << "</span></td>"
+            << "<td class=\"player_match_col_4 " << c << "\">" << participant(m.opponent1) << participant(m.opponent2) << "</td>"
+            << "</tr>\n";
+    }
+    out << "</table>\n";
+    out.flush();
+
+    return page(playerName(player), "../../", html);
+}
+
+static QByteArray toJson(const QJsonObject &obj)
+{
+    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+}
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("eloexport");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Exports static HTML/JSON ranking and player pages");
+    parser.addHelpOption();
+    parser.addPositionalArgument("sqlite", "Path to SQLite database");
+    parser.addPositionalArgument("output", "Output directory");
+    QCommandLineOption nameOption(QStringList{"name", "n"}, "Database name, used for the title and the output sub-directory", "name", "ger");
+    parser.addOption(nameOption);
+    QCommandLineOption cssOption(QStringList{"css"}, "Style sheet to copy into the output", "path", "docroot/elo-style.css");
+    parser.addOption(cssOption);
+    QCommandLineOption messagesOption(QStringList{"messages"}, "Message bundle to read texts from", "path", "elo.xml");
+    parser.addOption(messagesOption);
+    QCommandLineOption threadsOption(QStringList{"threads", "j"}, "Number of render threads (default: all cores)", "count");
+    parser.addOption(threadsOption);
+
+    parser.process(app);
+    if (parser.positionalArguments().size() != 2)
+        parser.showHelp(1);
+
+    const QString sqlitePath = parser.positionalArguments()[0];
+    const std::string name = parser.value(nameOption).toStdString();
+    const int threadCount = parser.isSet(threadsOption) ? qMax(parser.value(threadsOption).toInt(), 1)
+                                                        : QThread::idealThreadCount();
+
+    readMessages(parser.value(messagesOption));
+
+    QElapsedTimer timer;
+    timer.start();
+
+    FoosDB::Database::create(name, sqlitePath.toStdString());
+    std::shared_ptr<FoosDB::Database> dbRef = FoosDB::Database::instance(name);
+    FoosDB::Database *db = dbRef.get();
+    qDebug() << "Loaded" << db->getPlayerCount() << "players in" << timer.elapsed() << "msecs";
+
+    QDir outDir(parser.positionalArguments()[1]);
+    QDir().mkpath(outDir.absolutePath());
+
+    int written = 0, skipped = 0;
+    {
+        OutputDir rootDir(outDir.absolutePath());
+        OutputDir dbDir(outDir.filePath(QString::fromStdString(name)));
+
+        QFile css(parser.value(cssOption));
+        if (css.open(QFile::ReadOnly))
+            rootDir.write("elo-style.css", css.readAll());
+        else
+            qWarning() << "Failed to read style sheet" << css.fileName();
+
+        //
+        // Collect all pages, and render them in parallel
+        //
+        QVector<std::function<void()>> jobs;
+
+        const int pageCount = (db->getPlayerCount() + ENTRIES_PER_PAGE - 1) / ENTRIES_PER_PAGE;
+        for (JsonExport::RankingOrder order : { JsonExport::RankingOrder::Combined, JsonExport::RankingOrder::Single,
+                                                JsonExport::RankingOrder::Double, JsonExport::RankingOrder::Games }) {
+            for (int page = 0; page < pageCount; ++page) {
+                jobs << [=, &dbDir]() {
+                    dbDir.write(rankingPath(order, page) + ".html", renderRanking(db, order, page, pageCount));
+                    dbDir.write(rankingPath(order, page) + ".json", toJson(JsonExport::ranking(db, order, page * ENTRIES_PER_PAGE, ENTRIES_PER_PAGE)));
+                };
+            }
+        }
+
+        for (const FoosDB::Player *player : db->getPlayersByRanking(FoosDB::EloDomain::Combined)) {
+            jobs << [=, &dbDir]() {
+                QJsonObject json = JsonExport::playerSummary(db, player);
+                json["progression"] = JsonExport::progression(db, player)["points"];
+                json["matches"] = JsonExport::matches(db, player, FoosDB::EloDomain::Combined, 0, MATCHES_PER_PAGE)["matches"];
+
+                dbDir.write(playerPath(player) + ".html", renderPlayer(db, player));
+                dbDir.write(playerPath(player) + ".json", toJson(json));
+            };
+        }
+
+        dbDir.write("index.html", page(tr("page_title"), "../",
+                                       "<meta http-equiv=\"refresh\" content=\"0; url="
+                                       + rankingPath(JsonExport::RankingOrder::Combined, 0) + ".html\"/>"));
+
+        std::atomic<int> nextJob(0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < threadCount; ++i) {
+            threads.emplace_back([&]() {
+                for (int job = nextJob++; job < jobs.size(); job = nextJob++)
+                    jobs[job]();
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        written = rootDir.written() + dbDir.written();
+        skipped = rootDir.skipped() + dbDir.skipped();
+    }
+
+    qDebug() << "Exported" << written << "changed files," << skipped << "unchanged, using"
+             << threadCount << "threads in" << timer.elapsed() << "msecs";
+
+    dbRef.reset();
+    FoosDB::Database::destroy();
+    return 0;
+}
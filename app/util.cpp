@@ -1,14 +1,28 @@
 #include "util.hpp"
 
-CheapProfiler::CheapProfiler(const QString &title) : m_title(title)
+#include <QHash>
+
+static Metrics::Histogram &scopeHistogram(const char *title)
+{
+    thread_local QHash<const char*, Metrics::Histogram*> s_histograms;
+
+    Metrics::Histogram *&histogram = s_histograms[title];
+    if (!histogram)
+        histogram = &Metrics::histogram("eloapp_scope_duration_seconds", "scope=" + Metrics::labelValue(title));
+    return *histogram;
+}
+
+CheapProfiler::CheapProfiler(const char *title)
+    : m_title(title)
+    , m_histogram(scopeHistogram(title))
 {
-#ifdef ENABLE_CHEAP_PROFILER
     m_timer.start();
-#endif
 }
 
 CheapProfiler::~CheapProfiler()
 {
+    m_histogram.observe(m_timer.nsecsElapsed() / 1000);
+
 #ifdef ENABLE_CHEAP_PROFILER
     const qint64 msecs = m_timer.elapsed();
 #if QT_VERSION > QT_VERSION_CHECK(5, 4, 0)
@@ -33,3 +47,56 @@ bool removePrefix(std::string &str, const std::string &prefix)
     }
     return false;
 }
+
+QVector<int> downsampleLttb(const QVector<QPointF> &points, int threshold)
+{
+    QVector<int> ret;
+
+    if (threshold >= points.size() || threshold < 3) {
+        ret.reserve(points.size());
+        for (int i = 0; i < points.size(); ++i)
+            ret << i;
+        return ret;
+    }
+
+    ret.reserve(threshold);
+    ret << 0;
+
+    // first and last point are always kept, the rest is split into equally sized buckets
+    const double bucketSize = double(points.size() - 2) / double(threshold - 2);
+    int selected = 0;
+
+    for (int bucket = 0; bucket < threshold - 2; ++bucket) {
+        const int begin = int(bucket * bucketSize) + 1;
+        const int end = qMin(int((bucket + 1) * bucketSize) + 1, points.size() - 1);
+
+        // average of the next bucket serves as the third triangle vertex
+        const int nextBegin = end;
+        const int nextEnd = qMin(int((bucket + 2) * bucketSize) + 1, points.size());
+        double avgX = 0.0, avgY = 0.0;
+        for (int i = nextBegin; i < nextEnd; ++i) {
+            avgX += points[i].x();
+            avgY += points[i].y();
+        }
+        avgX /= qMax(nextEnd - nextBegin, 1);
+        avgY /= qMax(nextEnd - nextBegin, 1);
+
+        const QPointF &a = points[selected];
+        double maxArea = -1.0;
+        int maxIndex = begin;
+        for (int i = begin; i < end; ++i) {
+            const double area = qAbs((a.x() - avgX) * (points[i].y() - a.y())
+                                     - (a.x() - points[i].x()) * (avgY - a.y()));
+            if (area > maxArea) {
+                maxArea = area;
+                maxIndex = i;
+            }
+        }
+
+        ret << maxIndex;
+        selected = maxIndex;
+    }
+
+    ret << points.size() - 1;
+    return ret;
+}
@@ -2,21 +2,37 @@
 
 #include <QElapsedTimer>
 #include <QString>
+#include <QVector>
+#include <QPointF>
 #include <QDebug>
 
+#include "metrics.hpp"
+
 //#define ENABLE_CHEAP_PROFILER
 
+/*
+ * Records the time spent in a scope into the eloapp_scope_duration_seconds histogram,
+ * labeled with the title. The title must be a string literal, its address is used to
+ * look up the histogram without locking. With ENABLE_CHEAP_PROFILER, also logs every scope.
+ */
 class CheapProfiler
 {
 public:
-    CheapProfiler(const QString &title);
+    CheapProfiler(const char *title);
     ~CheapProfiler();
 
 private:
-    const QString m_title;
+    const char * const m_title;
+    Metrics::Histogram &m_histogram;
     QElapsedTimer m_timer;
 };
 
 bool removePrefix(std::string &str, const std::string &prefix);
 
+/*
+ * Largest-Triangle-Three-Buckets downsampling: returns the (ascending) indices of at most
+ * 'threshold' points that preserve the visual shape of the series. Points must be sorted by x.
+ */
+QVector<int> downsampleLttb(const QVector<QPointF> &points, int threshold);
+
 QDebug& operator<<(QDebug &dbg, const std::string &s);
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <QtGlobal>
+#include <QString>
+
+/*
+ * Binary snapshot of a recomputed database, written by the scraper next to the sqlite file
+ * and memory-mapped read-only by the app, so that all processes serving a region share its
+ * pages and don't have to run any SQL for players, ratings, PVP stats, progression or matches.
+ *
+ * The file starts with a Header, followed by the sections listed in its section table.
+ * All references between sections are indices (or byte offsets for strings), never pointers,
+ * so the file can be mapped at any address. Numbers are stored in the byte order of the
+ * machine that wrote the file; readers on a machine with a different byte order fall back
+ * to sqlite, as they do for a wrong magic, version, size or checksum.
+ *
+ * The checksum is also stored in the sqlite table snapshot_info, so that a snapshot that
+ * doesn't belong to the sqlite file next to it (e.g. because the scraper died in between)
+ * is ignored as well.
+ */
+namespace Snapshot {
+
+static const char MAGIC[8] = { 'F', 'O', 'O', 'S', 'S', 'N', 'A', 'P' };
+static const quint32 VERSION = 2;
+static const quint32 BYTE_ORDER_MARK = 0x01020304;
+
+enum SectionId
+{
+    StringsSection,         // UTF-8 bytes, count is in bytes
+    PlayersSection,         // Player, sorted by id
+    ProgressionSection,     // ProgressionPoint, chronological per player
+    PlayerVsPlayerSection,  // PlayerVsPlayer, grouped by player
+    CompetitionsSection,    // Competition
+    MatchesSection,         // Match, chronological
+    PlayedMatchesSection,   // PlayedMatch, grouped by player, newest first
+    SectionCount
+};
+
+struct Section
+{
+    quint64 offset;     // from the start of the file, aligned to 8 bytes
+    quint64 count;      // number of records
+};
+
+struct Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint64 fileSize;
+    quint64 checksum;   // of everything after the header
+    qint64 createdAt;   // msecs since epoch
+    Section sections[SectionCount];
+};
+
+struct StringRef
+{
+    quint32 offset;
+    quint32 length;
+};
+
+struct Player
+{
+    qint32 id;
+    StringRef firstName;
+    StringRef lastName;
+    qint16 eloSingle;
+    qint16 eloDouble;
+    qint16 eloCombined;
+    qint16 reserved;
+    quint32 singleCount;
+    quint32 doubleCount;
+    quint32 progressionBegin;
+    quint32 progressionCount;
+    quint32 pvpBegin;
+    quint32 pvpCount;
+    quint32 playedBegin;
+    quint32 playedCount;
+};
+
+struct ProgressionPoint
+{
+    qint16 year, month, day;
+    qint16 single, dbl, combined;
+    quint16 rankSingle, rankDouble, rankCombined;   // 0 if not ranked in that domain yet
+};
+
+struct PlayerVsPlayer
+{
+    qint32 otherId;
+    qint16 singleWins, singleDraws, singleLosses;
+    qint16 doubleWins, doubleDraws, doubleLosses;
+    qint16 partnerWins, partnerDraws, partnerLosses;
+    qint16 combinedDelta, doubleDelta, singleDelta;
+    qint16 partnerCombinedDelta, partnerDoubleDelta;
+};
+
+struct Competition
+{
+    StringRef name;
+    qint16 year;
+    qint8 month;
+    qint8 day;
+    qint8 type;         // CompetitionType
+    quint8 reserved[3];
+};
+
+struct Match
+{
+    quint32 competition;
+    qint8 type;         // MatchType
+    quint8 reserved;
+    qint16 score1;
+    qint16 score2;
+    qint16 reserved2;
+    // p1, p2, p11, p22 as in the matches table, with their ratings before the match
+    qint32 players[4];
+    qint16 eloSeparate[4];
+    qint16 eloCombined[4];
+};
+
+struct PlayedMatch
+{
+    quint32 match;
+    qint16 separateChange;
+    qint16 combinedChange;
+};
+
+static_assert(sizeof(Header) == 40 + 16 * SectionCount, "unexpected padding in Snapshot::Header");
+static_assert(sizeof(Player) == 60, "unexpected padding in Snapshot::Player");
+static_assert(sizeof(ProgressionPoint) == 18, "unexpected padding in Snapshot::ProgressionPoint");
+static_assert(sizeof(PlayerVsPlayer) == 32, "unexpected padding in Snapshot::PlayerVsPlayer");
+static_assert(sizeof(Competition) == 16, "unexpected padding in Snapshot::Competition");
+static_assert(sizeof(Match) == 44, "unexpected padding in Snapshot::Match");
+static_assert(sizeof(PlayedMatch) == 8, "unexpected padding in Snapshot::PlayedMatch");
+
+inline QString pathFor(const QString &sqlitePath)
+{
+    return sqlitePath + ".snapshot";
+}
+
+// 64 bit FNV-1a
+inline quint64 checksum(const char *data, quint64 size)
+{
+    quint64 hash = 14695981039346656037ULL;
+    for (quint64 i = 0; i < size; ++i) {
+        hash ^= (uchar) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+} // namespace Snapshot
@@ -0,0 +1,154 @@
+#include "bradleyterry.hpp"
+
+#include <QtMath>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+static const int SLOTS = 4;
+
+// calls fn(begin, end, thread) for threadCount contiguous ranges of [0, n)
+template<typename Fn>
+static void parallelFor(int n, int threadCount, Fn fn)
+{
+    if (threadCount <= 1 || n < 4096) {
+        fn(0, n, 0);
+        return;
+    }
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        const int begin = qint64(n) * t / threadCount;
+        const int end = qint64(n) * (t + 1) / threadCount;
+        threads.emplace_back([=]() { fn(begin, end, t); });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+}
+
+int BradleyTerry::playerIndex(int id)
+{
+    const auto it = m_indices.constFind(id);
+    if (it != m_indices.cend())
+        return it.value();
+
+    m_indices.insert(id, m_ids.size());
+    m_ids << id;
+    return m_ids.size() - 1;
+}
+
+void BradleyTerry::addGame(const int *team1, const int *team2, int teamSize, float result, float weight)
+{
+    for (int i = 0; i < 2; ++i) {
+        const bool used = (i < teamSize);
+        m_players << (used ? playerIndex(team1[i]) : 0);
+        m_coefficients << (used ? 1.0f / teamSize : 0.0f);
+    }
+    for (int i = 0; i < 2; ++i) {
+        const bool used = (i < teamSize);
+        m_players << (used ? playerIndex(team2[i]) : 0);
+        m_coefficients << (used ? -1.0f / teamSize : 0.0f);
+    }
+    m_results << result;
+    m_weights << weight;
+}
+
+BradleyTerry::Result BradleyTerry::solve(const Options &options) const
+{
+    const int playerCount = m_ids.size();
+    const int gameCount = m_results.size();
+    const int threadCount = qMax(options.threadCount, 1);
+
+    // p = 1 / (1 + 10^(-d/400)) = logistic(a * d)
+    const double a = qLn(10.0) / 400.0;
+    const double priorCurvature = 1.0 / (double(options.priorDeviation) * options.priorDeviation);
+
+    //
+    // Transpose the game slots into a CSR matrix of every player's (slot, coefficient)
+    //
+    QVector<int> offsets(playerCount + 1, 0);
+    for (int s = 0; s < gameCount * SLOTS; ++s) {
+        if (m_coefficients[s] != 0.0f)
+            offsets[m_players[s] + 1]++;
+    }
+    for (int i = 0; i < playerCount; ++i)
+        offsets[i + 1] += offsets[i];
+
+    QVector<int> incidences(offsets[playerCount]);
+    {
+        QVector<int> fill = offsets;
+        for (int s = 0; s < gameCount * SLOTS; ++s) {
+            if (m_coefficients[s] != 0.0f)
+                incidences[fill[m_players[s]]++] = s;
+        }
+    }
+
+    const int *players = m_players.constData();
+    const float *coefficients = m_coefficients.constData();
+    const float *results = m_results.constData();
+    const float *weights = m_weights.constData();
+    const int *offsetData = offsets.constData();
+    const int *incidenceData = incidences.constData();
+
+    QVector<double> ratings(playerCount, options.prior);
+    QVector<double> gradients(gameCount), curvatures(gameCount);
+    QVector<float> maxChanges(threadCount);
+    double *ratingData = ratings.data();
+    double *gradientData = gradients.data();
+    double *curvatureData = curvatures.data();
+    float *maxChangeData = maxChanges.data();
+
+    Result ret;
+    for (ret.iterations = 1; ret.iterations <= options.maxIterations; ++ret.iterations) {
+        //
+        // Per game: derivatives of the weighted log likelihood by the rating difference
+        //
+        parallelFor(gameCount, threadCount, [&](int begin, int end, int) {
+            for (int g = begin; g < end; ++g) {
+                double diff = 0.0;
+                for (int s = g * SLOTS; s < (g + 1) * SLOTS; ++s)
+                    diff += coefficients[s] * ratingData[players[s]];
+                const double p = 1.0 / (1.0 + qExp(-a * diff));
+                gradientData[g] = weights[g] * a * (results[g] - p);
+                curvatureData[g] = weights[g] * a * a * p * (1.0 - p);
+            }
+        });
+
+        //
+        // Per player: diagonal Newton step. The coefficients of a game's slots sum to 2 in
+        // absolute value, so |c| * 2 * curvature bounds the player's row of the Hessian.
+        //
+        parallelFor(playerCount, threadCount, [&](int begin, int end, int thread) {
+            float maxChange = 0.0f;
+            for (int i = begin; i < end; ++i) {
+                double gradient = -(ratingData[i] - options.prior) * priorCurvature;
+                double curvature = priorCurvature;
+                for (int k = offsetData[i]; k < offsetData[i + 1]; ++k) {
+                    const int s = incidenceData[k];
+                    const double c = coefficients[s];
+                    gradient += c * gradientData[s / SLOTS];
+                    curvature += qAbs(c) * 2.0 * curvatureData[s / SLOTS];
+                }
+                const double change = gradient / curvature;
+                ratingData[i] += change;
+                maxChange = qMax(maxChange, float(qAbs(change)));
+            }
+            maxChangeData[thread] = maxChange;
+        });
+
+        ret.maxChange = 0.0f;
+        for (int t = 0; t < threadCount; ++t) {
+            ret.maxChange = qMax(ret.maxChange, maxChangeData[t]);
+            maxChangeData[t] = 0.0f;
+        }
+        if (ret.maxChange < options.tolerance)
+            break;
+    }
+    ret.iterations = qMin(ret.iterations, options.maxIterations);
+
+    ret.ratings.reserve(playerCount);
+    for (int i = 0; i < playerCount; ++i)
+        ret.ratings.insert(m_ids[i], float(ratings[i]));
+    return ret;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+/*
+ * Batch maximum likelihood ratings (Bradley-Terry) on the ELO scale.
+ *
+ * Unlike EloRating, the result doesn't depend on the order of the games. A double team plays
+ * with the average of its players' ratings, like in EloRating::adjust(). Games are weighted
+ * (e.g. by age), and a normal prior around the starting rating keeps players with only wins
+ * or losses finite.
+ *
+ * The fit uses parallel diagonal Newton steps over the sparse player/game incidence matrix;
+ * each player's curvature is bounded by its Gershgorin row sum, so the simultaneous steps of
+ * partners and opponents can't overshoot each other.
+ */
+class BradleyTerry
+{
+public:
+    struct Options {
+        float prior = 1000.0f;
+        float priorDeviation = 400.0f;
+        float tolerance = 0.01f;        // max rating change of an iteration to stop at
+        int maxIterations = 1000;
+        int threadCount = 1;
+    };
+
+    struct Result {
+        QHash<int, float> ratings;      // by player id
+        int iterations = 0;
+        float maxChange = 0.0f;
+    };
+
+    // result is 1 if team 1 won, 0.5 for a draw; teams have teamSize (1 or 2) players
+    void addGame(const int *team1, const int *team2, int teamSize, float result, float weight);
+
+    int gameCount() const { return m_results.size(); }
+
+    Result solve(const Options &options) const;
+
+private:
+    int playerIndex(int id);
+
+    QHash<int, int> m_indices;
+    QVector<int> m_ids;
+
+    // per game, the four player slots (team 1, team 1, team 2, team 2) and their
+    // coefficients in the rating difference: +1/n, -1/n, or 0 for unused slots
+    QVector<int> m_players;
+    QVector<float> m_coefficients;
+    QVector<float> m_results;
+    QVector<float> m_weights;
+};
@@ -1,15 +1,25 @@
 #include "database.hpp"
 #include "rating.hpp"
+#include "ranktracker.hpp"
+#include "pairratings.hpp"
+#include "bradleyterry.hpp"
+#include "kfactorfit.hpp"
+#include "snapshotwriter.hpp"
 
+#include <QSet>
 #include <QSqlDriver>
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QFileInfo>
+#include <QElapsedTimer>
+#include <QtEndian>
 #include <QDebug>
 
-Database::Database(const QString &sqlitePath, float kLeague, float kTournament)
-    : m_kLeague(kLeague)
-    , m_kTournament(kTournament)
+#include <cmath>
+
+Database::Database(const QString &sqlitePath, const KFactors &kFactors, const RatingRules &rules)
+    : m_kFactors(kFactors)
+    , m_rules(rules)
     , m_db(QSqlDatabase::addDatabase("QSQLITE"))
 {
     m_db.setDatabaseName(sqlitePath);
@@ -96,6 +106,26 @@ void Database::createTables()
         primary key (player_id))"
     );
 
+    // order independent ratings from Database::fitBradleyTerry(), like elo_current
+    execQuery("CREATE TABLE IF NOT EXISTS bradley_terry ( \
+        player_id integer NOT NULL, \
+        single smallint NOT NULL, \
+        double smallint NOT NULL, \
+        combined smallint NOT NULL, \
+        primary key (player_id))"
+    );
+
+    // current ratings of double teams, player1_id < player2_id
+    execQuery("CREATE TABLE IF NOT EXISTS elo_pairs ( \
+        player1_id integer NOT NULL, \
+        player2_id integer NOT NULL, \
+        rating smallint NOT NULL, \
+        wins smallint NOT NULL, \
+        draws smallint NOT NULL, \
+        losses smallint NOT NULL, \
+        primary key (player1_id, player2_id))"
+    );
+
     execQuery("CREATE TABLE IF NOT EXISTS player_vs_player_stats ( \
         player_id integer NOT NULL, \
         other_id integer NOT NULL, \
@@ -115,11 +145,44 @@ void Database::createTables()
         partner_double_delta smallint NOT NULL)"
     );
 
+    // one blob per player, holding a chronological series of packed little-endian
+    // int16 tuples (year, month, day, single, double, combined), one per match day
+    execQuery("CREATE TABLE IF NOT EXISTS player_progression ( \
+        player_id integer NOT NULL, \
+        data blob NOT NULL, \
+        primary key (player_id))"
+    );
+
+    // ratings of all players that had played until the end of the given day (yyyymmdd), written
+    // weekly by recompute(). last_played_match_id is the last match included, later matches can be
+    // replayed from played_matches. data is a qCompress'ed array of packed little-endian tuples
+    // (int32 player_id, int16 single, int16 double, int16 combined, uint16 match_count)
+    execQuery("CREATE TABLE IF NOT EXISTS rating_checkpoints ( \
+        date integer NOT NULL, \
+        last_played_match_id integer NOT NULL, \
+        data blob NOT NULL, \
+        primary key (date))"
+    );
+
+    // checksum of the snapshot file written by the last recompute, see common/snapshot.hpp
+    execQuery("CREATE TABLE IF NOT EXISTS snapshot_info ( \
+        checksum integer NOT NULL)"
+    );
+
+    // one blob per player with a packed little-endian uint16 triple (single, double, combined)
+    // for every entry of the player's progression, holding the ranks at the end of that day
+    execQuery("CREATE TABLE IF NOT EXISTS player_rank_progression ( \
+        player_id integer NOT NULL, \
+        data blob NOT NULL, \
+        primary key (player_id))"
+    );
+
     execQuery("CREATE INDEX IF NOT EXISTS played_matches_player_index ON played_matches(player_id)");
     execQuery("CREATE INDEX IF NOT EXISTS played_matches_match_index ON played_matches(match_id)");
     execQuery("CREATE INDEX IF NOT EXISTS elo_combined_match_index ON elo_combined(played_match_id)");
     execQuery("CREATE INDEX IF NOT EXISTS elo_separate_match_index ON elo_separate(played_match_id)");
     execQuery("CREATE INDEX IF NOT EXISTS pvp_index ON player_vs_player_stats(player_id)");
+    execQuery("CREATE INDEX IF NOT EXISTS elo_pairs_rating_index ON elo_pairs(rating)");
 }
 
 void Database::checkQueryStatus(const QSqlQuery &query) const
@@ -142,6 +205,156 @@ void Database::createQueries()
     }
 }
 
+void Database::compileRatingRules()
+{
+    m_kTable = compileRatingRules(m_rules);
+
+    m_dayTable.fill(0, m_kTable.size() / 2);
+    for (const Competition &competition : m_competitions)
+        m_dayTable[competition.id] = competition.dateTime.date().toJulianDay();
+}
+
+QVector<float> Database::compileRatingRules(const RatingRules &rules) const
+{
+    int maxId = 0;
+    for (const Competition &competition : m_competitions)
+        maxId = qMax(maxId, competition.id);
+
+    QVector<float> ret((maxId + 1) * 2, 0.0f);
+    for (const Competition &competition : m_competitions) {
+        rules.kFactors(competition.type, competition.name, competition.dateTime.date(),
+                       ret[competition.id * 2], ret[competition.id * 2 + 1]);
+    }
+    return ret;
+}
+
+void Database::fitBradleyTerry(float halfLifeDays, int threadCount)
+{
+    QDate lastDate;
+    for (const Competition &competition : m_competitions)
+        lastDate = qMax(lastDate, competition.dateTime.date());
+
+    // the matches that count most in recompute() weigh 1
+    compileRatingRules();
+    float maxK = 0.0f;
+    for (float k : m_kTable)
+        maxK = qMax(maxK, k);
+
+    //
+    // Collect all matches, weighted by age and like their k-factor
+    //
+    BradleyTerry single, dbl, combined;
+    for (const Match &match : m_matches) {
+        const float result = (match.score1 > match.score2) ? 1.0f :
+                             (match.score1 < match.score2) ? 0.0f : 0.5f;
+        const qint64 age = m_competitions[match.competition].dateTime.date().daysTo(lastDate);
+        const float weight = kFactor(match) / qMax(maxK, 1e-6f) * std::pow(0.5f, age / halfLifeDays);
+
+        if (match.type == MatchType::Single) {
+            single.addGame(&match.p1, &match.p2, 1, result, weight);
+            combined.addGame(&match.p1, &match.p2, 1, result, weight);
+        }
+        else if (match.type == MatchType::Double) {
+            const int team1[2] = { match.p1, match.p11 };
+            const int team2[2] = { match.p2, match.p22 };
+            dbl.addGame(team1, team2, 2, result, weight);
+            combined.addGame(team1, team2, 2, result, weight);
+        }
+    }
+
+    BradleyTerry::Options options;
+    options.threadCount = threadCount;
+
+    QHash<int, float> ratings[3];
+    BradleyTerry *models[3] = { &single, &dbl, &combined };
+    const char *names[3] = { "single", "double", "combined" };
+    for (int i = 0; i < 3; ++i) {
+        QElapsedTimer timer;
+        timer.start();
+        const BradleyTerry::Result result = models[i]->solve(options);
+        ratings[i] = result.ratings;
+        qWarning() << "Fitted" << names[i] << "Bradley-Terry ratings to" << models[i]->gameCount() << "matches in"
+                   << result.iterations << "iterations," << timer.elapsed() << "msecs, last change" << result.maxChange;
+    }
+
+    //
+    // Write them like elo_current
+    //
+    QVariantList playerIds, singleRatings, doubleRatings, combinedRatings;
+    for (auto it = m_players.cbegin(); it != m_players.cend(); ++it) {
+        playerIds << it->id;
+        singleRatings << (qint16) qRound(ratings[0].value(it->id, options.prior));
+        doubleRatings << (qint16) qRound(ratings[1].value(it->id, options.prior));
+        combinedRatings << (qint16) qRound(ratings[2].value(it->id, options.prior));
+    }
+
+    m_db.transaction();
+    execQuery("DELETE FROM bradley_terry");
+    QSqlQuery query;
+    query.prepare("INSERT INTO bradley_terry (player_id, single, double, combined) VALUES (?, ?, ?, ?)");
+    query.addBindValue(playerIds);
+    query.addBindValue(singleRatings);
+    query.addBindValue(doubleRatings);
+    query.addBindValue(combinedRatings);
+    query.execBatch();
+    checkQueryStatus(query);
+    m_db.commit();
+}
+
+QHash<int, Database::CurrentRating> Database::currentRatings()
+{
+    QHash<int, CurrentRating> ret;
+    QSqlQuery query("SELECT player_id, single, double, combined FROM elo_current");
+    checkQueryStatus(query);
+    while (query.next()) {
+        ret.insert(query.value(0).toInt(), CurrentRating{
+            query.value(1).toFloat(), query.value(2).toFloat(), query.value(3).toFloat()
+        });
+    }
+    return ret;
+}
+
+QHash<int, Database::LeagueGameResult> Database::leagueGameResults(const QVector<int> &tfvbIds) const
+{
+    QSet<int> wanted;
+    for (int tfvbId : tfvbIds)
+        wanted.insert(tfvbId);
+
+    QHash<int, LeagueGameResult> ret;
+    QHash<int, int> tfvbIdByCompetition;
+    for (const Competition &competition : m_competitions) {
+        if (competition.type == CompetitionType::League && wanted.contains(competition.tfvbId)) {
+            tfvbIdByCompetition.insert(competition.id, competition.tfvbId);
+            ret[competition.tfvbId].name = competition.name;
+        }
+    }
+
+    // p1 and p11 play for the team named first
+    for (const Match &match : m_matches) {
+        const auto it = tfvbIdByCompetition.constFind(match.competition);
+        if (it == tfvbIdByCompetition.cend())
+            continue;
+
+        LeagueGameResult &result = ret[*it];
+        result.matchCount++;
+        if (match.score1 > match.score2)
+            result.homeWins++;
+        else if (match.score1 < match.score2)
+            result.awayWins++;
+
+        for (int p : { match.p1, match.p11 }) {
+            if (p && !result.homePlayers.contains(p))
+                result.homePlayers << p;
+        }
+        for (int p : { match.p2, match.p22 }) {
+            if (p && !result.awayPlayers.contains(p))
+                result.awayPlayers << p;
+        }
+    }
+
+    return ret;
+}
+
 void Database::readData()
 {
     QSqlQuery playerQuery("SELECT id, firstName, lastName FROM players");
@@ -320,15 +533,15 @@ struct RatingChange
     float rating;
 };
 
-void Database::recompute()
+QVector<Database::Match> Database::sortedMatches() const
 {
     //
     // build a list of all matches, sorted by time/pos
     //
-    QVector<Match> sortedMatches;
+    QVector<Match> ret;
     for (auto it = m_matches.cbegin(); it != m_matches.cend(); ++it)
-        sortedMatches << it.value();
-    std::sort(sortedMatches.begin(), sortedMatches.end(), [&](const Match &m1, const Match &m2) {
+        ret << it.value();
+    std::sort(ret.begin(), ret.end(), [&](const Match &m1, const Match &m2) {
         if (m1.competition == m2.competition) {
             return m1.position < m2.position;
         }
@@ -339,6 +552,56 @@ void Database::recompute()
         }
         return t1 < t2;
     });
+    return ret;
+}
+
+KFactors Database::fitKFactors(int threadCount)
+{
+    //
+    // Matches in the order they are rated, with dense player indices
+    //
+    QHash<int, int> indices;
+    const auto index = [&](int id) {
+        const auto it = indices.constFind(id);
+        return (it != indices.cend()) ? it.value() : *indices.insert(id, indices.size());
+    };
+
+    QVector<KFactorFit::Match> matches;
+    for (const Match &match : sortedMatches()) {
+        if (match.type != MatchType::Single && match.type != MatchType::Double)
+            continue;
+
+        const bool isDouble = (match.type == MatchType::Double);
+        KFactorFit::Match m;
+        m.players[0] = index(match.p1);
+        m.players[1] = isDouble ? index(match.p11) : 0;
+        m.players[2] = index(match.p2);
+        m.players[3] = isDouble ? index(match.p22) : 0;
+        m.isDouble = isDouble;
+        m.kIndex = match.competition * 2 + (RatingRules::isSingleSet(match.score1, match.score2) ? 1 : 0);
+        m.result = (match.score1 > match.score2) ? 1.0f :
+                   (match.score1 < match.score2) ? 0.0f : 0.5f;
+        m.year = m_competitions[match.competition].dateTime.date().year();
+        matches << m;
+    }
+
+    qWarning() << "Fitting k-factors to" << matches.size() << "matches of" << indices.size() << "players";
+    // candidates are rated like recompute() would with the built-in rules made from them
+    compileRatingRules();
+    const auto kTable = [this](const KFactors &kFactors) {
+        return compileRatingRules(RatingRules::fromKFactors(kFactors));
+    };
+    return KFactorFit::fit(matches, indices.size(), m_kFactors, m_kTable, kTable, threadCount);
+}
+
+template<typename Model>
+void Database::recomputeWith(bool store)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    compileRatingRules();
+    const QVector<Match> sortedMatches = this->sortedMatches();
 
     //
     // Re-build played_matches and ELO tables within these QVariantLists
@@ -347,22 +610,25 @@ void Database::recompute()
     QVariantList pm_players;
     QVariantList pm_matches;
 
+    QHash<int, int> matchCounts;
+
     const auto addPlayedMatch = [&](int p, int m) {
         const int id = pm_ids.size() + 1;
         pm_ids << id;
         pm_players << p;
         pm_matches << m;
+        matchCounts[p]++;
         return id;
     };
 
     //
     // Keep track of player ELOs
     //
-    QHash<int, EloRating> playersSingle;
-    QHash<int, EloRating> playersDouble;
-    QHash<int, EloRating> playersCombined;
-    using PlayerElo = QPair<int, EloRating>;
-    const auto getPlayerElo = [](const QHash<int, EloRating> &players, int id) {
+    QHash<int, Model> playersSingle;
+    QHash<int, Model> playersDouble;
+    QHash<int, Model> playersCombined;
+    using PlayerElo = QPair<int, Model>;
+    const auto getPlayerElo = [](const QHash<int, Model> &players, int id) {
         return qMakePair(id, players[id]);
     };
 
@@ -399,58 +665,220 @@ void Database::recompute()
     };
     QHash<int, QHash<int, PlayerVsPlayer>> playerVsPlayer;
 
-    const auto rateSingle = [&](int pid, int pmid, bool separate, float res, float k, const PlayerElo &other) {
-        QHash<int, EloRating> &players = separate ? playersSingle : playersCombined;
-        RatingDomain &domain = separate ? eloSeparate : eloCombined;
+    //
+    // keep track of everyone's rank, updated with every rating change
+    //
+    RankTracker ranksSingle;
+    RankTracker ranksDouble;
+    RankTracker ranksCombined;
 
-        const float oldRating = players[pid].abs();
-        players[pid].adjust(k, res, other.second);
-        const float newRating = players[pid].abs();
-        domain.add(pmid, oldRating, newRating - oldRating);
+    //
+    // keep track of double teams as a rating domain of their own
+    //
+    PairRatings pairs;
 
-        if (separate) {
-            playerVsPlayer[pid][other.first].singleDiff += newRating - oldRating;
-            playerVsPlayer[pid][other.first].singleStats.checkin(res);
-        }
+    //
+    // keep track of the ELO progression and rank of each player, with one entry per match day
+    //
+    struct ProgressionPoint {
+        qint16 year, month, day;
+        qint16 single, dbl, combined;
+        quint16 rankSingle, rankDouble, rankCombined;
+    };
+    QHash<int, QVector<ProgressionPoint>> progressions;
+
+    const auto addProgression = [&](int pid, const QDate &date) {
+        const ProgressionPoint point{
+            (qint16) date.year(), (qint16) date.month(), (qint16) date.day(),
+            (qint16) qRound(playersSingle.value(pid).abs()),
+            (qint16) qRound(playersDouble.value(pid).abs()),
+            (qint16) qRound(playersCombined.value(pid).abs()),
+            (quint16) qMin(ranksSingle.rank(pid), 0xffff),
+            (quint16) qMin(ranksDouble.rank(pid), 0xffff),
+            (quint16) qMin(ranksCombined.rank(pid), 0xffff)
+        };
+        QVector<ProgressionPoint> &points = progressions[pid];
+        if (!points.isEmpty() && points.last().year == point.year
+                && points.last().month == point.month && points.last().day == point.day)
+            points.last() = point;
         else
-            playerVsPlayer[pid][other.first].combinedDiff += newRating - oldRating;
+            points << point;
     };
 
-    const auto rateDouble = [&](int pid, int pmid, bool separate, float res, float k, const PlayerElo &partner, const PlayerElo &o1, const PlayerElo &o2) {
-        QHash<int, EloRating> &players = separate ? playersDouble : playersCombined;
-        RatingDomain &domain = separate ? eloSeparate : eloCombined;
+    //
+    // Rating changes go into the domain's rows, the ranks and the player-vs-player stats. A
+    // single match has one opponent in o1, a double also a partner and o2.
+    //
+    enum { Single, Double, Combined };
+    QHash<int, Model> *models[3] = { &playersSingle, &playersDouble, &playersCombined };
+    RankTracker *ranks[3] = { &ranksSingle, &ranksDouble, &ranksCombined };
+
+    struct Others {
+        bool isDouble;
+        int partner, o1, o2;
+    };
 
-        const float oldRating = players[pid].abs();
-        players[pid].adjust(k, partner.second, res, o1.second, o2.second);
-        const float newRating = players[pid].abs();
+    const auto addDiffs = [&](int pid, int d, const Others &others, float diff) {
+        QHash<int, PlayerVsPlayer> &pvp = playerVsPlayer[pid];
+        if (!others.isDouble)
+            (d == Combined ? pvp[others.o1].combinedDiff : pvp[others.o1].singleDiff) += diff;
+        else if (d == Double) {
+            pvp[others.partner].partnerDoubleDiff += diff;
+            pvp[others.o1].doubleDiff += diff;
+            pvp[others.o2].doubleDiff += diff;
+        } else {
+            pvp[others.partner].partnerCombinedDiff += diff;
+            pvp[others.o1].combinedDiff += diff;
+            pvp[others.o2].combinedDiff += diff;
+        }
+    };
+
+    // the day of the match being replayed
+    int matchDay = -1;
+    QDate matchDate;
+
+    //
+    // Models that batch rating periods only weigh a day's matches in adjust(). Their rows are
+    // filled in when the day is over, by splitting each player's change over their matches.
+    //
+    struct PeriodMatch {
+        int pid;
+        int domain;
+        int row;        // in eloSeparate or eloCombined
+        Others others;
+        float weight;
+    };
+    QVector<PeriodMatch> periodMatches;
+    QHash<QPair<int, int>, QPair<float, float>> periodShares;  // (domain, pid) -> rating so far, change per weight
+    QSet<int> periodPlayers;
+
+    const auto rated = [&](int pid, int pmid, int d, const Others &others, float oldRating, float weight) {
+        RatingDomain &domain = (d == Combined) ? eloCombined : eloSeparate;
+        if (Model::BATCHES_PERIODS) {
+            periodMatches << PeriodMatch{pid, d, domain.pmIds.size(), others, weight};
+            domain.add(pmid, oldRating, 0.0f);
+            periodPlayers << pid;
+            return;
+        }
+
+        const float newRating = (*models[d])[pid].abs();
         domain.add(pmid, oldRating, newRating - oldRating);
+        ranks[d]->update(pid, qRound(newRating));
+        addDiffs(pid, d, others, newRating - oldRating);
+    };
 
-        if (separate) {
-            playerVsPlayer[pid][partner.first].partnerDoubleDiff += newRating - oldRating;
-            playerVsPlayer[pid][o1.first].doubleDiff += newRating - oldRating;
-            playerVsPlayer[pid][o2.first].doubleDiff += newRating - oldRating;
+    const auto rateSingle = [&](int pid, int pmid, bool separate, float res, float k, const PlayerElo &other) {
+        const int d = separate ? Single : Combined;
+        Model &model = (*models[d])[pid];
+        const float oldRating = model.abs();
+        const float weight = model.adjust(k, res, other.second);
+        rated(pid, pmid, d, Others{false, 0, other.first, 0}, oldRating, weight);
 
-            playerVsPlayer[pid][partner.first].partnerStats.checkin(res);
+        if (separate)
+            playerVsPlayer[pid][other.first].singleStats.checkin(res);
+    };
 
+    const auto rateDouble = [&](int pid, int pmid, bool separate, float res, float k, const PlayerElo &partner, const PlayerElo &o1, const PlayerElo &o2) {
+        const int d = separate ? Double : Combined;
+        Model &model = (*models[d])[pid];
+        const float oldRating = model.abs();
+        const float weight = model.adjust(k, partner.second, res, o1.second, o2.second);
+        rated(pid, pmid, d, Others{true, partner.first, o1.first, o2.first}, oldRating, weight);
+
+        if (separate) {
+            playerVsPlayer[pid][partner.first].partnerStats.checkin(res);
             playerVsPlayer[pid][o1.first].doubleStats.checkin(res);
             playerVsPlayer[pid][o2.first].doubleStats.checkin(res);
-        } else {
-            playerVsPlayer[pid][partner.first].partnerCombinedDiff += newRating - oldRating;
-            playerVsPlayer[pid][o1.first].combinedDiff += newRating - oldRating;
-            playerVsPlayer[pid][o2.first].combinedDiff += newRating - oldRating;
         }
     };
 
+    const auto closePeriod = [&]() {
+        for (const PeriodMatch &m : periodMatches) {
+            const QPair<int, int> key(m.domain, m.pid);
+            if (!periodShares.contains(key)) {
+                Model &model = (*models[m.domain])[m.pid];
+                const float before = model.abs();
+                periodShares.insert(key, qMakePair(before, model.endPeriod()));
+            }
+        }
+
+        for (const PeriodMatch &m : periodMatches) {
+            QPair<float, float> &share = periodShares[qMakePair(m.domain, m.pid)];
+            const float change = share.second * m.weight;
+            RatingDomain &domain = (m.domain == Combined) ? eloCombined : eloSeparate;
+            domain.ratings[m.row] = (qint16) qRound(share.first);
+            domain.changes[m.row] = (qint16) qRound(change);
+            share.first += change;
+            addDiffs(m.pid, m.domain, m.others, change);
+        }
+
+        for (auto it = periodShares.cbegin(); it != periodShares.cend(); ++it)
+            ranks[it.key().first]->update(it.key().second, qRound((*models[it.key().first])[it.key().second].abs()));
+        for (int pid : periodPlayers)
+            addProgression(pid, matchDate);
+
+        periodMatches.clear();
+        periodShares.clear();
+        periodPlayers.clear();
+    };
+
+    //
+    // Weekly checkpoints of all ratings, so that the app can show past rankings
+    //
+    QVariantList checkpointDates;
+    QVariantList checkpointPlayedMatchIds;
+    QVariantList checkpointData;
+    QDate checkpointDate;
+
+    const auto addCheckpoint = [&]() {
+        QByteArray blob(matchCounts.size() * (sizeof(qint32) + 4 * sizeof(qint16)), Qt::Uninitialized);
+        uchar *dst = reinterpret_cast<uchar*>(blob.data());
+        for (auto it = matchCounts.cbegin(); it != matchCounts.cend(); ++it) {
+            qToLittleEndian<qint32>(it.key(), dst);
+            qToLittleEndian<qint16>(qRound(playersSingle.value(it.key()).abs()), dst + 4);
+            qToLittleEndian<qint16>(qRound(playersDouble.value(it.key()).abs()), dst + 6);
+            qToLittleEndian<qint16>(qRound(playersCombined.value(it.key()).abs()), dst + 8);
+            qToLittleEndian<quint16>(qMin(it.value(), 0xffff), dst + 10);
+            dst += 12;
+        }
+        checkpointDates << checkpointDate.year() * 10000 + checkpointDate.month() * 100 + checkpointDate.day();
+        checkpointPlayedMatchIds << pm_ids.size();
+        checkpointData << qCompress(blob);
+    };
+
     qWarning() << "Recomputing" << sortedMatches.size() << "matches";
 
     for (const Match &match : sortedMatches) {
+        // matches are sorted by date, so everything that depends on it only changes with the day
+        const int day = m_dayTable[match.competition];
+        if (day != matchDay) {
+            if (Model::BATCHES_PERIODS)
+                closePeriod();
+            matchDay = day;
+            matchDate = QDate::fromJulianDay(day);
+
+            // checkpoints are taken at the end of every week (sunday) that had matches
+            if (checkpointDate.isValid() && matchDate > checkpointDate)
+                addCheckpoint();
+            if (!checkpointDate.isValid() || matchDate > checkpointDate)
+                checkpointDate = matchDate.addDays(7 - matchDate.dayOfWeek());
+        }
+
         const float result = (match.score1 > match.score2) ? 0.0f :
                              (match.score1 < match.score2) ? 1.0f : 0.5f;
-        const bool isTournament = (m_competitions[match.competition].type == CompetitionType::Tournament);
-        const bool isMiniTournament = isTournament && m_competitions[match.competition].name.contains("Mini");
-        const bool isSingleSetGame = (qMax(match.score1, match.score2) >= 5);
-        const float ratingFactor = (isMiniTournament || isSingleSetGame) ? 0.5f : 1.0f;
-        const float k = ratingFactor * (isTournament ? m_kTournament : m_kLeague);
+        const float k = kFactor(match);
+
+        // a new rating period for everyone playing on a new day
+        for (int pid : { match.p1, match.p2 }) {
+            (match.type == MatchType::Single ? playersSingle : playersDouble)[pid].beginPeriod(day);
+            playersCombined[pid].beginPeriod(day);
+        }
+        if (match.type == MatchType::Double) {
+            for (int pid : { match.p11, match.p22 }) {
+                playersDouble[pid].beginPeriod(day);
+                playersCombined[pid].beginPeriod(day);
+            }
+        }
 
         if (match.type == MatchType::Single) {
             const int pm1id = addPlayedMatch(match.p1, match.id);
@@ -465,6 +893,9 @@ void Database::recompute()
             const PlayerElo c2 = getPlayerElo(playersCombined, match.p2);
             rateSingle(match.p1, pm1id, false, 1.0f - result, k, c2);
             rateSingle(match.p2, pm2id, false, result, k, c1);
+
+            addProgression(match.p1, matchDate);
+            addProgression(match.p2, matchDate);
         }
         else if (match.type == MatchType::Double) {
             const int pm1id  = addPlayedMatch(match.p1,  match.id);
@@ -489,9 +920,33 @@ void Database::recompute()
             rateDouble(match.p11, pm11id, false, 1.0f - result, k, c1,  c2, c22);
             rateDouble(match.p2,  pm2id,  false, result, k, c22, c1, c11);
             rateDouble(match.p22, pm22id, false, result, k, c2,  c1, c11);
+
+            // adding the second pair may grow the table, so look up the first one after it
+            pairs.pair(match.p2, match.p22);
+            PairRatings::Entry &pair1 = pairs.pair(match.p1, match.p11);
+            PairRatings::Entry &pair2 = pairs.pair(match.p2, match.p22);
+            const EloRating pair1Rating = pair1.rating;
+            pair1.rating.adjust(k, 1.0f - result, pair2.rating);
+            pair2.rating.adjust(k, result, pair1Rating);
+            pair1.checkin(1.0f - result);
+            pair2.checkin(result);
+
+            addProgression(match.p1, matchDate);
+            addProgression(match.p11, matchDate);
+            addProgression(match.p2, matchDate);
+            addProgression(match.p22, matchDate);
         }
     }
 
+    if (Model::BATCHES_PERIODS)
+        closePeriod();
+    if (checkpointDate.isValid())
+        addCheckpoint();
+
+    qWarning() << "Replayed" << sortedMatches.size() << "matches and" << pairs.size() << "pairs in" << timer.elapsed() << "msecs";
+    if (!store)
+        return;
+
     qWarning() << "Build PVP stats";
 
     //
@@ -508,6 +963,20 @@ void Database::recompute()
         playerCombinedElos << (qint16) qRound(playersCombined[it->id].abs());
     }
 
+    //
+    // Store pair ratings in separate table
+    //
+    QVariantList pairPlayer1s, pairPlayer2s, pairRatings;
+    QVariantList pairWins, pairDraws, pairLosses;
+    pairs.forEach([&](const PairRatings::Entry &e) {
+        pairPlayer1s << e.player1();
+        pairPlayer2s << e.player2();
+        pairRatings << (qint16) qRound(e.rating.abs());
+        pairWins << e.wins;
+        pairDraws << e.draws;
+        pairLosses << e.losses;
+    });
+
     //
     // Store player stats in separate table
     //
@@ -541,44 +1010,190 @@ void Database::recompute()
     }
 
     //
-    // Write new played_matches and ELO tables
+    // Pack ELO progressions into one blob per player
     //
+    QVariantList progressionIds;
+    QVariantList progressionData;
+    QVariantList rankProgressionData;
+    for (auto it = progressions.cbegin(); it != progressions.cend(); ++it) {
+        QByteArray blob(it->size() * 6 * sizeof(qint16), Qt::Uninitialized);
+        QByteArray rankBlob(it->size() * 3 * sizeof(quint16), Qt::Uninitialized);
+        qint16 *dst = reinterpret_cast<qint16*>(blob.data());
+        quint16 *rankDst = reinterpret_cast<quint16*>(rankBlob.data());
+        for (const ProgressionPoint &point : it.value()) {
+            *dst++ = qToLittleEndian(point.year);
+            *dst++ = qToLittleEndian(point.month);
+            *dst++ = qToLittleEndian(point.day);
+            *dst++ = qToLittleEndian(point.single);
+            *dst++ = qToLittleEndian(point.dbl);
+            *dst++ = qToLittleEndian(point.combined);
+            *rankDst++ = qToLittleEndian(point.rankSingle);
+            *rankDst++ = qToLittleEndian(point.rankDouble);
+            *rankDst++ = qToLittleEndian(point.rankCombined);
+        }
+        progressionIds << it.key();
+        progressionData << blob;
+        rankProgressionData << rankBlob;
+    }
+
+    //
+    // Build the snapshot for the app from the same data
+    //
+    SnapshotWriter snapshot;
+    {
+        // ratings before each played match and their changes, indexed by played match id - 1
+        const int pmCount = pm_ids.size();
+        QVector<qint16> separateRatings(pmCount), separateChanges(pmCount);
+        QVector<qint16> combinedRatings(pmCount), combinedChanges(pmCount);
+        for (int i = 0; i < eloSeparate.pmIds.size(); ++i) {
+            const int idx = eloSeparate.pmIds[i].toInt() - 1;
+            separateRatings[idx] = eloSeparate.ratings[i].toInt();
+            separateChanges[idx] = eloSeparate.changes[i].toInt();
+        }
+        for (int i = 0; i < eloCombined.pmIds.size(); ++i) {
+            const int idx = eloCombined.pmIds[i].toInt() - 1;
+            combinedRatings[idx] = eloCombined.ratings[i].toInt();
+            combinedChanges[idx] = eloCombined.changes[i].toInt();
+        }
+
+        QHash<int, quint32> competitionIndices;
+        for (auto it = m_competitions.cbegin(); it != m_competitions.cend(); ++it) {
+            const QDate date = it->dateTime.date();
+            Snapshot::Competition competition = {};
+            competition.name = snapshot.addString(it->name);
+            competition.year = date.year();
+            competition.month = date.month();
+            competition.day = date.day();
+            competition.type = (qint8) it->type;
+            competitionIndices[it.key()] = snapshot.competitions.size();
+            snapshot.competitions << competition;
+        }
+
+        QHash<int, quint32> matchIndices;
+        for (const Match &match : sortedMatches) {
+            Snapshot::Match m = {};
+            m.competition = competitionIndices.value(match.competition);
+            m.type = (qint8) match.type;
+            m.score1 = match.score1;
+            m.score2 = match.score2;
+            m.players[0] = match.p1;
+            m.players[1] = match.p2;
+            m.players[2] = match.p11;
+            m.players[3] = match.p22;
+            matchIndices[match.id] = snapshot.matches.size();
+            snapshot.matches << m;
+        }
+
+        QHash<int, QVector<Snapshot::PlayedMatch>> playedMatches;
+        for (int i = 0; i < pmCount; ++i) {
+            const int playerId = pm_players[i].toInt();
+            const quint32 matchIdx = matchIndices.value(pm_matches[i].toInt());
+            Snapshot::Match &m = snapshot.matches[matchIdx];
+            for (int slot = 0; slot < 4; ++slot) {
+                if (m.players[slot] == playerId) {
+                    m.eloSeparate[slot] = separateRatings[i];
+                    m.eloCombined[slot] = combinedRatings[i];
+                }
+            }
+            playedMatches[playerId] << Snapshot::PlayedMatch{matchIdx, separateChanges[i], combinedChanges[i]};
+        }
+
+        QList<int> sortedPlayerIds = m_players.keys();
+        std::sort(sortedPlayerIds.begin(), sortedPlayerIds.end());
+        for (int playerId : sortedPlayerIds) {
+            const Player &player = m_players[playerId];
+
+            Snapshot::Player p = {};
+            p.id = playerId;
+            p.firstName = snapshot.addString(player.firstName);
+            p.lastName = snapshot.addString(player.lastName);
+            p.eloSingle = qRound(playersSingle[playerId].abs());
+            p.eloDouble = qRound(playersDouble[playerId].abs());
+            p.eloCombined = qRound(playersCombined[playerId].abs());
+
+            p.progressionBegin = snapshot.progression.size();
+            for (const ProgressionPoint &point : progressions.value(playerId)) {
+                snapshot.progression << Snapshot::ProgressionPoint{
+                    point.year, point.month, point.day, point.single, point.dbl, point.combined,
+                    point.rankSingle, point.rankDouble, point.rankCombined
+                };
+            }
+            p.progressionCount = snapshot.progression.size() - p.progressionBegin;
+
+            p.pvpBegin = snapshot.playerVsPlayer.size();
+            const QHash<int, PlayerVsPlayer> pvp = playerVsPlayer.value(playerId);
+            for (auto it = pvp.cbegin(); it != pvp.cend(); ++it) {
+                snapshot.playerVsPlayer << Snapshot::PlayerVsPlayer{
+                    it.key(),
+                    it->singleStats.wins, it->singleStats.draws, it->singleStats.losses,
+                    it->doubleStats.wins, it->doubleStats.draws, it->doubleStats.losses,
+                    it->partnerStats.wins, it->partnerStats.draws, it->partnerStats.losses,
+                    (qint16) it->combinedDiff, (qint16) it->doubleDiff, (qint16) it->singleDiff,
+                    (qint16) it->partnerCombinedDiff, (qint16) it->partnerDoubleDiff
+                };
+            }
+            p.pvpCount = snapshot.playerVsPlayer.size() - p.pvpBegin;
+
+            // newest first, like the app pages through them
+            p.playedBegin = snapshot.playedMatches.size();
+            const QVector<Snapshot::PlayedMatch> played = playedMatches.value(playerId);
+            for (auto it = played.crbegin(); it != played.crend(); ++it) {
+                if (snapshot.matches[it->match].type == (qint8) MatchType::Single)
+                    p.singleCount++;
+                else
+                    p.doubleCount++;
+                snapshot.playedMatches << *it;
+            }
+            p.playedCount = snapshot.playedMatches.size() - p.playedBegin;
+
+            snapshot.players << p;
+        }
+    }
+    const QByteArray snapshotData = snapshot.serialize();
+
+    //
+    // Save the snapshot first: until the transaction below commits, its checksum doesn't match the
+    // one in sqlite, so the app keeps reading the old ratings from sqlite instead of mixing them
+    //
+    const bool snapshotSaved = SnapshotWriter::save(Snapshot::pathFor(m_db.databaseName()), snapshotData);
+
+    //
+    // Write new played_matches and ELO tables, and the snapshot checksum, in one transaction
+    //
+    m_db.transaction();
     execQuery("DELETE FROM played_matches");
     execQuery("DELETE FROM elo_separate");
     execQuery("DELETE FROM elo_combined");
     execQuery("DELETE FROM elo_current");
+    execQuery("DELETE FROM elo_pairs");
     execQuery("DELETE FROM player_vs_player_stats");
+    execQuery("DELETE FROM player_progression");
+    execQuery("DELETE FROM player_rank_progression");
+    execQuery("DELETE FROM rating_checkpoints");
 
     QSqlQuery query;
 
-    m_db.transaction();
     query.prepare("INSERT INTO played_matches (id, player_id, match_id) VALUES (?, ?, ?)");
     query.addBindValue(pm_ids);
     query.addBindValue(pm_players);
     query.addBindValue(pm_matches);
     query.execBatch();
     checkQueryStatus(query);
-    m_db.commit();
 
-    m_db.transaction();
     query.prepare("INSERT INTO elo_separate (played_match_id, rating, change) VALUES (?, ?, ?)");
     query.addBindValue(eloSeparate.pmIds);
     query.addBindValue(eloSeparate.ratings);
     query.addBindValue(eloSeparate.changes);
     query.execBatch();
     checkQueryStatus(query);
-    m_db.commit();
 
-    m_db.transaction();
     query.prepare("INSERT INTO elo_combined (played_match_id, rating, change) VALUES (?, ?, ?)");
     query.addBindValue(eloCombined.pmIds);
     query.addBindValue(eloCombined.ratings);
     query.addBindValue(eloCombined.changes);
     query.execBatch();
     checkQueryStatus(query);
-    m_db.commit();
 
-    m_db.transaction();
     query.prepare("INSERT INTO elo_current (player_id, single, double, combined) VALUES (?, ?, ?, ?)");
     query.addBindValue(playerIds);
     query.addBindValue(playerSingleElos);
@@ -586,9 +1201,17 @@ void Database::recompute()
     query.addBindValue(playerCombinedElos);
     query.execBatch();
     checkQueryStatus(query);
-    m_db.commit();
 
-    m_db.transaction();
+    query.prepare("INSERT INTO elo_pairs (player1_id, player2_id, rating, wins, draws, losses) VALUES (?, ?, ?, ?, ?, ?)");
+    query.addBindValue(pairPlayer1s);
+    query.addBindValue(pairPlayer2s);
+    query.addBindValue(pairRatings);
+    query.addBindValue(pairWins);
+    query.addBindValue(pairDraws);
+    query.addBindValue(pairLosses);
+    query.execBatch();
+    checkQueryStatus(query);
+
     query.prepare(
         "INSERT INTO player_vs_player_stats ( "
         "   player_id, other_id, "
@@ -616,5 +1239,58 @@ void Database::recompute()
     query.addBindValue(pvpPartnerDoubleDelta);
     query.execBatch();
     checkQueryStatus(query);
+
+    query.prepare("INSERT INTO player_progression (player_id, data) VALUES (?, ?)");
+    query.addBindValue(progressionIds);
+    query.addBindValue(progressionData);
+    query.execBatch();
+    checkQueryStatus(query);
+
+    query.prepare("INSERT INTO player_rank_progression (player_id, data) VALUES (?, ?)");
+    query.addBindValue(progressionIds);
+    query.addBindValue(rankProgressionData);
+    query.execBatch();
+    checkQueryStatus(query);
+
+    query.prepare("INSERT INTO rating_checkpoints (date, last_played_match_id, data) VALUES (?, ?, ?)");
+    query.addBindValue(checkpointDates);
+    query.addBindValue(checkpointPlayedMatchIds);
+    query.addBindValue(checkpointData);
+    query.execBatch();
+    checkQueryStatus(query);
+
+    // the app only uses the snapshot if its checksum matches the one stored here
+    execQuery("DELETE FROM snapshot_info");
+    if (snapshotSaved) {
+        query.prepare("INSERT INTO snapshot_info (checksum) VALUES (?)");
+        query.addBindValue((qint64) snapshot.checksum());
+        query.exec();
+        checkQueryStatus(query);
+    }
     m_db.commit();
+
+    qWarning() << "Recomputed in" << timer.elapsed() << "msecs";
+}
+
+void Database::recompute()
+{
+    recomputeWith<RatingModel>(true);
+}
+
+void Database::benchmarkRatingModels(int repetitions)
+{
+    const int matchCount = m_matches.size();
+
+    const auto run = [&](const char *name, void (Database::*replay)(bool)) {
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repetitions; ++i)
+            (this->*replay)(false);
+        const qint64 nsecs = qMax<qint64>(timer.nsecsElapsed(), 1);
+        qWarning().nospace() << name << ": " << matchCount * repetitions << " matches in " << nsecs / 1000000 << " msecs, "
+                             << qint64(double(matchCount) * repetitions * 1e9 / nsecs) << " matches/sec";
+    };
+
+    run("EloRating", &Database::recomputeWith<EloRating>);
+    run("Glicko2Rating", &Database::recomputeWith<Glicko2Rating>);
 }
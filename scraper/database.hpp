@@ -3,10 +3,14 @@
 #include <QString>
 #include <QDateTime>
 #include <QHash>
+#include <QVector>
 
 #include <QSqlDatabase>
 #include <QSqlQuery>
 
+#include "rating.hpp"
+#include "ratingrules.hpp"
+
 enum class CompetitionType {
     Invalid = 0,
     League = 1,
@@ -23,7 +27,8 @@ enum class MatchType {
 class Database
 {
 public:
-    Database(const QString &sqlitePath, float kLeague, float kTournament);
+    // rules decide the k-factors of recompute(), kFactors are where fitKFactors() starts
+    Database(const QString &sqlitePath, const KFactors &kFactors, const RatingRules &rules);
     ~Database();
 
     int addCompetition(int tfvbId, CompetitionType type, const QString &name, QDateTime dt);
@@ -35,6 +40,32 @@ public:
 
     void recompute();
 
+    // batch fit of the Bradley-Terry model to all matches into the bradley_terry table, with
+    // match weights halving every halfLifeDays before the last match
+    void fitBradleyTerry(float halfLifeDays, int threadCount);
+
+    // k-factors that predict the matches best, see kfactorfit.hpp; starts from the current ones
+    KFactors fitKFactors(int threadCount);
+
+    // runs the replay of recompute() with every rating model, without writing, and prints their throughput
+    void benchmarkRatingModels(int repetitions);
+
+    // ratings in elo_current, as of the last recompute()
+    struct CurrentRating {
+        float single, dbl, combined;
+    };
+    QHash<int, CurrentRating> currentRatings();
+
+    // what is known about a scraped league game; games that haven't been played yet have no matches
+    struct LeagueGameResult {
+        QString name;                       // "<home> vs. <away>"
+        int matchCount = 0;
+        int homeWins = 0, awayWins = 0;     // draws count for neither team
+        QVector<int> homePlayers, awayPlayers;
+    };
+    // the given league games that have been scraped, keyed by tfvb id
+    QHash<int, LeagueGameResult> leagueGameResults(const QVector<int> &tfvbIds) const;
+
 private:
     void execQuery(const QString &query);
 
@@ -42,8 +73,12 @@ private:
     void createQueries();
     void readData();
 
-    const float m_kLeague;
-    const float m_kTournament;
+    const KFactors m_kFactors;
+    const RatingRules m_rules;
+    // k-factor of every competition's two-set and single-set matches, by competition id * 2 + single-set
+    QVector<float> m_kTable;
+    // Julian day of every competition, by competition id
+    QVector<int> m_dayTable;
     bool m_debugSpam = false;
 
     QSqlDatabase m_db;
@@ -91,6 +126,20 @@ private:
     QHash<int, Match> m_matches;
     int m_nextMatchId = 1;
 
+    QVector<Match> sortedMatches() const;
+
+    // recompute() with Model; without store only the replay runs, for benchmarkRatingModels()
+    template<typename Model>
+    void recomputeWith(bool store);
+
+    // m_kTable of m_rules and m_dayTable, or a k-factor table like it of other rules
+    void compileRatingRules();
+    QVector<float> compileRatingRules(const RatingRules &rules) const;
+    float kFactor(const Match &match) const
+    {
+        return m_kTable[match.competition * 2 + (RatingRules::isSingleSet(match.score1, match.score2) ? 1 : 0)];
+    }
+
     void recomputeElo(
             const QVector<Match> &sortedMatches,
             const QString &table,
@@ -47,6 +47,8 @@ void Downloader::onReplyFinished()
 
     if (reply->error() != QNetworkReply::NoError) {
         qWarning() << reply->url() << reply->error() << reply->errorString();
+        // still emits completed() if this was the last download
+        QTimer::singleShot(0, this, &Downloader::maybeStartDownloads);
         return;
     }
 
@@ -0,0 +1,179 @@
+#include "kfactorfit.hpp"
+
+#include <QDebug>
+
+#include <atomic>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+namespace KFactorFit {
+
+static const int MAX_ROUNDS = 60;
+static const float MIN_STEP = 0.01f;    // relative
+
+static double logLoss(float p, float result)
+{
+    const double q = qBound(1e-6, double(p), 1.0 - 1e-6);
+    return -(result * std::log(q) + (1.0 - result) * std::log(1.0 - q));
+}
+
+double evaluate(const QVector<Match> &matches, int playerCount, const QVector<float> &kTable, int begin, int end)
+{
+    QVector<float> ratings[2] = { QVector<float>(playerCount, 1000.0f), QVector<float>(playerCount, 1000.0f) };
+
+    double loss = 0.0;
+    for (int i = 0; i < end; ++i) {
+        const Match &m = matches[i];
+        float *r = ratings[m.isDouble ? 1 : 0].data();
+
+        // the same expectation as EloRating::adjust() gives every player of a team
+        const float r1 = m.isDouble ? EloRating::teamRating(r[m.players[0]], r[m.players[1]]) : r[m.players[0]];
+        const float r2 = m.isDouble ? EloRating::teamRating(r[m.players[2]], r[m.players[3]]) : r[m.players[2]];
+        const float p = EloRating::expectedResult(r1, r2);
+
+        if (i >= begin)
+            loss += logLoss(p, m.result);
+
+        const float change = kTable[m.kIndex] * (m.result - p);
+        r[m.players[0]] += change;
+        r[m.players[2]] -= change;
+        if (m.isDouble) {
+            r[m.players[1]] += change;
+            r[m.players[3]] -= change;
+        }
+    }
+
+    return loss / qMax(end - begin, 1);
+}
+
+static QDebug operator<<(QDebug debug, const KFactors &k)
+{
+    QDebugStateSaver saver(debug);
+    debug.nospace() << "--kleague " << k.league << " --ktournament " << k.tournament
+                    << " --kmini " << k.miniChallenger << " --ksingleset " << k.singleSet;
+    return debug;
+}
+
+// coordinate search from start for the k-factors with the lowest log-loss on the matches in [begin, end)
+static KFactors search(const QVector<Match> &matches, int playerCount, const KFactors &start, const QVector<float> &startTable,
+                       const KTableFunction &kTable, int begin, int end, int threadCount)
+{
+    // the parameters as an array, so that the search can step through them
+    const auto get = [](const KFactors &k, int i) {
+        return (i == 0) ? k.league : (i == 1) ? k.tournament : (i == 2) ? k.miniChallenger : k.singleSet;
+    };
+    const auto set = [](KFactors &k, int i, float value) {
+        (i == 0 ? k.league : i == 1 ? k.tournament : i == 2 ? k.miniChallenger : k.singleSet) = value;
+    };
+    const int paramCount = 4;
+
+    KFactors best = start;
+    double bestScore = evaluate(matches, playerCount, startTable, begin, end);
+
+    float step = 0.5f;
+    for (int round = 1; round <= MAX_ROUNDS && step >= MIN_STEP; ++round) {
+        //
+        // Both neighbors in every coordinate, evaluated in parallel
+        //
+        QVector<KFactors> candidates;
+        QVector<QVector<float>> tables;
+        for (int i = 0; i < paramCount; ++i) {
+            for (float direction : { 1.0f + step, 1.0f / (1.0f + step) }) {
+                KFactors k = best;
+                set(k, i, get(best, i) * direction);
+                // factors only make matches count less
+                if (i >= 2 && get(k, i) > 1.0f)
+                    continue;
+                candidates << k;
+                tables << kTable(k);
+            }
+        }
+
+        QVector<double> scores(candidates.size());
+        double *scoreData = scores.data();
+        std::atomic<int> next(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < qMin(qMax(threadCount, 1), candidates.size()); ++t) {
+            threads.emplace_back([&]() {
+                for (int c = next++; c < candidates.size(); c = next++)
+                    scoreData[c] = evaluate(matches, playerCount, tables.at(c), begin, end);
+            });
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+
+        // ties go to the earlier candidate, so the search doesn't depend on timing
+        int bestCandidate = -1;
+        for (int c = 0; c < candidates.size(); ++c) {
+            if (scores[c] < bestScore) {
+                bestScore = scores[c];
+                bestCandidate = c;
+            }
+        }
+
+        if (bestCandidate >= 0)
+            best = candidates[bestCandidate];
+        else
+            step /= 2.0f;
+    }
+
+    return best;
+}
+
+KFactors fit(const QVector<Match> &matches, int playerCount, const KFactors &start, const QVector<float> &startTable,
+             const KTableFunction &kTable, int threadCount)
+{
+    //
+    // Index of the first match of every year
+    //
+    QVector<int> yearBegins;
+    for (int i = 0; i < matches.size(); ++i) {
+        if (i == 0 || matches[i].year != matches[i - 1].year)
+            yearBegins << i;
+    }
+    yearBegins << matches.size();
+    const int yearCount = yearBegins.size() - 1;
+
+    if (yearCount <= BURN_IN_YEARS) {
+        qWarning() << "Not enough years of matches to fit the k-factors:" << qMax(yearCount, 0);
+        return start;
+    }
+    const int trainBegin = yearBegins[BURN_IN_YEARS];
+
+    const double startScore = evaluate(matches, playerCount, startTable, trainBegin, matches.size());
+    qWarning() << "Start:" << start << "log-loss" << startScore;
+
+    //
+    // Rolling-origin folds: fit up to the end of year N, score year N + 1
+    //
+    double heldOut = 0.0;
+    int foldCount = 0;
+    KFactors foldStart = start;
+    QVector<float> foldTable = startTable;
+    for (int y = BURN_IN_YEARS; y + 1 < yearCount; ++y) {
+        const int testBegin = yearBegins[y + 1];
+        const int testEnd = yearBegins[y + 2];
+
+        // the previous fold's result is close, so the search doesn't start over
+        foldStart = search(matches, playerCount, foldStart, foldTable, kTable, trainBegin, testBegin, threadCount);
+        foldTable = kTable(foldStart);
+        const double trainScore = evaluate(matches, playerCount, foldTable, trainBegin, testBegin);
+        const double testScore = evaluate(matches, playerCount, foldTable, testBegin, testEnd);
+        heldOut += testScore;
+        foldCount++;
+
+        qWarning() << "Fold up to" << matches[testBegin - 1].year << ":" << foldStart
+                   << "train log-loss" << trainScore << "log-loss on" << matches[testBegin].year << testScore;
+    }
+
+    const KFactors best = search(matches, playerCount, foldStart, foldTable, kTable, trainBegin, matches.size(), threadCount);
+    const double bestScore = evaluate(matches, playerCount, kTable(best), trainBegin, matches.size());
+    if (foldCount > 0)
+        qWarning() << "Best:" << best << "log-loss" << bestScore << "held-out log-loss over" << foldCount << "folds" << heldOut / foldCount;
+    else
+        qWarning() << "Best:" << best << "log-loss" << bestScore << "no folds, only one year after the burn-in";
+    return best;
+}
+
+} // namespace KFactorFit
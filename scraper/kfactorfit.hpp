@@ -0,0 +1,46 @@
+#pragma once
+
+#include "rating.hpp"
+
+#include <QVector>
+
+#include <functional>
+
+/*
+ * Fitting of the k-factors to the match history.
+ *
+ * A configuration is scored by replaying the matches in order with separate single and double
+ * ELO ratings, like recompute(), and averaging the log-loss of each match's prediction made
+ * before it was rated. Every prediction only uses earlier matches, and the matches of the first
+ * BURN_IN_YEARS only settle the ratings.
+ *
+ * The held-out score uses rolling-origin folds: for every year N after the burn-in, the k-factors
+ * are fitted to the matches up to the end of N and then score the matches of N + 1. The average
+ * over the folds is what the fitted k-factors can be expected to do on a year they haven't seen.
+ * The returned k-factors are fitted to all matches.
+ */
+namespace KFactorFit {
+
+static const int BURN_IN_YEARS = 2;
+
+struct Match
+{
+    int players[4];     // dense player indices, p1 p11 p2 p22; p11 and p22 unused in singles
+    bool isDouble;
+    int kIndex;         // into the k-factor tables, see Database::m_kTable
+    float result;       // for team 1: 1 won, 0.5 draw, 0 lost
+    int year;
+};
+
+// mean log-loss of the matches in [begin, end), replaying them and all before; the matches are in
+// chronological order, with player indices below playerCount
+double evaluate(const QVector<Match> &matches, int playerCount, const QVector<float> &kTable, int begin, int end);
+
+// k-factor table of the rules made from k-factors
+using KTableFunction = std::function<QVector<float>(const KFactors&)>;
+
+// coordinate search from start, whose table is startTable, evaluating the candidates of each round in parallel
+KFactors fit(const QVector<Match> &matches, int playerCount, const KFactors &start, const QVector<float> &startTable,
+             const KTableFunction &kTable, int threadCount);
+
+} // namespace KFactorFit
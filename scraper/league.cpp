@@ -5,7 +5,7 @@
 
 using namespace ScrapeUtil;
 
-QVector<LeagueGame> scrapeLeagueSeason(GumboOutput *output)
+QVector<LeagueGame> scrapeLeagueSeason(GumboOutput *output, bool includeLive)
 {
     QVector<LeagueGame> ret;
     QVector<int> doneIds;
@@ -32,17 +32,18 @@ QVector<LeagueGame> scrapeLeagueSeason(GumboOutput *output)
             if (doneIds.contains(id))
                 continue;
 
-            ret << LeagueGame{href, id};
+            ret << LeagueGame{href, id, false};
             doneIds << id;
         }
     }
     
     for (auto it = ret.begin(); it != ret.end(); /*empty*/) {
-        if (liveGameIds.contains(it->tfvbId))
+        it->live = liveGameIds.contains(it->tfvbId);
+        if (it->live && !includeLive)
             it = ret.erase(it);
         else
             ++it;
-    }   
+    }
 
     return ret;
 }
@@ -51,25 +52,9 @@ bool scrapeLeageGame(Database *db, int tfvbId, GumboOutput *output)
 {
     #define CHECK(condition, message) if (!(condition)) { qWarning() << "League game" << tfvbId << ":" << message; continue; }
 
-    QString competitionName;
+    const QString competitionName = scrapeLeagueGameName(output);
     QDateTime competitionDateTime;
 
-    //
-    // check for a header element that contains the match name
-    //
-    const auto isPotentialHeader = [](GumboElement *elem) {
-        return elem->tag == GUMBO_TAG_TH
-                && attributeValue(elem, "class") == "sectiontableheader"
-                && attributeValue(elem, "align") == "left";
-    };
-    for (GumboElement *elem : collectElements(output->root, isPotentialHeader)) {
-        const QStringList texts = collectTexts(elem);
-        // its all garbled ffs
-        if (!texts.isEmpty() && texts.last().contains("vs.")) {
-            competitionName = texts.last().mid(2).trimmed().replace("vs.", " vs. ");
-        }
-    }
-
     //
     // check for match date
     //
@@ -180,3 +165,37 @@ bool scrapeLeageGame(Database *db, int tfvbId, GumboOutput *output)
     
     return addedGames;
 }
+
+QString scrapeLeagueGameName(GumboOutput *output)
+{
+    QString ret;
+
+    //
+    // check for a header element that contains the match name
+    //
+    const auto isPotentialHeader = [](GumboElement *elem) {
+        return elem->tag == GUMBO_TAG_TH
+                && attributeValue(elem, "class") == "sectiontableheader"
+                && attributeValue(elem, "align") == "left";
+    };
+    for (GumboElement *elem : collectElements(output->root, isPotentialHeader)) {
+        const QStringList texts = collectTexts(elem);
+        // its all garbled ffs
+        if (!texts.isEmpty() && texts.last().contains("vs.")) {
+            ret = texts.last().mid(2).trimmed().replace("vs.", " vs. ");
+        }
+    }
+
+    return ret;
+}
+
+bool splitLeagueGameName(const QString &name, QString &home, QString &away)
+{
+    const int pos = name.indexOf("vs.");
+    if (pos < 0)
+        return false;
+
+    home = name.left(pos).simplified();
+    away = name.mid(pos + 3).simplified();
+    return !home.isEmpty() && !away.isEmpty();
+}
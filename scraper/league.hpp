@@ -7,7 +7,14 @@ struct LeagueGame
 {
     QString url;
     int tfvbId;
+    bool live;      // being played right now
 };
-QVector<LeagueGame> scrapeLeagueSeason(GumboOutput *output);
+// all games of a league season page; live games are only included if includeLive is set
+QVector<LeagueGame> scrapeLeagueSeason(GumboOutput *output, bool includeLive = false);
 
 bool scrapeLeageGame(Database *db, int tfvbId, GumboOutput *output);
+
+// the competition name of a league game page, "<home> vs. <away>"
+QString scrapeLeagueGameName(GumboOutput *output);
+// splits a league game's competition name into the team names
+bool splitLeagueGameName(const QString &name, QString &home, QString &away);
@@ -2,12 +2,15 @@
 #include <QCommandLineParser>
 #include <QNetworkCookie>
 #include <QFile>
+#include <QThread>
 #include <QDebug>
 
 #include "downloader.hpp"
 #include "database.hpp"
 #include "league.hpp"
 #include "tournament.hpp"
+#include "predict.hpp"
+#include "simulator.hpp"
 
 static QString prepend(const QString &str, const QString &prefix)
 {
@@ -66,27 +69,167 @@ int main(int argc, char **argv)
     parser.addOption(tournamentSeasonOption);
     QCommandLineOption tournamentSourceOption({"tournament-source", "s"}, "What website to query tournaments from (dtfb, tfvb)", "source", "tfvb");
     parser.addOption(tournamentSourceOption);
-    QCommandLineOption kLeagueOption(QStringList{"kleague"}, "k-factor used for 2-set league games (1-set games count half)", "k", "18");
+    QCommandLineOption kLeagueOption(QStringList{"kleague"}, "k-factor used for 2-set league games", "k", "18");
     parser.addOption(kLeagueOption);
-    QCommandLineOption kTournamentOption(QStringList{"ktournament"}, "k-factor used for tournament games (mini-challengers count half)", "k", "24");
+    QCommandLineOption kTournamentOption(QStringList{"ktournament"}, "k-factor used for tournament games", "k", "24");
     parser.addOption(kTournamentOption);
+    QCommandLineOption kMiniOption(QStringList{"kmini"}, "Factor of the k-factor for mini-challenger games", "factor", "0.5");
+    parser.addOption(kMiniOption);
+    QCommandLineOption kSingleSetOption(QStringList{"ksingleset"}, "Factor of the k-factor for 1-set games", "factor", "0.5");
+    parser.addOption(kSingleSetOption);
+    QCommandLineOption rulesOption(QStringList{"rules"}, "Rating rules (ini) that replace the k-factor options above, see ratingrules.hpp", "path");
+    parser.addOption(rulesOption);
+    QCommandLineOption fitKFactorsOption(QStringList{"fit-kfactors"}, "Fit the k-factors to the stored matches, print the best ones and exit");
+    parser.addOption(fitKFactorsOption);
     QCommandLineOption forceRecompute(QStringList{{"recompute", "r"}}, "Force recomputation of ELO");
     parser.addOption(forceRecompute);
+    QCommandLineOption bradleyTerryOption(QStringList{"bradley-terry"}, "Fit Bradley-Terry ratings to all matches after scraping, weighted by a half-life in days", "days", "730");
+    parser.addOption(bradleyTerryOption);
+    QCommandLineOption benchmarkRatingsOption(QStringList{"benchmark-ratings"}, "Replay all matches through every rating model and print their throughput", "repetitions");
+    parser.addOption(benchmarkRatingsOption);
+    QCommandLineOption predictOption(QStringList{"predict"}, "Print expected results for the lineups in a file (- for stdin) and exit", "path");
+    parser.addOption(predictOption);
+    QCommandLineOption predictRatingsOption(QStringList{"predict-ratings"}, "Ratings used by --predict (separate, combined)", "ratings", "separate");
+    parser.addOption(predictRatingsOption);
+    QCommandLineOption simulateOption(QStringList{"simulate"}, "Print title, promotion and relegation odds for the league season at a URL and exit", "url");
+    parser.addOption(simulateOption);
+    QCommandLineOption promotedOption(QStringList{"promoted"}, "Number of promotion spots for --simulate", "n", "1");
+    parser.addOption(promotedOption);
+    QCommandLineOption relegatedOption(QStringList{"relegated"}, "Number of relegation spots for --simulate", "n", "2");
+    parser.addOption(relegatedOption);
+    QCommandLineOption simulationsOption(QStringList{"simulations"}, "Number of simulated seasons for --simulate", "n", "1000000");
+    parser.addOption(simulationsOption);
+    QCommandLineOption seedOption(QStringList{"seed"}, "Random seed for --simulate", "seed", "1");
+    parser.addOption(seedOption);
 
     parser.process(app);
     if (parser.positionalArguments().isEmpty())
         parser.showHelp();
 
-    float kl, kt;
-    if (!readFloatValue(parser, kLeagueOption, kl) || !readFloatValue(parser, kTournamentOption, kt))
+    KFactors kFactors;
+    if (!readFloatValue(parser, kLeagueOption, kFactors.league) || !readFloatValue(parser, kTournamentOption, kFactors.tournament)
+            || !readFloatValue(parser, kMiniOption, kFactors.miniChallenger) || !readFloatValue(parser, kSingleSetOption, kFactors.singleSet))
         return 1;
-    qDebug() << "kLeague =" << kl;
-    qDebug() << "kTournament =" << kt;
+    qDebug() << "kLeague =" << kFactors.league;
+    qDebug() << "kTournament =" << kFactors.tournament;
+    qDebug() << "kMini =" << kFactors.miniChallenger;
+    qDebug() << "kSingleSet =" << kFactors.singleSet;
 
     const QString sqlitePath = parser.positionalArguments().first();
 
+    float halfLife;
+    const bool fitBradleyTerry = parser.isSet(bradleyTerryOption);
+    if (!readFloatValue(parser, bradleyTerryOption, halfLife))
+        return 1;
+    if (halfLife <= 0.0f) {
+        qCritical() << "The Bradley-Terry half-life must be positive";
+        return 1;
+    }
+
+    RatingRules rules = RatingRules::fromKFactors(kFactors);
+    if (parser.isSet(rulesOption) && !RatingRules::read(parser.value(rulesOption), rules))
+        return 1;
+    if (parser.isSet(rulesOption) && parser.isSet(fitKFactorsOption)) {
+        qCritical() << "The k-factors only make the built-in rules, --fit-kfactors can't be used with --rules";
+        return 1;
+    }
+
+    Database *database = new Database(sqlitePath, kFactors, rules);
+
+    if (parser.isSet(fitKFactorsOption)) {
+        database->fitKFactors(QThread::idealThreadCount());
+        return 0;
+    }
+
+    if (parser.isSet(benchmarkRatingsOption)) {
+        bool ok;
+        const int repetitions = parser.value(benchmarkRatingsOption).toInt(&ok);
+        if (!ok || repetitions <= 0) {
+            qCritical() << "Not a valid value for benchmark-ratings";
+            return 1;
+        }
+        database->benchmarkRatingModels(repetitions);
+        return 0;
+    }
+
+    //
+    // Predict lineups instead of scraping
+    //
+    if (parser.isSet(predictOption)) {
+        const QString ratings = parser.value(predictRatingsOption);
+        if (ratings != "separate" && ratings != "combined") {
+            qCritical() << "Prediction ratings must be set to 'separate' or 'combined'.";
+            return 1;
+        }
+        return predictLineupFile(database, parser.value(predictOption),
+                                 (ratings == "combined") ? PredictionRatings::Combined : PredictionRatings::Separate);
+    }
+
     Downloader *downloader = new Downloader();
-    Database *database = new Database(sqlitePath, kl, kt);
+
+    //
+    // Simulate the rest of a league season instead of scraping. The season page lists its
+    // games, and those the database doesn't know yet are downloaded for their team names.
+    //
+    if (parser.isSet(simulateOption)) {
+        bool simulationsOk, seedOk, promotedOk, relegatedOk;
+        const int simulations = parser.value(simulationsOption).toInt(&simulationsOk);
+        const quint64 seed = parser.value(seedOption).toULongLong(&seedOk);
+        const int promoted = parser.value(promotedOption).toInt(&promotedOk);
+        const int relegated = parser.value(relegatedOption).toInt(&relegatedOk);
+        if (!simulationsOk || simulations <= 0 || !seedOk) {
+            qCritical() << "Not a valid value for" << (seedOk ? "simulations" : "seed");
+            return 1;
+        }
+        if (!promotedOk || promoted < 0 || !relegatedOk || relegated < 0) {
+            qCritical() << "Not a valid value for" << (promotedOk && promoted >= 0 ? "relegated" : "promoted");
+            return 1;
+        }
+
+        Season season;
+        season.promoted = promoted;
+        season.relegated = relegated;
+
+        const QUrl url(parser.value(simulateOption));
+        const QString prefix = url.scheme() + "://" + url.host();
+        QVector<LeagueGame> games;
+        QHash<int, QString> gameNames;
+
+        downloader->request(QNetworkRequest(url), [&](QNetworkReply::NetworkError /*err*/, GumboOutput *out) {
+            games = scrapeLeagueSeason(out, true);
+
+            QVector<int> tfvbIds;
+            for (const LeagueGame &game : games)
+                tfvbIds << game.tfvbId;
+            const QHash<int, Database::LeagueGameResult> known = database->leagueGameResults(tfvbIds);
+
+            for (const LeagueGame &game : games) {
+                if (known.contains(game.tfvbId))
+                    continue;
+                const int tfvbId = game.tfvbId;
+                downloader->request(QNetworkRequest(prepend(game.url, prefix)), [&, tfvbId](QNetworkReply::NetworkError /*err*/, GumboOutput *out) {
+                    gameNames.insert(tfvbId, scrapeLeagueGameName(out));
+                });
+            }
+        });
+
+        int exitCode = 1;
+        QObject::connect(downloader, &Downloader::completed, [&]() {
+            static bool done = false;
+            if (!done) {
+                if (games.isEmpty())
+                    qCritical() << "No league games found at" << url.toString();
+                else
+                    exitCode = simulateLeagueSeason(database, games, gameNames, season, simulations, seed);
+                app.quit();
+                done = true;
+            }
+        });
+
+        app.exec();
+        return exitCode;
+    }
+
 	bool recomputeElo = parser.isSet(forceRecompute);
 
     //
@@ -205,6 +348,8 @@ int main(int argc, char **argv)
             } else {
                 qDebug() << "Not recomputing, since nothing changed";
             }
+            if (fitBradleyTerry)
+                database->fitBradleyTerry(halfLife, QThread::idealThreadCount());
             app.quit();
             done = true;
         }
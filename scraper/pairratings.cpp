@@ -0,0 +1,70 @@
+#include "pairratings.hpp"
+
+#include <QtGlobal>
+
+static const int INITIAL_CAPACITY = 1024;
+
+PairRatings::PairRatings()
+    : m_entries(INITIAL_CAPACITY)
+    , m_shift(64 - 10)
+{
+}
+
+void PairRatings::Entry::checkin(float result)
+{
+    if (result == 1.0f) wins++;
+    else if (result == 0.5f) draws++;
+    else losses++;
+}
+
+quint64 PairRatings::packKey(int p1, int p2)
+{
+    // unordered, so (a, b) and (b, a) are the same team
+    return (quint64(quint32(qMin(p1, p2))) << 32) | quint32(qMax(p1, p2));
+}
+
+int PairRatings::slot(quint64 key) const
+{
+    // fibonacci hashing spreads the sequential player ids over the whole table
+    return int((key * Q_UINT64_C(0x9e3779b97f4a7c15)) >> m_shift);
+}
+
+PairRatings::Entry &PairRatings::pair(int p1, int p2)
+{
+    const quint64 key = packKey(p1, p2);
+    const int mask = m_entries.size() - 1;
+
+    for (int i = slot(key); ; i = (i + 1) & mask) {
+        Entry &e = m_entries[i];
+        if (e.key == key)
+            return e;
+
+        if (!e.key) {
+            // keep the load factor below 0.7 so that probe sequences stay short
+            if ((m_size + 1) * 10 > m_entries.size() * 7) {
+                grow();
+                return pair(p1, p2);
+            }
+            e.key = key;
+            m_size++;
+            return e;
+        }
+    }
+}
+
+void PairRatings::grow()
+{
+    QVector<Entry> old(m_entries.size() * 2);
+    old.swap(m_entries);
+    m_shift--;
+
+    const int mask = m_entries.size() - 1;
+    for (const Entry &e : old) {
+        if (!e.key)
+            continue;
+        int i = slot(e.key);
+        while (m_entries[i].key)
+            i = (i + 1) & mask;
+        m_entries[i] = e;
+    }
+}
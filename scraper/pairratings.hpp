@@ -0,0 +1,53 @@
+#pragma once
+
+#include "rating.hpp"
+
+#include <QVector>
+
+/*
+ * Ratings of double teams, keyed by the unordered pair of their players.
+ *
+ * Entries live in one open addressing table with linear probing, keyed by both player ids
+ * packed into 64 bits, so a lookup during the replay is a multiplication and usually a
+ * single cache line instead of QHash's node allocations.
+ */
+class PairRatings
+{
+public:
+    struct Entry {
+        quint64 key = 0;        // 0 marks an empty slot
+        EloRating rating;
+        quint16 wins = 0, draws = 0, losses = 0;
+
+        int player1() const { return int(key >> 32); }
+        int player2() const { return int(key & 0xffffffff); }
+        int matchCount() const { return wins + draws + losses; }
+        void checkin(float result);
+    };
+
+    PairRatings();
+
+    // the pair's entry, added with the default rating if it hasn't played yet
+    Entry &pair(int p1, int p2);
+
+    int size() const { return m_size; }
+
+    // all occupied entries, in no particular order
+    template<typename Fn>
+    void forEach(Fn fn) const
+    {
+        for (const Entry &e : m_entries) {
+            if (e.key)
+                fn(e);
+        }
+    }
+
+private:
+    static quint64 packKey(int p1, int p2);
+    int slot(quint64 key) const;
+    void grow();
+
+    QVector<Entry> m_entries;   // size is a power of two
+    int m_size = 0;
+    int m_shift;
+};
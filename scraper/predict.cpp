@@ -0,0 +1,90 @@
+#include "predict.hpp"
+#include "rating.hpp"
+
+#include <QFile>
+#include <QRegularExpression>
+#include <QTextStream>
+#include <QDebug>
+
+QVector<float> predictLineups(const QVector<Lineup> &lineups, const QHash<int, Database::CurrentRating> &ratings, PredictionRatings which)
+{
+    // players that never played start at the default rating
+    const float defaultRating = EloRating().abs();
+    const auto rating = [&](int id, bool isDouble) {
+        const auto it = ratings.constFind(id);
+        if (it == ratings.cend())
+            return defaultRating;
+        if (which == PredictionRatings::Combined)
+            return it->combined;
+        return isDouble ? it->dbl : it->single;
+    };
+
+    //
+    // Gather the team ratings into contiguous arrays, then compute all expected results at once
+    //
+    const int n = lineups.size();
+    QVector<float> team1(n), team2(n), ret(n);
+    for (int i = 0; i < n; ++i) {
+        const Lineup &l = lineups[i];
+        if (l.isDouble()) {
+            team1[i] = EloRating::teamRating(rating(l.p1, true), rating(l.p11, true));
+            team2[i] = EloRating::teamRating(rating(l.p2, true), rating(l.p22, true));
+        }
+        else {
+            team1[i] = rating(l.p1, false);
+            team2[i] = rating(l.p2, false);
+        }
+    }
+
+    EloRating::expectedResults(team1.constData(), team2.constData(), ret.data(), n);
+    return ret;
+}
+
+int predictLineupFile(Database *db, const QString &path, PredictionRatings which)
+{
+    QFile file(path);
+    const bool opened = (path == "-") ? file.open(stdin, QFile::ReadOnly) : file.open(QFile::ReadOnly);
+    if (!opened) {
+        qCritical() << "Error opening lineups" << path << ":" << file.errorString();
+        return 1;
+    }
+
+    //
+    // Parse lineups, skipping (and reporting) malformed lines
+    //
+    static const QRegularExpression separator("[\\s,;]+");
+    QVector<Lineup> lineups;
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        lineNumber++;
+        const QString line = QString::fromUtf8(file.readLine()).trimmed();
+        if (line.isEmpty() || line.startsWith("#"))
+            continue;
+
+        // leading or trailing separators leave empty parts
+        QStringList fields = line.split(separator);
+        fields.removeAll(QString());
+        int ids[4] = {0, 0, 0, 0};
+        bool ok = (fields.size() == 2 || fields.size() == 4);
+        for (int i = 0; ok && i < fields.size(); ++i)
+            ids[i] = fields[i].toInt(&ok);
+
+        if (!ok) {
+            qWarning() << "Skipping invalid lineup in line" << lineNumber << ":" << line;
+            continue;
+        }
+
+        lineups << ((fields.size() == 2) ? Lineup{ids[0], 0, ids[1], 0} : Lineup{ids[0], ids[1], ids[2], ids[3]});
+    }
+
+    const QVector<float> expected = predictLineups(lineups, db->currentRatings(), which);
+
+    QTextStream out(stdout);
+    out << "p1,p11,p2,p22,expected\n";
+    for (int i = 0; i < lineups.size(); ++i) {
+        const Lineup &l = lineups[i];
+        out << l.p1 << ',' << l.p11 << ',' << l.p2 << ',' << l.p22 << ',' << QString::number(expected[i], 'f', 4) << '\n';
+    }
+
+    return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "database.hpp"
+
+#include <QVector>
+
+// a single if p11 and p22 are 0
+struct Lineup
+{
+    int p1, p11;
+    int p2, p22;
+
+    bool isDouble() const { return p11 != 0; }
+};
+
+enum class PredictionRatings {
+    Separate,   // single ratings for singles, double ratings for doubles
+    Combined
+};
+
+// expected results for team 1 (1 = win, 0 = loss) with the current ratings, as used by the ELO update
+QVector<float> predictLineups(const QVector<Lineup> &lineups, const QHash<int, Database::CurrentRating> &ratings, PredictionRatings which);
+
+// reads lineups from path ("-" for stdin), one per line as 2 (single) or 4 (p1 p11 p2 p22) player
+// ids, and writes them to stdout as csv with the expected result. Returns the exit code.
+int predictLineupFile(Database *db, const QString &path, PredictionRatings which);
@@ -0,0 +1,50 @@
+#include "ranktracker.hpp"
+
+RankTracker::RankTracker()
+    : m_tree(MAX_RATING - MIN_RATING + 2, 0)
+{
+}
+
+int RankTracker::bucket(int rating)
+{
+    return qBound(MIN_RATING, rating, MAX_RATING) - MIN_RATING + 1;
+}
+
+void RankTracker::add(int bucket, int delta)
+{
+    for (; bucket < m_tree.size(); bucket += bucket & -bucket)
+        m_tree[bucket] += delta;
+}
+
+int RankTracker::countUpTo(int bucket) const
+{
+    int ret = 0;
+    for (; bucket > 0; bucket -= bucket & -bucket)
+        ret += m_tree[bucket];
+    return ret;
+}
+
+void RankTracker::update(int playerId, int rating)
+{
+    const int newBucket = bucket(rating);
+    auto it = m_ratings.find(playerId);
+    if (it == m_ratings.end()) {
+        m_ratings.insert(playerId, newBucket);
+        add(newBucket, 1);
+    }
+    else if (it.value() != newBucket) {
+        add(it.value(), -1);
+        add(newBucket, 1);
+        it.value() = newBucket;
+    }
+}
+
+int RankTracker::rank(int playerId) const
+{
+    const auto it = m_ratings.constFind(playerId);
+    if (it == m_ratings.cend())
+        return 0;
+
+    // everyone rated strictly higher is ahead
+    return m_ratings.size() - countUpTo(it.value()) + 1;
+}
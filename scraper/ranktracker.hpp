@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QHash>
+#include <QVector>
+
+/*
+ * Ranks of all players in one rating domain, maintained while replaying the match history.
+ *
+ * Ratings are rounded and counted in a Fenwick tree indexed by rating, so both moving a
+ * player and looking up a rank take O(log R), with R being the (clamped) rating range.
+ */
+class RankTracker
+{
+public:
+    RankTracker();
+
+    // sets the player's current rating, adding the player if this is the first one
+    void update(int playerId, int rating);
+
+    // 1 for the best player, players with the same rating share a rank; 0 if not rated yet
+    int rank(int playerId) const;
+
+    int playerCount() const { return m_ratings.size(); }
+
+private:
+    static const int MIN_RATING = 0;
+    static const int MAX_RATING = 4095;
+
+    static int bucket(int rating);
+    void add(int bucket, int delta);
+    int countUpTo(int bucket) const;
+
+    QVector<int> m_tree;        // 1-based Fenwick tree over buckets
+    QHash<int, int> m_ratings;  // player -> bucket
+};
@@ -2,21 +2,196 @@
 
 #include <QtMath>
 
-static float eloProb(float r1, float r2)
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+static inline float eloProb(float r1, float r2)
 {
     return 1.0f / (1.0f + qPow(10, (r2 - r1) / 400));
 }
 
-void EloRating::adjust(float k, float result, const EloRating &o)
+float EloRating::expectedResult(float r1, float r2)
+{
+    return eloProb(r1, r2);
+}
+
+// 2^x by a polynomial on the fraction and the exponent bits for the integer part, without
+// calls or float comparisons so that loops using it vectorize. Only valid for |x| < 2^22, and
+// not with -ffast-math, which may fold the rounding away.
+static inline float exp2Poly(float x)
+{
+    const float round = 12582912.0f;    // 1.5 * 2^23, adding and subtracting it rounds to an integer
+    const float kf = (x + round) - round;
+    const float f = x - kf;             // in [-0.5, 0.5]
+
+    float p = 1.535336188e-4f;
+    p = p * f + 1.339887440e-3f;
+    p = p * f + 9.618437358e-3f;
+    p = p * f + 5.550332471e-2f;
+    p = p * f + 2.402264791e-1f;
+    p = p * f + 6.931472029e-1f;
+    p = p * f + 1.0f;
+
+    // saturates instead of overflowing the exponent
+    const qint32 k = std::min(std::max(qint32(kf), -126), 126);
+    const qint32 bits = (k + 127) << 23;
+    float scale;
+    memcpy(&scale, &bits, sizeof(scale));
+    return p * scale;
+}
+
+void EloRating::expectedResults(const float *__restrict r1, const float *__restrict r2, float *__restrict out, int n)
+{
+    const float log2Of10 = 3.321928095f;
+
+    // needs -fopenmp-simd (see scraper.pro), -O2 doesn't vectorize it otherwise
+#pragma omp simd
+    for (int i = 0; i < n; ++i)
+        out[i] = 1.0f / (1.0f + exp2Poly((r2[i] - r1[i]) * (log2Of10 / 400)));
+}
+
+float EloRating::adjust(float k, float result, const EloRating &o)
 {
     const float pa = eloProb(m_rating, o.m_rating);
-    m_rating += k * (result - pa);
+    const float change = k * (result - pa);
+    m_rating += change;
+    return change;
 }
 
-void EloRating::adjust(float k, const EloRating &partner, float result, const EloRating &o1, const EloRating &o2)
+float EloRating::adjust(float k, const EloRating &partner, float result, const EloRating &o1, const EloRating &o2)
 {
-    const float r1 = 0.5f * (m_rating + partner.m_rating);
-    const float r2 = 0.5f * (o1.m_rating + o2.m_rating);
+    const float r1 = teamRating(m_rating, partner.m_rating);
+    const float r2 = teamRating(o1.m_rating, o2.m_rating);
     const float pa = eloProb(r1, r2);
-    m_rating += k * (result - pa);
+    const float change = k * (result - pa);
+    m_rating += change;
+    return change;
+}
+
+//
+// Glicko-2, see http://www.glicko.net/glicko/glicko2.pdf
+//
+static const float GLICKO_SCALE = 173.7178f;    // 400 / ln(10)
+static const float GLICKO_BASE = 1000.0f;       // rating of new players, like EloRating
+static const float GLICKO_INITIAL_DEVIATION = 350.0f;
+static const float GLICKO_INITIAL_VOLATILITY = 0.06f;
+static const float GLICKO_TAU = 0.5f;
+static const float GLICKO_PERIOD_DAYS = 30.0f;  // time span a volatility applies to
+
+static float glickoG(float phi)
+{
+    return 1.0f / std::sqrt(1.0f + 3.0f * phi * phi / float(M_PI * M_PI));
+}
+
+Glicko2Rating::Glicko2Rating()
+    : m_mu(0.0f)
+    , m_phi(GLICKO_INITIAL_DEVIATION / GLICKO_SCALE)
+    , m_sigma(GLICKO_INITIAL_VOLATILITY)
+{
+}
+
+float Glicko2Rating::abs() const
+{
+    return GLICKO_BASE + GLICKO_SCALE * m_mu;
+}
+
+float Glicko2Rating::deviation() const
+{
+    return GLICKO_SCALE * m_phi;
+}
+
+void Glicko2Rating::beginPeriod(int day)
+{
+    if (m_lastDay >= 0 && day > m_lastDay) {
+        const float periods = (day - m_lastDay) / GLICKO_PERIOD_DAYS;
+        m_phi = qMin(std::sqrt(m_phi * m_phi + m_sigma * m_sigma * periods), GLICKO_INITIAL_DEVIATION / GLICKO_SCALE);
+    }
+    m_lastDay = day;
+}
+
+float Glicko2Rating::adjust(float /*k*/, float result, const Glicko2Rating &o)
+{
+    return addResult(m_mu, result, o.m_mu, o.m_phi);
+}
+
+float Glicko2Rating::adjust(float /*k*/, const Glicko2Rating &partner, float result, const Glicko2Rating &o1, const Glicko2Rating &o2)
+{
+    // teams play with their average rating and the rms of their deviations
+    const float mu = EloRating::teamRating(m_mu, partner.m_mu);
+    const float opponentMu = EloRating::teamRating(o1.m_mu, o2.m_mu);
+    const float opponentPhi = std::sqrt(EloRating::teamRating(o1.m_phi * o1.m_phi, o2.m_phi * o2.m_phi));
+    return addResult(mu, result, opponentMu, opponentPhi);
+}
+
+float Glicko2Rating::addResult(float mu, float result, float opponentMu, float opponentPhi)
+{
+    const float g = glickoG(opponentPhi);
+    const float e = 1.0f / (1.0f + std::exp(-g * (mu - opponentMu)));
+    const float weight = g * (result - e);
+    m_periodInverseV += g * g * e * (1.0f - e);
+    m_periodScore += weight;
+    return weight;
+}
+
+float Glicko2Rating::endPeriod()
+{
+    if (m_periodInverseV <= 0.0f)
+        return 0.0f;
+
+    const float v = 1.0f / m_periodInverseV;
+    const float delta = v * m_periodScore;
+
+    //
+    // New volatility, by the Illinois algorithm
+    //
+    const double phi2 = double(m_phi) * m_phi;
+    const double delta2 = double(delta) * delta;
+    const double a = std::log(double(m_sigma) * m_sigma);
+    const double tau2 = double(GLICKO_TAU) * GLICKO_TAU;
+    const auto f = [&](double x) {
+        const double ex = std::exp(x);
+        return ex * (delta2 - phi2 - v - ex) / (2.0 * (phi2 + v + ex) * (phi2 + v + ex)) - (x - a) / tau2;
+    };
+
+    double lo = a;
+    double hi;
+    if (delta2 > phi2 + v) {
+        hi = std::log(delta2 - phi2 - v);
+    }
+    else {
+        int k = 1;
+        while (f(a - k * GLICKO_TAU) < 0.0)
+            k++;
+        hi = a - k * GLICKO_TAU;
+    }
+
+    double fLo = f(lo);
+    double fHi = f(hi);
+    for (int i = 0; i < 100 && std::abs(hi - lo) > 1e-6; ++i) {
+        const double c = lo + (lo - hi) * fLo / (fHi - fLo);
+        const double fC = f(c);
+        if (fC * fHi <= 0.0) {
+            lo = hi;
+            fLo = fHi;
+        }
+        else {
+            fLo /= 2.0;
+        }
+        hi = c;
+        fHi = fC;
+    }
+    m_sigma = float(std::exp(lo / 2.0));
+
+    //
+    // New deviation and rating; the deviation grows between periods in beginPeriod(). Every
+    // match moved mu by phi'^2 times its weight.
+    //
+    m_phi = 1.0f / std::sqrt(1.0f / (m_phi * m_phi) + m_periodInverseV);
+    const float factor = m_phi * m_phi;
+    m_mu += factor * m_periodScore;
+
+    m_periodInverseV = 0.0f;
+    m_periodScore = 0.0f;
+    return GLICKO_SCALE * factor;
 }
@@ -1,19 +1,106 @@
 #pragma once
 
 #include <QVector>
+#include <QtGlobal>
 
+/*
+ * k-factors of the rating update, see the --k* command line options. Matches are rated with
+ * the rules RatingRules::fromKFactors() makes from them.
+ */
+struct KFactors
+{
+    float league = 18.0f;
+    float tournament = 24.0f;
+    // matches that count less: mini challengers and single set games
+    float miniChallenger = 0.5f;
+    float singleSet = 0.5f;
+};
+
+/*
+ * Rating models used by Database::recompute(). A model is a value type with
+ *
+ *   static const bool BATCHES_PERIODS;
+ *   float abs() const;                      // the rating on the ELO scale
+ *   void beginPeriod(int day);              // before the first match of a competition day
+ *   float adjust(float k, float result, const Model &o);
+ *   float adjust(float k, const Model &partner, float result, const Model &o1, const Model &o2);
+ *   float endPeriod();                      // after the last match of a competition day
+ *
+ * and is picked at compile time by RatingModel below, so the replay loop has no virtual calls.
+ *
+ * Without BATCHES_PERIODS, adjust() changes the rating right away and returns the change. With
+ * it, adjust() only adds the match to the open period and returns the match's weight, and
+ * endPeriod() applies all of them at once and returns the rating change per unit of weight,
+ * which splits the period's change over its matches.
+ */
 class EloRating
 {
 public:
+    static const bool BATCHES_PERIODS = false;
+
     EloRating() : m_rating(1000.0f) {}
 
     float abs() const { return m_rating; }
 
-    void adjust(float k, float result, const EloRating &o);
-    void adjust(float k, const EloRating &partner, float result, const EloRating &o1, const EloRating &o2);
+    void beginPeriod(int /*day*/) {}
+    float endPeriod() { return 1.0f; }
+
+    float adjust(float k, float result, const EloRating &o);
+    float adjust(float k, const EloRating &partner, float result, const EloRating &o1, const EloRating &o2);
+
+    // a double team plays with the average of its players' ratings
+    static float teamRating(float r1, float r2) { return 0.5f * (r1 + r2); }
+    static float expectedResult(float r1, float r2);
+
+    // expectedResult() for n pairs of (team) ratings, within 1e-7; vectorized, the arrays must not overlap
+    static void expectedResults(const float *__restrict r1, const float *__restrict r2, float *__restrict out, int n);
 
     bool operator<=(const EloRating &other) const { return m_rating < other.m_rating; }
 
 private:
     float m_rating;
 };
+
+/*
+ * Glicko-2 rating with a deviation and volatility per player.
+ *
+ * Rating periods are competition days: when a player plays on a new day, the deviation grows
+ * with the time since the last one. All matches of the day are rated against the ratings the
+ * players had before it, and endPeriod() updates volatility, deviation and rating once from
+ * their sums. k is ignored, as the deviation already decides how far a result moves the rating.
+ */
+class Glicko2Rating
+{
+public:
+    Glicko2Rating();
+
+    float abs() const;
+    float deviation() const;
+
+    static const bool BATCHES_PERIODS = true;
+
+    void beginPeriod(int day);
+    float endPeriod();
+
+    float adjust(float k, float result, const Glicko2Rating &o);
+    float adjust(float k, const Glicko2Rating &partner, float result, const Glicko2Rating &o1, const Glicko2Rating &o2);
+
+private:
+    float addResult(float mu, float result, float opponentMu, float opponentPhi);
+
+    // on the Glicko-2 scale
+    float m_mu;
+    float m_phi;
+    float m_sigma;
+    int m_lastDay = -1;
+
+    // sums over the matches of the open period: g^2 E (1 - E), which is 1 / v, and g (s - E)
+    float m_periodInverseV = 0.0f;
+    float m_periodScore = 0.0f;
+};
+
+#ifdef RATING_MODEL_GLICKO2
+using RatingModel = Glicko2Rating;
+#else
+using RatingModel = EloRating;
+#endif
@@ -0,0 +1,141 @@
+#include "ratingrules.hpp"
+#include "database.hpp"
+
+#include <QFileInfo>
+#include <QSettings>
+#include <QDebug>
+
+RatingRules RatingRules::fromKFactors(const KFactors &kFactors)
+{
+    RatingRules ret;
+
+    Rule mini;
+    mini.id = "mini";
+    mini.type = (int) CompetitionType::Tournament;
+    mini.name = QRegularExpression("Mini");
+    mini.factor = kFactors.miniChallenger;
+    ret.m_rules << mini;
+
+    Rule singleSet;
+    singleSet.id = "singleset";
+    singleSet.score = ScoreFormat::SingleSet;
+    singleSet.factor = kFactors.singleSet;
+    ret.m_rules << singleSet;
+
+    Rule tournament;
+    tournament.id = "tournament";
+    tournament.type = (int) CompetitionType::Tournament;
+    tournament.k = kFactors.tournament;
+    ret.m_rules << tournament;
+
+    Rule league;
+    league.id = "league";
+    league.k = kFactors.league;
+    ret.m_rules << league;
+
+    return ret;
+}
+
+bool RatingRules::read(const QString &path, RatingRules &rules)
+{
+    if (!QFileInfo::exists(path)) {
+        qCritical() << "Rating rules" << path << "do not exist";
+        return false;
+    }
+
+    QSettings settings(path, QSettings::IniFormat);
+    settings.setIniCodec("UTF-8");
+
+    bool ok = true;
+    const auto fail = [&](const QString &id, const char *message) {
+        qCritical() << "Rating rule" << id << "in" << path << ":" << message;
+        ok = false;
+    };
+
+    rules.m_rules.clear();
+    for (const QString &key : settings.value("rules").toStringList()) {
+        Rule rule;
+        rule.id = key.trimmed();
+        if (rule.id.isEmpty() || rule.id.contains('/')) {
+            fail(rule.id, "invalid id");
+            continue;
+        }
+
+        settings.beginGroup(rule.id);
+
+        const QString type = settings.value("type").toString();
+        if (type == "league") rule.type = (int) CompetitionType::League;
+        else if (type == "cup") rule.type = (int) CompetitionType::Cup;
+        else if (type == "tournament") rule.type = (int) CompetitionType::Tournament;
+        else if (!type.isEmpty()) fail(rule.id, "type must be league, cup or tournament");
+
+        if (settings.contains("name")) {
+            rule.name = QRegularExpression(settings.value("name").toString());
+            if (!rule.name.isValid())
+                fail(rule.id, "invalid name pattern");
+        }
+
+        const QString score = settings.value("score").toString();
+        if (score == "single-set") rule.score = ScoreFormat::SingleSet;
+        else if (score == "two-set") rule.score = ScoreFormat::TwoSet;
+        else if (!score.isEmpty()) fail(rule.id, "score must be single-set or two-set");
+
+        for (const auto &date : { qMakePair(QString("from"), &rule.from), qMakePair(QString("to"), &rule.to) }) {
+            if (settings.contains(date.first)) {
+                *date.second = QDate::fromString(settings.value(date.first).toString(), Qt::ISODate);
+                if (!date.second->isValid())
+                    fail(rule.id, "dates must be yyyy-mm-dd");
+            }
+        }
+
+        bool numberOk = true;
+        if (settings.contains("k")) {
+            rule.k = settings.value("k").toFloat(&numberOk);
+            if (!numberOk || rule.k < 0.0f)
+                fail(rule.id, "k must be a positive number");
+        }
+        if (settings.contains("factor")) {
+            rule.factor = settings.value("factor").toFloat(&numberOk);
+            if (!numberOk || rule.factor < 0.0f)
+                fail(rule.id, "factor must be a positive number");
+        }
+
+        settings.endGroup();
+        rules.m_rules << rule;
+    }
+
+    if (rules.m_rules.isEmpty())
+        fail(QString(), "no rules");
+
+    return ok;
+}
+
+float RatingRules::k(const QVector<const Rule*> &matching, bool singleSet) const
+{
+    float k = -1.0f;
+    float factor = 1.0f;
+    for (const Rule *rule : matching) {
+        if ((rule->score == ScoreFormat::SingleSet && !singleSet) || (rule->score == ScoreFormat::TwoSet && singleSet))
+            continue;
+        if (k < 0.0f)
+            k = rule->k;
+        factor = qMin(factor, rule->factor);
+    }
+    return qMax(k, 0.0f) * factor;
+}
+
+void RatingRules::kFactors(CompetitionType type, const QString &name, const QDate &date, float &twoSet, float &singleSet) const
+{
+    QVector<const Rule*> matching;
+    for (const Rule &rule : m_rules) {
+        if ((rule.type && rule.type != (int) type)
+                || (!rule.name.pattern().isEmpty() && !rule.name.match(name).hasMatch())
+                || (rule.from.isValid() && date < rule.from)
+                || (rule.to.isValid() && date > rule.to))
+            continue;
+        matching << &rule;
+    }
+
+    twoSet = k(matching, false);
+    singleSet = k(matching, true);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "rating.hpp"
+
+#include <QDate>
+#include <QRegularExpression>
+#include <QString>
+#include <QVector>
+
+enum class CompetitionType;
+
+/*
+ * Declarative k-factor rules, evaluated once per competition instead of once per match.
+ *
+ * Each rule matches competitions by type, name pattern and date range, and matches by their
+ * score format. A match gets the k of the first matching rule that has one, times the
+ * smallest factor of all matching rules. Rules are read from an ini file:
+ *
+ *   rules = mini, singleset, tournament, league
+ *
+ *   [mini]
+ *   type = tournament          ; league, cup, tournament; any if missing
+ *   name = Mini                ; regular expression, any if missing
+ *   factor = 0.5
+ *
+ *   [singleset]
+ *   score = single-set         ; single-set (5 or more points), two-set; any if missing
+ *   factor = 0.5
+ *
+ *   [tournament]
+ *   type = tournament
+ *   from = 2010-01-01          ; optional first and last day, e.g. for a season
+ *   to = 2099-12-31
+ *   k = 24
+ *
+ *   [league]
+ *   k = 18
+ */
+class RatingRules
+{
+public:
+    // the built-in rules, as given on the command line
+    static RatingRules fromKFactors(const KFactors &kFactors);
+
+    // returns false and reports all errors if the file is missing or invalid
+    static bool read(const QString &path, RatingRules &rules);
+
+    // k-factors of a competition's two-set and single-set matches
+    void kFactors(CompetitionType type, const QString &name, const QDate &date, float &twoSet, float &singleSet) const;
+
+    static bool isSingleSet(int score1, int score2) { return qMax(score1, score2) >= 5; }
+
+private:
+    enum class ScoreFormat { Any, TwoSet, SingleSet };
+
+    struct Rule {
+        QString id;
+        int type = 0;                   // CompetitionType, 0 for any
+        QRegularExpression name;        // empty for any
+        ScoreFormat score = ScoreFormat::Any;
+        QDate from, to;                 // invalid for unbounded
+        float k = -1.0f;                // negative if not set
+        float factor = 1.0f;
+    };
+
+    float k(const QVector<const Rule*> &matching, bool singleSet) const;
+
+    QVector<Rule> m_rules;
+};
@@ -5,6 +5,12 @@ TEMPLATE = app
 QT += core network sql
 QT -= gui
 
+# "qmake CONFIG+=glicko2" rates with Glicko-2 instead of ELO, see RatingModel in rating.hpp
+glicko2: DEFINES += RATING_MODEL_GLICKO2
+
+# lets "#pragma omp simd" loops vectorize (e.g. EloRating::expectedResults) without OpenMP itself
+gcc|clang: QMAKE_CXXFLAGS += -fopenmp-simd
+
 SOURCES += \
     main.cpp \
     downloader.cpp \
@@ -13,6 +19,14 @@ SOURCES += \
     tournament.cpp \
     scrapeutil.cpp \
     rating.cpp \
+    predict.cpp \
+    simulator.cpp \
+    ranktracker.cpp \
+    pairratings.cpp \
+    bradleyterry.cpp \
+    kfactorfit.cpp \
+    ratingrules.cpp \
+    snapshotwriter.cpp \
     \
     ../3rdparty/gumbo-parser/src/attribute.c \
     ../3rdparty/gumbo-parser/src/char_ref.c \
@@ -33,6 +47,16 @@ HEADERS += \
     tournament.hpp \
     scrapeutil.hpp \
     rating.hpp \
+    predict.hpp \
+    simulator.hpp \
+    ranktracker.hpp \
+    pairratings.hpp \
+    bradleyterry.hpp \
+    kfactorfit.hpp \
+    ratingrules.hpp \
+    snapshotwriter.hpp \
+    ../common/snapshot.hpp \
 
 INCLUDEPATH += \
+    ../common/ \
     ../3rdparty/gumbo-parser/src/
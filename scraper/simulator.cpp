@@ -0,0 +1,274 @@
+#include "simulator.hpp"
+#include "rating.hpp"
+
+#include <QTextStream>
+#include <QThread>
+#include <QDebug>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+
+static const int CHUNK_SIZE = 4096;
+
+namespace {
+
+// outcome of an encounter, by the number of matches the home team won
+struct Outcome {
+    qint8 homePoints, awayPoints;
+    qint16 matchDiff;   // for the home team
+};
+
+struct FixtureTable {
+    QVector<double> cdf;        // P(home team wins <= i matches)
+    QVector<Outcome> outcomes;
+};
+
+} // anonymous namespace
+
+static FixtureTable buildFixtureTable(const Season &season, const Season::Fixture &fixture)
+{
+    const int n = season.matchesPerFixture;
+    // clamped, so that hopeless fixtures don't divide by zero below
+    const double p = qBound(1e-9, double(EloRating::expectedResult(season.teams[fixture.home].rating,
+                                                                  season.teams[fixture.away].rating)), 1.0 - 1e-9);
+
+    // binomial distribution of the matches won by the home team
+    FixtureTable ret;
+    ret.cdf.resize(n + 1);
+    ret.outcomes.resize(n + 1);
+    double probability = std::pow(1.0 - p, n);
+    double sum = 0.0;
+    for (int won = 0; won <= n; ++won) {
+        sum += probability;
+        ret.cdf[won] = sum;
+        probability *= (p / (1.0 - p)) * double(n - won) / double(won + 1);
+
+        const int lost = n - won;
+        ret.outcomes[won] = Outcome{
+            qint8((won > lost) ? 2 : (won == lost) ? 1 : 0),
+            qint8((won < lost) ? 2 : (won == lost) ? 1 : 0),
+            qint16(won - lost)
+        };
+    }
+    ret.cdf[n] = 1.0;
+    return ret;
+}
+
+SeasonOdds simulateSeason(const Season &season, int simulations, quint64 seed, int threadCount)
+{
+    const int teamCount = season.teams.size();
+
+    QVector<FixtureTable> tables;
+    for (const Season::Fixture &fixture : season.fixtures)
+        tables << buildFixtureTable(season, fixture);
+
+    // per team: points, title, promotion, relegation; summed over all simulations of a chunk
+    struct Counts {
+        QVector<qint64> points, title, promotion, relegation;
+    };
+    const int chunkCount = (simulations + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    QVector<Counts> chunkCounts(chunkCount);
+    Counts *chunkData = chunkCounts.data();     // detached once, before the threads write to it
+
+    const auto runChunk = [&](int chunk) {
+        std::seed_seq seq{ quint32(seed), quint32(seed >> 32), quint32(chunk) };
+        std::mt19937_64 rng(seq);
+        std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+        Counts &counts = chunkData[chunk];
+        counts.points.fill(0, teamCount);
+        counts.title.fill(0, teamCount);
+        counts.promotion.fill(0, teamCount);
+        counts.relegation.fill(0, teamCount);
+
+        QVector<int> points(teamCount), diff(teamCount), order(teamCount);
+        const int end = qMin((chunk + 1) * CHUNK_SIZE, simulations);
+        for (int sim = chunk * CHUNK_SIZE; sim < end; ++sim) {
+            for (int t = 0; t < teamCount; ++t) {
+                points[t] = season.teams[t].points;
+                diff[t] = season.teams[t].matchDiff;
+                order[t] = t;
+            }
+
+            for (int f = 0; f < tables.size(); ++f) {
+                const FixtureTable &table = tables.at(f);
+                const double u = uniform(rng);
+                int won = 0;
+                while (table.cdf[won] < u)
+                    won++;
+
+                const Outcome &o = table.outcomes[won];
+                const Season::Fixture &fixture = season.fixtures.at(f);
+                points[fixture.home] += o.homePoints;
+                points[fixture.away] += o.awayPoints;
+                diff[fixture.home] += o.matchDiff;
+                diff[fixture.away] -= o.matchDiff;
+            }
+
+            std::sort(order.begin(), order.end(), [&](int a, int b) {
+                if (points[a] != points[b])
+                    return points[a] > points[b];
+                if (diff[a] != diff[b])
+                    return diff[a] > diff[b];
+                return a < b;
+            });
+
+            for (int pos = 0; pos < teamCount; ++pos) {
+                const int t = order[pos];
+                counts.points[t] += points[t];
+                if (pos == 0)
+                    counts.title[t]++;
+                if (pos < season.promoted)
+                    counts.promotion[t]++;
+                if (pos >= teamCount - season.relegated)
+                    counts.relegation[t]++;
+            }
+        }
+    };
+
+    std::atomic<int> nextChunk(0);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < qMax(threadCount, 1); ++i) {
+        threads.emplace_back([&]() {
+            for (int chunk = nextChunk++; chunk < chunkCount; chunk = nextChunk++)
+                runChunk(chunk);
+        });
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+
+    //
+    // Reduce in chunk order; the sums are integers, so this is exact
+    //
+    SeasonOdds ret;
+    ret.teams.resize(teamCount);
+    for (int t = 0; t < teamCount; ++t) {
+        qint64 points = 0, title = 0, promotion = 0, relegation = 0;
+        for (const Counts &counts : chunkCounts) {
+            points += counts.points[t];
+            title += counts.title[t];
+            promotion += counts.promotion[t];
+            relegation += counts.relegation[t];
+        }
+        const double n = qMax(simulations, 1);
+        ret.teams[t] = SeasonOdds::Team{ points / n, title / n, promotion / n, relegation / n };
+    }
+    return ret;
+}
+
+int simulateLeagueSeason(Database *db, const QVector<LeagueGame> &games, const QHash<int, QString> &gameNames,
+                         Season season, int simulations, quint64 seed)
+{
+    QVector<int> tfvbIds;
+    for (const LeagueGame &game : games)
+        tfvbIds << game.tfvbId;
+    const QHash<int, Database::LeagueGameResult> results = db->leagueGameResults(tfvbIds);
+
+    //
+    // Standings and rosters from the played games, the others are the remaining fixtures
+    //
+    season.teams.clear();
+    season.fixtures.clear();
+    QHash<QString, int> teamIndices;
+    QVector<QVector<int>> rosters;
+    const auto teamIndex = [&](const QString &name) {
+        auto it = teamIndices.find(name);
+        if (it == teamIndices.end()) {
+            it = teamIndices.insert(name, season.teams.size());
+            Season::Team team;
+            team.name = name;
+            season.teams << team;
+            rosters.resize(season.teams.size());
+        }
+        return *it;
+    };
+
+    QHash<int, int> gamesByMatchCount;
+    for (const LeagueGame &game : games) {
+        const auto result = results.constFind(game.tfvbId);
+        const bool known = (result != results.cend());
+
+        QString homeName, awayName;
+        if (!splitLeagueGameName(known ? result->name : gameNames.value(game.tfvbId), homeName, awayName)) {
+            qWarning() << "Skipping league game" << game.tfvbId << "without team names";
+            continue;
+        }
+        const int home = teamIndex(homeName);
+        const int away = teamIndex(awayName);
+
+        // unplayed games, and live ones which aren't scraped before they are finished
+        if (!known || result->matchCount == 0) {
+            season.fixtures << Season::Fixture{home, away};
+            continue;
+        }
+
+        const int homeWins = result->homeWins;
+        const int awayWins = result->awayWins;
+        season.teams[home].points += (homeWins > awayWins) ? 2 : (homeWins == awayWins) ? 1 : 0;
+        season.teams[away].points += (awayWins > homeWins) ? 2 : (homeWins == awayWins) ? 1 : 0;
+        season.teams[home].matchDiff += homeWins - awayWins;
+        season.teams[away].matchDiff += awayWins - homeWins;
+
+        for (int p : result->homePlayers) {
+            if (!rosters[home].contains(p))
+                rosters[home] << p;
+        }
+        for (int p : result->awayPlayers) {
+            if (!rosters[away].contains(p))
+                rosters[away] << p;
+        }
+        gamesByMatchCount[result->matchCount]++;
+    }
+
+    // remaining games are as long as most of the played ones
+    for (auto it = gamesByMatchCount.cbegin(); it != gamesByMatchCount.cend(); ++it) {
+        const int current = gamesByMatchCount.value(season.matchesPerFixture);
+        if (it.value() > current || (it.value() == current && it.key() > season.matchesPerFixture))
+            season.matchesPerFixture = it.key();
+    }
+
+    const QHash<int, Database::CurrentRating> ratings = db->currentRatings();
+    const float defaultRating = EloRating().abs();
+    for (int t = 0; t < season.teams.size(); ++t) {
+        if (rosters[t].isEmpty()) {
+            qWarning() << "Team" << season.teams[t].name << "hasn't played yet, using the default rating";
+            continue;
+        }
+
+        float sum = 0.0f;
+        for (int p : rosters[t]) {
+            const auto it = ratings.constFind(p);
+            sum += (it != ratings.cend()) ? it->combined : defaultRating;
+        }
+        season.teams[t].rating = sum / rosters[t].size();
+    }
+
+    if (season.teams.isEmpty()) {
+        qCritical() << "No league games with team names found";
+        return 1;
+    }
+    if (season.promoted + season.relegated > season.teams.size()) {
+        qCritical() << "More promotion and relegation spots than the" << season.teams.size() << "teams of the league";
+        return 1;
+    }
+
+    const int threadCount = QThread::idealThreadCount();
+    qWarning() << "Simulating" << season.fixtures.size() << "fixtures of" << season.matchesPerFixture << "matches"
+               << simulations << "times with" << threadCount << "threads";
+    const SeasonOdds odds = simulateSeason(season, simulations, seed, threadCount);
+
+    QTextStream out(stdout);
+    out << "team,rating,points,expected_points,title,promotion,relegation\n";
+    for (int t = 0; t < season.teams.size(); ++t) {
+        const Season::Team &team = season.teams[t];
+        const SeasonOdds::Team &o = odds.teams[t];
+        out << '"' << QString(team.name).replace('"', "\"\"") << "\"," << qRound(team.rating) << ',' << team.points << ','
+            << QString::number(o.expectedPoints, 'f', 2) << ',' << QString::number(o.title, 'f', 4) << ','
+            << QString::number(o.promotion, 'f', 4) << ',' << QString::number(o.relegation, 'f', 4) << '\n';
+    }
+
+    return 0;
+}
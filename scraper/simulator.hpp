@@ -0,0 +1,58 @@
+#pragma once
+
+#include "database.hpp"
+#include "league.hpp"
+
+#include <QString>
+#include <QVector>
+
+/*
+ * Monte Carlo simulation of the rest of a league season.
+ *
+ * Every remaining fixture is an encounter of matchesPerFixture matches, each won with the
+ * ELO expectation of the two teams' average ratings. The team with more matches won gets 2
+ * points, a tie gives 1 point each; the final table is sorted by points, then match
+ * difference, then the order the teams were given in.
+ */
+struct Season
+{
+    struct Team {
+        QString name;
+        int points = 0;
+        int matchDiff = 0;
+        float rating = 1000.0f;
+    };
+    struct Fixture {
+        int home, away;     // indices into teams
+    };
+
+    QVector<Team> teams;
+    QVector<Fixture> fixtures;
+    int matchesPerFixture = 16;
+    int promoted = 1;
+    int relegated = 2;
+};
+
+struct SeasonOdds
+{
+    struct Team {
+        double expectedPoints = 0.0;
+        double title = 0.0;
+        double promotion = 0.0;
+        double relegation = 0.0;
+    };
+    QVector<Team> teams;
+};
+
+// Simulations are split into fixed chunks, each with its own RNG seeded from (seed, chunk),
+// and the per-chunk counts are summed, so the result only depends on the seed and not on
+// the thread count or scheduling.
+SeasonOdds simulateSeason(const Season &season, int simulations, quint64 seed, int threadCount);
+
+// Simulates the rest of the season of the given league games (see scrapeLeagueSeason()) and
+// prints the odds as csv. Games with matches in db make up the standings, all others are the
+// remaining fixtures; gameNames holds the competition names of games db doesn't know yet.
+// Teams are rated by the average combined rating of everyone who played for them in one of
+// the games. Only the promotion and relegation spots are taken from season. Returns the exit code.
+int simulateLeagueSeason(Database *db, const QVector<LeagueGame> &games, const QHash<int, QString> &gameNames,
+                         Season season, int simulations, quint64 seed);
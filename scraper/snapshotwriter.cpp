@@ -0,0 +1,78 @@
+#include "snapshotwriter.hpp"
+
+#include <QDateTime>
+#include <QSaveFile>
+#include <QDebug>
+
+#include <cstring>
+
+Snapshot::StringRef SnapshotWriter::addString(const QString &str)
+{
+    const auto it = m_stringRefs.constFind(str);
+    if (it != m_stringRefs.cend())
+        return it.value();
+
+    const QByteArray utf8 = str.toUtf8();
+    const Snapshot::StringRef ref{ (quint32) m_strings.size(), (quint32) utf8.size() };
+    m_strings += utf8;
+    m_stringRefs.insert(str, ref);
+    return ref;
+}
+
+static void appendSection(QByteArray &out, Snapshot::Header &header, Snapshot::SectionId id, const void *data, int count, int size)
+{
+    out.append(QByteArray((8 - out.size() % 8) % 8, '\0'));
+    header.sections[id].offset = out.size();
+    header.sections[id].count = count;
+    out.append(reinterpret_cast<const char*>(data), size);
+}
+
+template<typename T>
+static void appendSection(QByteArray &out, Snapshot::Header &header, Snapshot::SectionId id, const QVector<T> &records)
+{
+    appendSection(out, header, id, records.constData(), records.size(), records.size() * sizeof(T));
+}
+
+QByteArray SnapshotWriter::serialize()
+{
+    Snapshot::Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, Snapshot::MAGIC, sizeof(header.magic));
+    header.version = Snapshot::VERSION;
+    header.byteOrder = Snapshot::BYTE_ORDER_MARK;
+    header.createdAt = QDateTime::currentMSecsSinceEpoch();
+
+    QByteArray out(sizeof(header), '\0');
+    appendSection(out, header, Snapshot::StringsSection, m_strings.constData(), m_strings.size(), m_strings.size());
+    appendSection(out, header, Snapshot::PlayersSection, players);
+    appendSection(out, header, Snapshot::ProgressionSection, progression);
+    appendSection(out, header, Snapshot::PlayerVsPlayerSection, playerVsPlayer);
+    appendSection(out, header, Snapshot::CompetitionsSection, competitions);
+    appendSection(out, header, Snapshot::MatchesSection, matches);
+    appendSection(out, header, Snapshot::PlayedMatchesSection, playedMatches);
+
+    header.fileSize = out.size();
+    header.checksum = Snapshot::checksum(out.constData() + sizeof(header), out.size() - sizeof(header));
+    memcpy(out.data(), &header, sizeof(header));
+
+    m_checksum = header.checksum;
+    return out;
+}
+
+bool SnapshotWriter::save(const QString &path, const QByteArray &data)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Error opening snapshot" << path << ":" << file.errorString();
+        return false;
+    }
+
+    file.write(data);
+    if (!file.commit()) {
+        qWarning() << "Error writing snapshot" << path << ":" << file.errorString();
+        return false;
+    }
+
+    qWarning() << "Wrote snapshot" << path << "with" << data.size() << "bytes";
+    return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "snapshot.hpp"
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+/*
+ * Collects the sections of a snapshot (see common/snapshot.hpp) and serializes them.
+ */
+class SnapshotWriter
+{
+public:
+    // strings are deduplicated, so competition names are only stored once
+    Snapshot::StringRef addString(const QString &str);
+
+    QVector<Snapshot::Player> players;
+    QVector<Snapshot::ProgressionPoint> progression;
+    QVector<Snapshot::PlayerVsPlayer> playerVsPlayer;
+    QVector<Snapshot::Competition> competitions;
+    QVector<Snapshot::Match> matches;
+    QVector<Snapshot::PlayedMatch> playedMatches;
+
+    // builds the file contents, the checksum is available afterwards
+    QByteArray serialize();
+    quint64 checksum() const { return m_checksum; }
+
+    // writes the result of serialize() to a temporary file and renames it, so readers never see a partial file
+    static bool save(const QString &path, const QByteArray &data);
+
+private:
+    QByteArray m_strings;
+    QHash<QString, Snapshot::StringRef> m_stringRefs;
+    quint64 m_checksum = 0;
+};